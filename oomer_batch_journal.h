@@ -0,0 +1,167 @@
+#pragma once
+
+// Append only journal for resumable batch conversions
+// Every project gets a start record before it is converted and a done or quarantine record
+// after, each keyed by a hash of the project's files. A restarted batch skips projects that
+// are done with an unchanged hash, and a project that was started but never finished has
+// taken the whole run down with it (preemption, OOM killer) so after kBatchMaxAttempts it is
+// quarantined instead of killing the run again.
+// Records are tab separated lines, a torn last line from a crash is ignored on load
+// Will avoid using bella_sdk
+
+#include <map>          // For key-value pair data structures (maps)
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstdio>       // For snprintf
+#include <fstream>      // For reading and appending the journal
+#include <sstream>      // For splitting records
+#include <iostream>     // For input/output operations (cout, cin, etc.)
+#include <algorithm>    // For std::sort
+#include <stdexcept>    // For std::runtime_error
+#include <filesystem>   // For walking a .vmax package
+
+const int kBatchMaxAttempts = 2; // unfinished starts before a project is quarantined
+
+// FNV-1a over every file name and file content of a .vmax package, in sorted name order
+// so the hash only changes when the project does. A .vmax.zip is hashed as its bytes
+inline std::string hashVmaxPackage(const std::string& vmaxDirName) {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const char* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 1099511628211ull;
+        }
+    };
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    bool archive = std::filesystem::is_regular_file(vmaxDirName, error);
+    if (archive) {
+        files.push_back(vmaxDirName);
+    } else {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(vmaxDirName, error)) {
+            if (entry.is_regular_file()) files.push_back(entry.path());
+        }
+    }
+    if (error) return "";
+    std::sort(files.begin(), files.end());
+
+    std::vector<char> buffer(1 << 16);
+    for (const auto& file : files) {
+        if (!archive) {
+            std::string relative = std::filesystem::relative(file, vmaxDirName).generic_string();
+            mix(relative.c_str(), relative.size() + 1); // include the terminator so names can't run into content
+        }
+        std::ifstream input(file, std::ios::binary);
+        if (!input) return "";
+        while (input) {
+            input.read(buffer.data(), buffer.size());
+            mix(buffer.data(), static_cast<size_t>(input.gcount()));
+        }
+    }
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+class VmaxBatchJournal {
+private:
+    struct ProjectState {
+        std::string hash;          // hash of the latest record, older hashes are stale
+        int unfinishedStarts = 0;  // start records since the last done for this hash
+        bool done = false;
+        bool quarantined = false;
+        std::string output;
+        std::string reason;
+    };
+
+    std::string journalPath;
+    std::map<std::string, ProjectState> projects; // by input path
+    std::ofstream journal;
+
+    ProjectState& stateFor(const std::string& input, const std::string& hash) {
+        ProjectState& state = projects[input];
+        if (state.hash != hash) { // the project changed, start over
+            state = ProjectState();
+            state.hash = hash;
+        }
+        return state;
+    }
+
+    void append(const std::vector<std::string>& fields) {
+        for (size_t i = 0; i < fields.size(); i++) {
+            journal << (i ? "\t" : "") << fields[i];
+        }
+        journal << "\n";
+        journal.flush(); // a record only counts once it is on disk
+    }
+
+public:
+    // Load an existing journal and open it for appending
+    explicit VmaxBatchJournal(const std::string& path) : journalPath(path) {
+        std::ifstream existing(path);
+        std::string line;
+        while (std::getline(existing, line)) {
+            if (existing.eof()) break; // no trailing newline, the writer died mid record
+            std::vector<std::string> fields;
+            std::stringstream fieldStream(line);
+            std::string field;
+            while (std::getline(fieldStream, field, '\t')) fields.push_back(field);
+            if (fields.size() < 3) continue;
+            ProjectState& state = stateFor(fields[2], fields[1]);
+            if (fields[0] == "start") {
+                state.unfinishedStarts++;
+            } else if (fields[0] == "done" && fields.size() >= 4) {
+                state.done = true;
+                state.unfinishedStarts = 0;
+                state.output = fields[3];
+            } else if (fields[0] == "quarantine") {
+                state.quarantined = true;
+                state.reason = fields.size() >= 4 ? fields[3] : "";
+            }
+        }
+        journal.open(path, std::ios::app);
+        if (!journal) {
+            throw std::runtime_error("Failed to open batch journal: " + path);
+        }
+    }
+
+    bool isDone(const std::string& input, const std::string& hash) {
+        const ProjectState& state = stateFor(input, hash);
+        return state.done && std::filesystem::exists(state.output); // a deleted output is converted again
+    }
+
+    bool isQuarantined(const std::string& input, const std::string& hash) {
+        return stateFor(input, hash).quarantined;
+    }
+
+    int unfinishedStarts(const std::string& input, const std::string& hash) {
+        return stateFor(input, hash).unfinishedStarts;
+    }
+
+    const std::string& quarantineReason(const std::string& input, const std::string& hash) {
+        return stateFor(input, hash).reason;
+    }
+
+    void recordStart(const std::string& input, const std::string& hash) {
+        stateFor(input, hash).unfinishedStarts++;
+        append({"start", hash, input});
+    }
+
+    void recordDone(const std::string& input, const std::string& hash, const std::string& output) {
+        ProjectState& state = stateFor(input, hash);
+        state.done = true;
+        state.unfinishedStarts = 0;
+        state.output = output;
+        append({"done", hash, input, output});
+    }
+
+    void recordQuarantine(const std::string& input, const std::string& hash, const std::string& reason) {
+        ProjectState& state = stateFor(input, hash);
+        state.quarantined = true;
+        state.reason = reason;
+        append({"quarantine", hash, input, reason});
+    }
+
+    const std::string& path() const { return journalPath; }
+};
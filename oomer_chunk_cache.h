@@ -0,0 +1,188 @@
+#pragma once
+
+// Chunk fingerprints and a per content cache for --incremental reconversion
+// A contentsN.vmaxb holds its voxels as snapshots of 32^3 chunks, touching one corner of a
+// model rewrites the whole file but leaves the snapshots of every other chunk byte for byte
+// the same. Every chunk gets a fingerprint over its chunk id, morton origin and ds payload
+// (chained over all its snapshots). The cache keeps, per content, the fingerprint and the
+// decoded voxels of every chunk plus the tile meshes of the last conversion.
+// On reconversion unchanged chunks take their voxels from the cache instead of being
+// decoded, the voxels of changed chunks (old and new) mark the mesh tiles they and their
+// halo touch as dirty, and only dirty tiles are meshed again, the rest are spliced back in
+// from the cache. Tile meshes are opaque bytes here, the converter owns their layout.
+// Files are written to a temporary name and renamed, a crash leaves the old cache intact.
+// Will avoid using bella_sdk
+
+#include <map>          // For key-value pair data structures (maps)
+#include <set>          // For std::set
+#include <tuple>        // For std::tie
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For reading and writing cache files
+#include <stdexcept>    // For std::runtime_error
+#include <filesystem>   // For the atomic rename
+
+const uint32_t kChunkCacheMagic = 0x43435856;           // "VXCC"
+const uint32_t kChunkCacheVersion = 1;
+const uint64_t kChunkHashSeed = 1469598103934665603ull; // FNV-1a offset basis
+
+// Chain one snapshot of a chunk onto its fingerprint, start from kChunkHashSeed
+inline uint64_t hashVmaxChunk(uint64_t hash, uint64_t chunkId, uint64_t mortonMin, const uint8_t* ds, size_t size) {
+    auto mix = [&hash](const uint8_t* bytes, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    uint8_t header[16];
+    for (int i = 0; i < 8; i++) {
+        header[i] = static_cast<uint8_t>(chunkId >> (i * 8));
+        header[8 + i] = static_cast<uint8_t>(mortonMin >> (i * 8));
+    }
+    mix(header, sizeof(header));
+    if (ds) mix(ds, size);
+    return hash;
+}
+
+struct VmaxCachedVoxel {
+    uint8_t x, y, z;
+    uint8_t material;
+    uint8_t palette;
+    uint16_t chunkMin;  // morton origin of the snapshot it came from
+};
+
+struct VmaxCachedChunk {
+    uint64_t hash = 0;
+    std::vector<VmaxCachedVoxel> voxels;
+};
+
+// One tile of one (material, color) bucket
+struct VmaxTileKey {
+    int material = 0;
+    int color = 0;
+    uint32_t tile = 0;
+
+    bool operator<(const VmaxTileKey& other) const {
+        return std::tie(material, color, tile) < std::tie(other.material, other.color, other.tile);
+    }
+};
+
+struct VmaxContentCache {
+    uint32_t tileSize = 0;      // tiles are only reusable with the same tile size
+    int32_t meshSettings = -1;  // and the same meshing, the converter picks the value
+    std::map<uint64_t, VmaxCachedChunk> chunks;
+    std::map<VmaxTileKey, std::vector<uint8_t>> tiles;
+};
+
+// Mark the tile holding this voxel dirty, and the neighbour tiles whose halo it is part of
+inline void markDirtyVoxel(std::set<VmaxTileKey>& dirtyTiles, int material, int color, int x, int y, int z, int tileSize, int tilesPerAxis) {
+    const int p[3] = {x, y, z};
+    int lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++) {
+        int tile = p[axis] / tileSize;
+        int offset = p[axis] % tileSize;
+        lo[axis] = (offset == 0 && tile > 0) ? tile - 1 : tile;
+        hi[axis] = (offset == tileSize - 1 && tile + 1 < tilesPerAxis) ? tile + 1 : tile;
+    }
+    for (int tz = lo[2]; tz <= hi[2]; tz++) {
+        for (int ty = lo[1]; ty <= hi[1]; ty++) {
+            for (int tx = lo[0]; tx <= hi[0]; tx++) {
+                dirtyTiles.insert(VmaxTileKey{material, color, static_cast<uint32_t>(tx + ty * tilesPerAxis + tz * tilesPerAxis * tilesPerAxis)});
+            }
+        }
+    }
+}
+
+template <typename T>
+void writeCacheValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readCacheValue(std::ifstream& file, T& value) {
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+inline void saveVmaxContentCache(const std::string& fileName, const VmaxContentCache& cache) {
+    std::string tempName = fileName + ".tmp";
+    {
+        std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("Failed to write chunk cache: " + tempName);
+        writeCacheValue(file, kChunkCacheMagic);
+        writeCacheValue(file, kChunkCacheVersion);
+        writeCacheValue(file, cache.tileSize);
+        writeCacheValue(file, cache.meshSettings);
+        writeCacheValue(file, static_cast<uint64_t>(cache.chunks.size()));
+        for (const auto& [chunkId, chunk] : cache.chunks) {
+            writeCacheValue(file, chunkId);
+            writeCacheValue(file, chunk.hash);
+            writeCacheValue(file, static_cast<uint64_t>(chunk.voxels.size()));
+            for (const VmaxCachedVoxel& voxel : chunk.voxels) {
+                const uint8_t packed[7] = {voxel.x, voxel.y, voxel.z, voxel.material, voxel.palette,
+                                           static_cast<uint8_t>(voxel.chunkMin), static_cast<uint8_t>(voxel.chunkMin >> 8)};
+                file.write(reinterpret_cast<const char*>(packed), sizeof(packed));
+            }
+        }
+        writeCacheValue(file, static_cast<uint64_t>(cache.tiles.size()));
+        for (const auto& [key, bytes] : cache.tiles) {
+            writeCacheValue(file, static_cast<int32_t>(key.material));
+            writeCacheValue(file, static_cast<int32_t>(key.color));
+            writeCacheValue(file, key.tile);
+            writeCacheValue(file, static_cast<uint64_t>(bytes.size()));
+            file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        }
+        if (!file) throw std::runtime_error("Failed to write chunk cache: " + tempName);
+    }
+    std::filesystem::rename(tempName, fileName);
+}
+
+// False when there is no cache yet or it can't be used, cache is left empty then
+inline bool loadVmaxContentCache(const std::string& fileName, VmaxContentCache& cache) {
+    cache = VmaxContentCache();
+    std::ifstream file(fileName, std::ios::binary);
+    uint32_t magic = 0, version = 0;
+    if (!readCacheValue(file, magic) || !readCacheValue(file, version) || magic != kChunkCacheMagic || version != kChunkCacheVersion) {
+        return false;
+    }
+    // Counts and sizes read from disk are checked against what's left before allocating
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(fileName, error);
+    auto bytesLeft = [&]() -> uint64_t {
+        std::streamoff position = file.tellg();
+        return error || position < 0 || static_cast<uint64_t>(position) > fileSize ? 0 : fileSize - static_cast<uint64_t>(position);
+    };
+    uint64_t chunkCount = 0;
+    bool ok = readCacheValue(file, cache.tileSize) && readCacheValue(file, cache.meshSettings) && readCacheValue(file, chunkCount);
+    for (uint64_t i = 0; ok && i < chunkCount; i++) {
+        uint64_t chunkId = 0, voxelCount = 0;
+        VmaxCachedChunk chunk;
+        ok = readCacheValue(file, chunkId) && readCacheValue(file, chunk.hash) && readCacheValue(file, voxelCount) && voxelCount <= bytesLeft() / 7;
+        if (!ok) break;
+        std::vector<uint8_t> packed(voxelCount * 7);
+        ok = static_cast<bool>(file.read(reinterpret_cast<char*>(packed.data()), packed.size()));
+        chunk.voxels.resize(voxelCount);
+        for (uint64_t v = 0; ok && v < voxelCount; v++) {
+            const uint8_t* p = packed.data() + v * 7;
+            chunk.voxels[v] = VmaxCachedVoxel{p[0], p[1], p[2], p[3], p[4], static_cast<uint16_t>(p[5] | (p[6] << 8))};
+        }
+        cache.chunks[chunkId] = std::move(chunk);
+    }
+    uint64_t tileCount = 0;
+    ok = ok && readCacheValue(file, tileCount);
+    for (uint64_t i = 0; ok && i < tileCount; i++) {
+        int32_t material = 0, color = 0;
+        uint32_t tile = 0;
+        uint64_t size = 0;
+        ok = readCacheValue(file, material) && readCacheValue(file, color) && readCacheValue(file, tile) && readCacheValue(file, size) &&
+             size <= bytesLeft();
+        if (!ok) break;
+        std::vector<uint8_t>& bytes = cache.tiles[VmaxTileKey{material, color, tile}];
+        bytes.resize(size);
+        ok = static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), size));
+    }
+    if (!ok) {
+        cache = VmaxContentCache(); // torn or foreign file, convert from scratch
+    }
+    return ok;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+// glTF 2.0 binary (.glb) export, the preview target of --export
+// The scene keeps the VoxelMax hierarchy, one node per group and per object holding its local
+// matrix, object nodes reference the mesh of their content so every content is stored once.
+// A content mesh has one primitive per (material, color) bucket, or one textured primitive
+// per material with --meshtype:atlas, positions in model voxel space like the bella meshes.
+// Meshes are built by concurrent export tasks, each owns its materials and images and they
+// are only merged into global glTF indices when the file is encoded.
+// Matrices are row vector like oom::vmax::Matrix4x4, flattened row by row that is exactly
+// glTF's column major layout for column vectors. VoxelMax is z up, a root node turns it y up.
+// Will avoid using bella_sdk
+
+#include <array>        // For std::array
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>      // For std::memcpy
+#include <sstream>      // For building the json chunk
+#include <fstream>      // For writing the glb
+#include <iomanip>      // For std::setprecision
+#include <algorithm>    // For std::min, std::max
+#include <stdexcept>    // For std::runtime_error
+
+const uint32_t kGltfMagic = 0x46546C67;      // "glTF"
+const uint32_t kGltfChunkJson = 0x4E4F534A;  // "JSON"
+const uint32_t kGltfChunkBin = 0x004E4942;   // "BIN\0"
+
+struct VmaxGltfMaterial {
+    float color[4] = {1.0f, 1.0f, 1.0f, 1.0f}; // linear rgba
+    float metallic = 0.0f;
+    float roughness = 1.0f;
+    float emissive[3] = {0.0f, 0.0f, 0.0f};
+    int image = -1;                            // base color texture, index into the mesh's images
+};
+
+struct VmaxGltfPrimitive {
+    std::vector<float> positions;   // xyz per vertex
+    std::vector<float> normals;     // xyz per vertex, may be empty
+    std::vector<float> uvs;         // uv per vertex, v top down as glTF expects, may be empty
+    std::vector<uint32_t> indices;  // triangles, counter clockwise seen from outside
+    int material = 0;               // index into the mesh's materials
+};
+
+struct VmaxGltfMesh {
+    std::string name;
+    std::vector<VmaxGltfPrimitive> primitives;
+    std::vector<VmaxGltfMaterial> materials;
+    std::vector<std::vector<uint8_t>> images; // png files
+};
+
+using VmaxGltfMatrix = std::array<double, 16>;
+const VmaxGltfMatrix kGltfIdentity = {1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1};
+
+struct VmaxGltfNode {
+    std::string name;
+    VmaxGltfMatrix matrix = kGltfIdentity;
+    int mesh = -1;
+    std::vector<int> children;
+};
+
+struct VmaxGltfScene {
+    std::vector<VmaxGltfMesh> meshes; // a mesh without primitives is left out of the file
+    std::vector<VmaxGltfNode> nodes;
+    std::vector<int> roots;
+
+    int addNode(const std::string& name, const VmaxGltfMatrix& matrix, int mesh = -1) {
+        nodes.push_back(VmaxGltfNode{name, matrix, mesh, {}});
+        return static_cast<int>(nodes.size() - 1);
+    }
+
+    void parent(int child, int parentNode) {
+        if (parentNode < 0) roots.push_back(child); else nodes[parentNode].children.push_back(child);
+    }
+
+    // Deep copy of a node and everything below it, meshes are shared
+    int cloneSubtree(int node, int parentNode) {
+        VmaxGltfNode copy = nodes[node]; // by value, addNode may reallocate
+        int cloned = addNode(copy.name, copy.matrix, copy.mesh);
+        parent(cloned, parentNode);
+        for (int child : copy.children) {
+            cloneSubtree(child, cloned);
+        }
+        return cloned;
+    }
+};
+
+inline std::string gltfEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+inline std::vector<uint8_t> encodeGltfBinary(const VmaxGltfScene& scene) {
+    std::vector<uint8_t> bin;
+    std::ostringstream views, accessors, meshes, materials, textures, images, nodes;
+    int viewCount = 0, accessorCount = 0, meshCount = 0, materialCount = 0, imageCount = 0;
+    auto separator = [](std::ostringstream& list) { if (list.tellp() > 0) list << ","; };
+    auto addView = [&](const void* data, size_t size, int target) {
+        while (bin.size() % 4) bin.push_back(0);
+        separator(views);
+        views << "{\"buffer\":0,\"byteOffset\":" << bin.size() << ",\"byteLength\":" << size;
+        if (target) views << ",\"target\":" << target;
+        views << "}";
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        bin.insert(bin.end(), bytes, bytes + size);
+        return viewCount++;
+    };
+    auto addFloats = [&](const std::vector<float>& values, int width, const char* type, bool bounds) {
+        int view = addView(values.data(), values.size() * sizeof(float), 34962);
+        separator(accessors);
+        accessors << "{\"bufferView\":" << view << ",\"componentType\":5126,\"count\":" << values.size() / width
+                  << ",\"type\":\"" << type << "\"";
+        if (bounds) { // required for POSITION
+            float lo[3] = {values[0], values[1], values[2]};
+            float hi[3] = {values[0], values[1], values[2]};
+            for (size_t i = 0; i < values.size(); i++) {
+                lo[i % 3] = std::min(lo[i % 3], values[i]);
+                hi[i % 3] = std::max(hi[i % 3], values[i]);
+            }
+            accessors << ",\"min\":[" << lo[0] << "," << lo[1] << "," << lo[2] << "],\"max\":[" << hi[0] << "," << hi[1] << "," << hi[2] << "]";
+        }
+        accessors << "}";
+        return accessorCount++;
+    };
+    for (std::ostringstream* list : {&accessors, &materials}) *list << std::setprecision(9);
+    nodes << std::setprecision(17);
+
+    std::vector<int> meshIndex(scene.meshes.size(), -1);
+    for (size_t m = 0; m < scene.meshes.size(); m++) {
+        const VmaxGltfMesh& mesh = scene.meshes[m];
+        if (mesh.primitives.empty()) continue;
+        int firstImage = imageCount;
+        for (const std::vector<uint8_t>& png : mesh.images) {
+            int view = addView(png.data(), png.size(), 0);
+            separator(images);
+            images << "{\"bufferView\":" << view << ",\"mimeType\":\"image/png\"}";
+            separator(textures);
+            textures << "{\"source\":" << imageCount << "}";
+            imageCount++;
+        }
+        int firstMaterial = materialCount;
+        for (const VmaxGltfMaterial& material : mesh.materials) {
+            separator(materials);
+            materials << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":[" << material.color[0] << "," << material.color[1] << ","
+                      << material.color[2] << "," << material.color[3] << "],\"metallicFactor\":" << material.metallic
+                      << ",\"roughnessFactor\":" << material.roughness;
+            if (material.image >= 0) materials << ",\"baseColorTexture\":{\"index\":" << firstImage + material.image << "}";
+            materials << "}";
+            if (material.emissive[0] > 0.0f || material.emissive[1] > 0.0f || material.emissive[2] > 0.0f) {
+                materials << ",\"emissiveFactor\":[" << material.emissive[0] << "," << material.emissive[1] << "," << material.emissive[2] << "]";
+            }
+            if (material.color[3] < 1.0f) materials << ",\"alphaMode\":\"BLEND\"";
+            materials << "}";
+            materialCount++;
+        }
+        separator(meshes);
+        meshes << "{\"name\":\"" << gltfEscape(mesh.name) << "\",\"primitives\":[";
+        for (size_t p = 0; p < mesh.primitives.size(); p++) {
+            const VmaxGltfPrimitive& primitive = mesh.primitives[p];
+            if (primitive.positions.empty() || primitive.indices.empty()) throw std::runtime_error("glTF primitive without triangles in " + mesh.name);
+            meshes << (p ? "," : "") << "{\"attributes\":{\"POSITION\":" << addFloats(primitive.positions, 3, "VEC3", true);
+            if (!primitive.normals.empty()) meshes << ",\"NORMAL\":" << addFloats(primitive.normals, 3, "VEC3", false);
+            if (!primitive.uvs.empty()) meshes << ",\"TEXCOORD_0\":" << addFloats(primitive.uvs, 2, "VEC2", false);
+            int view = addView(primitive.indices.data(), primitive.indices.size() * sizeof(uint32_t), 34963);
+            separator(accessors);
+            accessors << "{\"bufferView\":" << view << ",\"componentType\":5125,\"count\":" << primitive.indices.size() << ",\"type\":\"SCALAR\"}";
+            meshes << "},\"indices\":" << accessorCount++ << ",\"material\":" << firstMaterial + primitive.material << "}";
+        }
+        meshes << "]}";
+        meshIndex[m] = meshCount++;
+    }
+
+    // Node 0 turns z up into y up, the scene nodes follow shifted by one
+    nodes << "{\"name\":\"vmax\",\"matrix\":[1,0,0,0,0,0,-1,0,0,1,0,0,0,0,0,1],\"children\":[";
+    for (size_t r = 0; r < scene.roots.size(); r++) nodes << (r ? "," : "") << scene.roots[r] + 1;
+    nodes << "]}";
+    for (const VmaxGltfNode& node : scene.nodes) {
+        nodes << ",{\"name\":\"" << gltfEscape(node.name) << "\"";
+        if (node.matrix != kGltfIdentity) {
+            nodes << ",\"matrix\":[";
+            for (int i = 0; i < 16; i++) nodes << (i ? "," : "") << node.matrix[i];
+            nodes << "]";
+        }
+        if (node.mesh >= 0 && node.mesh < static_cast<int>(meshIndex.size()) && meshIndex[node.mesh] >= 0) {
+            nodes << ",\"mesh\":" << meshIndex[node.mesh];
+        }
+        if (!node.children.empty()) {
+            nodes << ",\"children\":[";
+            for (size_t c = 0; c < node.children.size(); c++) nodes << (c ? "," : "") << node.children[c] + 1;
+            nodes << "]";
+        }
+        nodes << "}";
+    }
+
+    std::ostringstream json;
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"vmax2bella\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[" << nodes.str() << "]";
+    if (meshCount) json << ",\"meshes\":[" << meshes.str() << "],\"materials\":[" << materials.str() << "],\"accessors\":[" << accessors.str() << "]";
+    if (imageCount) json << ",\"images\":[" << images.str() << "],\"textures\":[" << textures.str() << "]";
+    if (!bin.empty()) json << ",\"bufferViews\":[" << views.str() << "],\"buffers\":[{\"byteLength\":" << bin.size() << "}]";
+    json << "}";
+    std::string jsonText = json.str();
+    while (jsonText.size() % 4) jsonText += ' ';
+    while (bin.size() % 4) bin.push_back(0);
+
+    std::vector<uint8_t> glb;
+    auto put32 = [&glb](uint32_t value) {
+        for (int i = 0; i < 4; i++) glb.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    };
+    uint32_t totalSize = static_cast<uint32_t>(12 + 8 + jsonText.size() + (bin.empty() ? 0 : 8 + bin.size()));
+    glb.reserve(totalSize);
+    put32(kGltfMagic);
+    put32(2);
+    put32(totalSize);
+    put32(static_cast<uint32_t>(jsonText.size()));
+    put32(kGltfChunkJson);
+    glb.insert(glb.end(), jsonText.begin(), jsonText.end());
+    if (!bin.empty()) {
+        put32(static_cast<uint32_t>(bin.size()));
+        put32(kGltfChunkBin);
+        glb.insert(glb.end(), bin.begin(), bin.end());
+    }
+    return glb;
+}
+
+inline void writeGltfBinary(const VmaxGltfScene& scene, const std::string& fileName) {
+    std::vector<uint8_t> glb = encodeGltfBinary(scene);
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("Failed to write glb: " + fileName);
+    file.write(reinterpret_cast<const char*>(glb.data()), glb.size());
+    if (!file) throw std::runtime_error("Failed to write glb: " + fileName);
+}
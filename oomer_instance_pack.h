@@ -0,0 +1,141 @@
+#pragma once
+
+// Instance transform packing for box mode
+// A box instancer needs one 4x4 float matrix per voxel but only the translation row differs,
+// pushing them one at a time reallocates and copies 64 bytes per voxel over and over.
+// Voxels are first packed into a 4 byte x|y|z coordinate stream (dropping hidden ones), the
+// output is sized once, then parallel chunks write the constant rotation rows and convert
+// the translations 4 voxels at a time with SSE2 or NEON, scalar elsewhere.
+// Writes into caller owned memory, the caller hands it to bella on the main thread
+// Will avoid using bella_sdk
+
+#include <thread>       // For packing chunks in parallel
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>      // For std::memcpy
+#include <algorithm>    // For std::min
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VMAX_PACK_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VMAX_PACK_NEON 1
+#endif
+
+const size_t kPackChunkVoxels = 65536; // voxels per parallel chunk, small buckets stay on the calling thread
+
+inline uint32_t packVoxelCoordinate(uint8_t x, uint8_t y, uint8_t z) {
+    return static_cast<uint32_t>(x) | (static_cast<uint32_t>(y) << 8) | (static_cast<uint32_t>(z) << 16);
+}
+
+// Run work(begin, end) over [0, count) in kPackChunkVoxels chunks on up to threadCount threads
+template <typename Work>
+void forEachPackChunk(size_t count, unsigned int threadCount, const Work& work) {
+    size_t chunkCount = (count + kPackChunkVoxels - 1) / kPackChunkVoxels;
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount <= 1 || chunkCount <= 1) {
+        work(size_t(0), count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t threads = std::min<size_t>(threadCount, chunkCount);
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&work, count, chunkCount, threads, t]() {
+            for (size_t chunk = t; chunk < chunkCount; chunk += threads) { // strided so every thread gets a share
+                size_t begin = chunk * kPackChunkVoxels;
+                work(begin, std::min(begin + kPackChunkVoxels, count));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Coordinates of the voxels keep() accepts, in voxel order
+// keep runs concurrently on const data, it must not write shared state
+template <typename Voxel, typename Keep>
+std::vector<uint32_t> packVoxelCoordinates(const std::vector<Voxel>& voxels, const Keep& keep, unsigned int threadCount = 0) {
+    size_t chunkCount = (voxels.size() + kPackChunkVoxels - 1) / kPackChunkVoxels;
+    std::vector<std::vector<uint32_t>> chunks(chunkCount);
+    forEachPackChunk(voxels.size(), threadCount, [&](size_t begin, size_t end) {
+        for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += kPackChunkVoxels) {
+            std::vector<uint32_t>& chunk = chunks[chunkBegin / kPackChunkVoxels];
+            size_t chunkEnd = std::min(chunkBegin + kPackChunkVoxels, end);
+            chunk.reserve(chunkEnd - chunkBegin);
+            for (size_t i = chunkBegin; i < chunkEnd; i++) {
+                if (keep(voxels[i])) chunk.push_back(packVoxelCoordinate(voxels[i].x, voxels[i].y, voxels[i].z));
+            }
+        }
+    });
+    size_t total = 0;
+    for (const auto& chunk : chunks) total += chunk.size();
+    std::vector<uint32_t> packed;
+    packed.reserve(total);
+    for (const auto& chunk : chunks) packed.insert(packed.end(), chunk.begin(), chunk.end());
+    return packed;
+}
+
+// Write count row major 4x4 matrices (identity rotation, translation = coordinate + offset)
+// @param out: 16 * count floats, rows are x axis, y axis, z axis, translation like dl::Mat4f
+inline void packInstanceTransforms(const uint32_t* packed, size_t count, float* out, float offset, unsigned int threadCount = 0) {
+    static const float kIdentityRows[12] = {1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0};
+    forEachPackChunk(count, threadCount, [&](size_t begin, size_t end) {
+        size_t i = begin;
+#if defined(VMAX_PACK_SSE2)
+        const __m128 row0 = _mm_loadu_ps(kIdentityRows);
+        const __m128 row1 = _mm_loadu_ps(kIdentityRows + 4);
+        const __m128 row2 = _mm_loadu_ps(kIdentityRows + 8);
+        const __m128i byteMask = _mm_set1_epi32(0xff);
+        const __m128 offsets = _mm_set1_ps(offset);
+        for (; i + 4 <= end; i += 4) {
+            __m128i coordinates = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i));
+            __m128 xs = _mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(coordinates, byteMask)), offsets);
+            __m128 ys = _mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(coordinates, 8), byteMask)), offsets);
+            __m128 zs = _mm_add_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(coordinates, 16), byteMask)), offsets);
+            __m128 ones = _mm_set1_ps(1.0f);
+            _MM_TRANSPOSE4_PS(xs, ys, zs, ones); // now one (x, y, z, 1) translation row per voxel
+            const __m128 translations[4] = {xs, ys, zs, ones};
+            for (int lane = 0; lane < 4; lane++) {
+                float* matrix = out + (i + lane) * 16;
+                _mm_storeu_ps(matrix, row0);
+                _mm_storeu_ps(matrix + 4, row1);
+                _mm_storeu_ps(matrix + 8, row2);
+                _mm_storeu_ps(matrix + 12, translations[lane]);
+            }
+        }
+#elif defined(VMAX_PACK_NEON)
+        const float32x4_t row0 = vld1q_f32(kIdentityRows);
+        const float32x4_t row1 = vld1q_f32(kIdentityRows + 4);
+        const float32x4_t row2 = vld1q_f32(kIdentityRows + 8);
+        const uint32x4_t byteMask = vdupq_n_u32(0xff);
+        const float32x4_t offsets = vdupq_n_f32(offset);
+        for (; i + 4 <= end; i += 4) {
+            uint32x4_t coordinates = vld1q_u32(packed + i);
+            float32x4x4_t translations;
+            translations.val[0] = vaddq_f32(vcvtq_f32_u32(vandq_u32(coordinates, byteMask)), offsets);
+            translations.val[1] = vaddq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(coordinates, 8), byteMask)), offsets);
+            translations.val[2] = vaddq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(coordinates, 16), byteMask)), offsets);
+            translations.val[3] = vdupq_n_f32(1.0f);
+            float rows[16];
+            vst4q_f32(rows, translations); // interleaving store transposes, one (x, y, z, 1) per voxel
+            for (int lane = 0; lane < 4; lane++) {
+                float* matrix = out + (i + lane) * 16;
+                vst1q_f32(matrix, row0);
+                vst1q_f32(matrix + 4, row1);
+                vst1q_f32(matrix + 8, row2);
+                vst1q_f32(matrix + 12, vld1q_f32(rows + lane * 4));
+            }
+        }
+#endif
+        for (; i < end; i++) { // tail, or everything without SIMD
+            float* matrix = out + i * 16;
+            std::memcpy(matrix, kIdentityRows, sizeof(kIdentityRows));
+            matrix[12] = static_cast<float>(packed[i] & 0xff) + offset;
+            matrix[13] = static_cast<float>((packed[i] >> 8) & 0xff) + offset;
+            matrix[14] = static_cast<float>((packed[i] >> 16) & 0xff) + offset;
+            matrix[15] = 1.0f;
+        }
+    });
+}
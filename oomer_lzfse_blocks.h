@@ -0,0 +1,213 @@
+#pragma once
+
+// Block aware lzfse decoding and a compactor writing independently decodable streams
+// An lzfse stream is a sequence of blocks (bvx1, bvx2, bvxn, bvx-) closed by bvx$, every
+// block header carries the number of bytes it decodes to. Scanning the headers gives each
+// block's exact output offset, so segments of blocks can be decoded concurrently straight
+// into one output buffer, without the guess-and-grow loop of lzfse_decode_buffer.
+// A segment only decodes on its own when its matches don't reach back into earlier blocks,
+// the lzfse decoder rejects such a match instead of producing wrong bytes. Any failure falls
+// back to one serial decode of the whole stream, so the result never depends on the split.
+// Streams written by VoxelMax reference earlier blocks freely, compactVmaxLzfse rewrites them
+// as segments encoded on their own, each opened by an empty uncompressed block (bvx- of
+// 0 bytes) that any lzfse decoder skips and that marks where a segment starts.
+// Will avoid using bella_sdk
+
+#include <atomic>       // For handing out segments
+#include <thread>       // For decoding segments concurrently
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>      // For std::memcpy
+#include <algorithm>    // For std::min
+
+#include "../lzfse/src/lzfse.h"
+
+const uint32_t kLzfseEndOfStreamMagic = 0x24787662;  // bvx$
+const uint32_t kLzfseUncompressedMagic = 0x2d787662; // bvx-
+const uint32_t kLzfseCompressedV1Magic = 0x31787662; // bvx1
+const uint32_t kLzfseCompressedV2Magic = 0x32787662; // bvx2
+const uint32_t kLzfseCompressedLzvnMagic = 0x6e787662; // bvxn
+const size_t kLzfseV1HeaderBytes = 772;              // sizeof(lzfse_compressed_block_header_v1)
+const size_t kLzfseParallelMinBytes = 1 << 20;       // smaller streams decode serially
+const size_t kLzfseSegmentBytes = 1 << 20;           // raw bytes per independent segment written by the compactor
+
+struct VmaxLzfseBlock {
+    uint32_t magic = 0;
+    size_t srcOffset = 0;
+    size_t srcSize = 0;  // header and payload
+    size_t dstOffset = 0;
+    size_t dstSize = 0;
+};
+
+inline uint64_t lzfseRead(const uint8_t* bytes, size_t offset, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(bytes[offset + i]) << (i * 8);
+    }
+    return value;
+}
+
+// Walk the block headers up to the end of stream marker
+// False when the stream is truncated or holds a block this scanner doesn't know
+inline bool scanLzfseBlocks(const uint8_t* src, size_t srcSize, std::vector<VmaxLzfseBlock>& blocks) {
+    blocks.clear();
+    size_t offset = 0;
+    size_t dstOffset = 0;
+    while (offset + 4 <= srcSize) {
+        VmaxLzfseBlock block;
+        block.magic = static_cast<uint32_t>(lzfseRead(src, offset, 4));
+        block.srcOffset = offset;
+        block.dstOffset = dstOffset;
+        if (block.magic == kLzfseEndOfStreamMagic) return true;
+        if (offset + 8 > srcSize) return false;
+        block.dstSize = static_cast<size_t>(lzfseRead(src, offset + 4, 4));
+        if (block.magic == kLzfseUncompressedMagic) {
+            block.srcSize = 8 + block.dstSize;
+        } else if (block.magic == kLzfseCompressedLzvnMagic) {
+            if (offset + 12 > srcSize) return false;
+            block.srcSize = 12 + static_cast<size_t>(lzfseRead(src, offset + 8, 4));
+        } else if (block.magic == kLzfseCompressedV1Magic) {
+            if (offset + 28 > srcSize) return false;
+            block.srcSize = kLzfseV1HeaderBytes + static_cast<size_t>(lzfseRead(src, offset + 20, 4))
+                                                + static_cast<size_t>(lzfseRead(src, offset + 24, 4));
+        } else if (block.magic == kLzfseCompressedV2Magic) {
+            if (offset + 32 > srcSize) return false;
+            uint64_t literalFields = lzfseRead(src, offset + 8, 8);
+            uint64_t lmdFields = lzfseRead(src, offset + 16, 8);
+            uint64_t headerFields = lzfseRead(src, offset + 24, 8);
+            block.srcSize = static_cast<size_t>(headerFields & 0xffffffffu)     // header size
+                          + static_cast<size_t>((literalFields >> 20) & 0xfffff) // literal payload
+                          + static_cast<size_t>((lmdFields >> 40) & 0xfffff);    // lmd payload
+        } else {
+            return false;
+        }
+        if (block.srcSize > srcSize - offset) return false;
+        offset += block.srcSize;
+        dstOffset += block.dstSize;
+        blocks.push_back(block);
+    }
+    return false; // no end of stream marker
+}
+
+// Serial decode, growing the output until it fits when the scanner couldn't size it
+inline bool decodeLzfseSerial(const uint8_t* src, size_t srcSize, std::vector<uint8_t>& out, size_t expectedSize = 0) {
+    std::vector<uint8_t> scratch(lzfse_decode_scratch_size());
+    size_t outAllocatedSize = expectedSize ? expectedSize + 1 : srcSize * 8; // one spare byte tells complete from truncated
+    while (true) {
+        out.resize(outAllocatedSize);
+        size_t decodedSize = lzfse_decode_buffer(out.data(), outAllocatedSize, src, srcSize, scratch.data());
+        if (decodedSize == 0) { // lzfse reports a full buffer as its size, 0 is a corrupt or truncated stream
+            out.clear();
+            return false;
+        }
+        if (decodedSize == outAllocatedSize) {
+            outAllocatedSize *= 2;
+            continue;
+        }
+        out.resize(decodedSize);
+        return true;
+    }
+}
+
+// Decode a whole lzfse stream into out
+// Segments are runs of blocks starting at a compactor marker, or single blocks when the
+// stream has none. They are decoded concurrently into their precomputed output ranges
+// @param threadCount: 0 picks one per hardware thread, the threads inherit the caller's cpu affinity
+inline bool decodeLzfseStream(const uint8_t* src, size_t srcSize, std::vector<uint8_t>& out, unsigned int threadCount = 0) {
+    std::vector<VmaxLzfseBlock> blocks;
+    if (!scanLzfseBlocks(src, srcSize, blocks)) {
+        return decodeLzfseSerial(src, srcSize, out);
+    }
+    size_t rawSize = blocks.empty() ? 0 : blocks.back().dstOffset + blocks.back().dstSize;
+    if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0) threadCount = 1;
+
+    std::vector<std::pair<size_t, size_t>> segments; // [first block, end block)
+    bool marked = false;
+    for (const VmaxLzfseBlock& block : blocks) {
+        marked = marked || (block.magic == kLzfseUncompressedMagic && block.dstSize == 0);
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+        bool startsSegment = i == 0 || !marked || (blocks[i].magic == kLzfseUncompressedMagic && blocks[i].dstSize == 0);
+        if (startsSegment) segments.emplace_back(i, i + 1); else segments.back().second = i + 1;
+    }
+    if (threadCount == 1 || segments.size() < 2 || rawSize < kLzfseParallelMinBytes) {
+        return decodeLzfseSerial(src, srcSize, out, rawSize);
+    }
+
+    out.resize(rawSize);
+    std::atomic<size_t> nextSegment{0};
+    std::atomic<bool> failed{false};
+    auto decodeSegments = [&]() {
+        std::vector<uint8_t> scratch(lzfse_decode_scratch_size());
+        std::vector<uint8_t> stream;
+        for (size_t s = nextSegment++; s < segments.size() && !failed; s = nextSegment++) {
+            const VmaxLzfseBlock& first = blocks[segments[s].first];
+            const VmaxLzfseBlock& last = blocks[segments[s].second - 1];
+            size_t segmentSrcSize = last.srcOffset + last.srcSize - first.srcOffset;
+            size_t segmentDstSize = last.dstOffset + last.dstSize - first.dstOffset;
+            if (segmentDstSize == 0) continue;
+            // The segment as a stream of its own, closed by an end of stream marker
+            stream.resize(segmentSrcSize + 4);
+            std::memcpy(stream.data(), src + first.srcOffset, segmentSrcSize);
+            for (int i = 0; i < 4; i++) stream[segmentSrcSize + i] = static_cast<uint8_t>(kLzfseEndOfStreamMagic >> (i * 8));
+            size_t decodedSize = lzfse_decode_buffer(out.data() + first.dstOffset, segmentDstSize, stream.data(), stream.size(), scratch.data());
+            if (decodedSize != segmentDstSize) failed = true; // reaches into an earlier segment or is corrupt
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < std::min<size_t>(threadCount, segments.size()); i++) {
+        workers.emplace_back(decodeSegments);
+    }
+    decodeSegments();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (failed) {
+        return decodeLzfseSerial(src, srcSize, out, rawSize);
+    }
+    return true;
+}
+
+// Encode raw bytes as a stream of independently decodable segments
+// Each segment is compressed on its own so no match crosses into the previous one
+inline std::vector<uint8_t> encodeLzfseSegments(const uint8_t* raw, size_t rawSize, size_t segmentBytes = kLzfseSegmentBytes) {
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> scratch(lzfse_encode_scratch_size());
+    std::vector<uint8_t> encoded(segmentBytes + segmentBytes / 8 + 4096);
+    auto put32 = [&out](uint32_t value) {
+        for (int i = 0; i < 4; i++) out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    };
+    for (size_t offset = 0; offset < rawSize; offset += segmentBytes) {
+        size_t size = std::min(segmentBytes, rawSize - offset);
+        put32(kLzfseUncompressedMagic); // segment marker, an empty uncompressed block
+        put32(0);
+        size_t encodedSize = lzfse_encode_buffer(encoded.data(), encoded.size(), raw + offset, size, scratch.data());
+        if (encodedSize >= 4) {
+            out.insert(out.end(), encoded.begin(), encoded.begin() + (encodedSize - 4)); // drop its end of stream marker
+        } else { // didn't fit, store the segment uncompressed
+            put32(kLzfseUncompressedMagic);
+            put32(static_cast<uint32_t>(size));
+            out.insert(out.end(), raw + offset, raw + offset + size);
+        }
+    }
+    put32(kLzfseEndOfStreamMagic);
+    return out;
+}
+
+// True when the bytes start like an lzfse stream
+inline bool isLzfseStream(const uint8_t* bytes, size_t size) {
+    if (size < 4) return false;
+    uint32_t magic = static_cast<uint32_t>(lzfseRead(bytes, 0, 4));
+    return magic == kLzfseEndOfStreamMagic || magic == kLzfseUncompressedMagic || magic == kLzfseCompressedV1Magic ||
+           magic == kLzfseCompressedV2Magic || magic == kLzfseCompressedLzvnMagic;
+}
+
+// Re-encode an lzfse file's stream as independent segments, false when it isn't lzfse or doesn't decode
+inline bool compactVmaxLzfse(const std::vector<uint8_t>& compressed, std::vector<uint8_t>& compacted) {
+    if (!isLzfseStream(compressed.data(), compressed.size())) return false;
+    std::vector<uint8_t> raw;
+    if (!decodeLzfseStream(compressed.data(), compressed.size(), raw)) return false;
+    compacted = encodeLzfseSegments(raw.data(), raw.size());
+    return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// NUMA topology, worker pinning and node-local scratch for the --numa mode of vmax2bella
+// On a dual socket machine a worker on one node reading buffers first touched on the other
+// pays remote memory latency on every access. In --numa mode every content is assigned to one
+// node, its read, decode and mesh tasks only run on workers pinned to that node, and those
+// workers allocate (and first touch) its buffers, so with the default first touch policy the
+// memory of a content stays on the node that processes it.
+// Topology comes from /sys/devices/system/node on linux, everywhere else there is one node
+// and --numa changes nothing. No libnuma dependency.
+// Will avoid using bella_sdk
+
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For reading sysfs
+#include <sstream>      // For parsing cpu lists
+#include <algorithm>    // For std::sort
+#include <filesystem>   // For listing nodes
+
+#ifdef __linux__
+#include <pthread.h>    // For pthread_setaffinity_np
+#include <sched.h>      // For cpu_set_t
+#endif
+
+// Parse a sysfs cpu list like "0-15,32-47"
+inline std::vector<int> parseCpuList(const std::string& cpuList) {
+    std::vector<int> cpus;
+    std::stringstream ranges(cpuList);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+struct VmaxNumaTopology {
+    std::vector<std::vector<int>> nodeCpus; // cpus of each node with at least one cpu
+
+    size_t nodeCount() const { return nodeCpus.empty() ? 1 : nodeCpus.size(); }
+
+    static VmaxNumaTopology detect() {
+        VmaxNumaTopology topology;
+#ifdef __linux__
+        std::error_code error;
+        std::vector<std::pair<int, std::vector<int>>> nodes;
+        for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind("node", 0) != 0 || name.size() == 4 || !isdigit(static_cast<unsigned char>(name[4]))) continue;
+            std::ifstream cpuListFile(entry.path() / "cpulist");
+            std::string cpuList;
+            std::getline(cpuListFile, cpuList);
+            std::vector<int> cpus = parseCpuList(cpuList);
+            if (!cpus.empty()) nodes.emplace_back(std::stoi(name.substr(4)), cpus); // memory only nodes have no cpus
+        }
+        std::sort(nodes.begin(), nodes.end());
+        for (auto& node : nodes) {
+            topology.nodeCpus.push_back(std::move(node.second));
+        }
+#endif
+        return topology;
+    }
+};
+
+// Restrict the calling thread to these cpus, false when the platform can't
+inline bool pinCurrentThread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) return false;
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpuSet);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+// Spread contents over nodes largest first, each onto the node with the least work so far
+// Returns the node of every content, the same assignment is used by every stage
+inline std::vector<int> assignNumaNodes(const std::vector<double>& contentCosts, size_t nodeCount) {
+    std::vector<int> nodes(contentCosts.size(), 0);
+    if (nodeCount <= 1) return nodes;
+    std::vector<size_t> order(contentCosts.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return contentCosts[a] > contentCosts[b]; });
+    std::vector<double> nodeLoad(nodeCount, 0.0);
+    for (size_t content : order) {
+        size_t lightest = std::min_element(nodeLoad.begin(), nodeLoad.end()) - nodeLoad.begin();
+        nodes[content] = static_cast<int>(lightest);
+        nodeLoad[lightest] += contentCosts[content];
+    }
+    return nodes;
+}
+
+// Scratch buffer reused by every task a worker runs, grown on demand and never shrunk
+// A pinned worker touches it first so it lives on the worker's node
+inline std::vector<uint8_t>& workerScratch() {
+    thread_local std::vector<uint8_t> scratch;
+    return scratch;
+}
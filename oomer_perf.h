@@ -0,0 +1,91 @@
+#pragma once
+
+// Per phase timings, peak memory and output geometry counts for a conversion
+// Written as json with --stats so make perfcheck can compare runs against a baseline
+// Will avoid using bella_sdk
+
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <chrono>       // For std::chrono::steady_clock
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For writing the stats file
+#include <iostream>     // For input/output operations (cout, cin, etc.)
+#include <utility>      // For std::pair
+
+#ifdef _WIN32
+#include <windows.h>    // For GetProcessMemoryInfo
+#include <psapi.h>
+#else
+#include <sys/resource.h> // For getrusage
+#endif
+
+// Peak resident set size of this process in bytes
+inline uint64_t peakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss); // bytes on macOS
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes on linux
+#endif
+#endif
+}
+
+struct VmaxPerfStats {
+    // Wall time of each phase in order, a phase ends when the next lap() is called
+    std::vector<std::pair<std::string, double>> phases;
+    std::chrono::steady_clock::time_point lapStart = std::chrono::steady_clock::now();
+
+    // Output geometry, changes here mean the converter produces a different scene
+    uint64_t voxels = 0;
+    uint64_t instances = 0;   // instancer boxes
+    uint64_t triangles = 0;
+    uint64_t meshes = 0;
+    uint64_t instancers = 0;
+    uint64_t materials = 0;
+    uint64_t xforms = 0;
+    uint64_t prototypes = 0;  // --subtrees groups emitted once and shared
+    uint64_t groupCopies = 0; // --subtrees groups referencing a prototype
+
+    // Close the current phase under this name and start the next one
+    void lap(const std::string& name) {
+        auto now = std::chrono::steady_clock::now();
+        phases.emplace_back(name, std::chrono::duration<double>(now - lapStart).count());
+        lapStart = now;
+    }
+
+    bool writeJson(const std::string& fileName) const {
+        std::ofstream file(fileName);
+        if (!file) {
+            std::cerr << "Failed to write stats to file: " << fileName << std::endl;
+            return false;
+        }
+        double total = 0.0;
+        file << "{\n  \"phases\": {";
+        for (size_t i = 0; i < phases.size(); i++) {
+            file << (i ? ", " : "") << "\"" << phases[i].first << "\": " << phases[i].second;
+            total += phases[i].second;
+        }
+        file << "},\n";
+        file << "  \"totalSeconds\": " << total << ",\n";
+        file << "  \"peakRssBytes\": " << peakRssBytes() << ",\n";
+        file << "  \"counts\": {"
+             << "\"voxels\": " << voxels
+             << ", \"instances\": " << instances
+             << ", \"triangles\": " << triangles
+             << ", \"meshes\": " << meshes
+             << ", \"instancers\": " << instancers
+             << ", \"materials\": " << materials
+             << ", \"xforms\": " << xforms
+             << ", \"prototypes\": " << prototypes
+             << ", \"groupCopies\": " << groupCopies << "}\n}\n";
+        return true;
+    }
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+// Bounding volume hierarchy over the world space bounds of every object in a vmax scene
+// A scene can hold thousands of instances and nothing used to know where they were. With
+// world bounds (the object's extent under its composed object and group transforms) we can
+// drop instances outside a crop box or a camera frustum, find instances stacked exactly on
+// top of an identical one, and report how dense the scene is, all before any content is
+// decoded or any bella node is created.
+// Works on plain bounds and row vector 4x4 matrices (anything with a double m[4][4])
+// Will avoid using bella_sdk
+
+#include <array>        // For fixed size vectors
+#include <cmath>        // For std::abs, std::tan
+#include <limits>       // For std::numeric_limits
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <iostream>     // For input/output operations (cout, cin, etc.)
+#include <algorithm>    // For std::nth_element
+
+struct VmaxBounds {
+    std::array<double, 3> min = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    std::array<double, 3> max = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+
+    VmaxBounds() {}
+    VmaxBounds(const std::array<double, 3>& minCorner, const std::array<double, 3>& maxCorner) : min(minCorner), max(maxCorner) {}
+
+    bool valid() const { return min[0] <= max[0] && min[1] <= max[1] && min[2] <= max[2]; }
+    double center(int axis) const { return (min[axis] + max[axis]) * 0.5; }
+    double extent(int axis) const { return valid() ? max[axis] - min[axis] : 0.0; }
+    double volume() const { return extent(0) * extent(1) * extent(2); }
+
+    void expand(const std::array<double, 3>& point) {
+        for (int axis = 0; axis < 3; axis++) {
+            min[axis] = std::min(min[axis], point[axis]);
+            max[axis] = std::max(max[axis], point[axis]);
+        }
+    }
+    void expand(const VmaxBounds& other) {
+        if (!other.valid()) return;
+        expand(other.min);
+        expand(other.max);
+    }
+    bool intersects(const VmaxBounds& other) const {
+        for (int axis = 0; axis < 3; axis++) {
+            if (max[axis] < other.min[axis] || other.max[axis] < min[axis]) return false;
+        }
+        return true;
+    }
+};
+
+// Bounds of the 8 transformed corners of a local box, row vector so p' = p * m
+template <typename Matrix>
+VmaxBounds transformVmaxBounds(const VmaxBounds& local, const Matrix& matrix) {
+    VmaxBounds world;
+    for (int corner = 0; corner < 8; corner++) {
+        std::array<double, 3> p = {corner & 1 ? local.max[0] : local.min[0],
+                                   corner & 2 ? local.max[1] : local.min[1],
+                                   corner & 4 ? local.max[2] : local.min[2]};
+        std::array<double, 3> transformed;
+        for (int column = 0; column < 3; column++) {
+            transformed[column] = p[0] * matrix.m[0][column] + p[1] * matrix.m[1][column] + p[2] * matrix.m[2][column] + matrix.m[3][column];
+        }
+        world.expand(transformed);
+    }
+    return world;
+}
+
+// One object of the scene, an instance of a content placed in the world
+struct VmaxSceneInstance {
+    std::string id;                    // object id from scene.json
+    std::string content;               // contentsN.vmaxb it instances
+    std::array<double, 16> worldMatrix; // object transform composed with all its groups, row major
+    VmaxBounds bounds;                 // world space
+
+    template <typename Matrix>
+    VmaxSceneInstance(const std::string& objectId, const std::string& contentName, const Matrix& matrix, const VmaxBounds& localBounds)
+        : id(objectId), content(contentName), bounds(transformVmaxBounds(localBounds, matrix)) {
+        for (int row = 0; row < 4; row++) {
+            for (int column = 0; column < 4; column++) worldMatrix[row * 4 + column] = matrix.m[row][column];
+        }
+    }
+};
+
+// Six inward facing planes (a, b, c, d), a point p is inside when a*x + b*y + c*z + d >= 0 for all
+struct VmaxFrustum {
+    std::array<std::array<double, 4>, 6> planes;
+
+    // Perspective camera at eye looking at target
+    // @param up: world up, vmax2bella scenes are z up
+    static VmaxFrustum fromLookAt(const std::array<double, 3>& eye, const std::array<double, 3>& target,
+                                  double fovYDegrees, double aspect, double nearDistance, double farDistance,
+                                  const std::array<double, 3>& up = {0.0, 0.0, 1.0}) {
+        auto sub = [](const std::array<double, 3>& a, const std::array<double, 3>& b) { return std::array<double, 3>{a[0] - b[0], a[1] - b[1], a[2] - b[2]}; };
+        auto cross = [](const std::array<double, 3>& a, const std::array<double, 3>& b) {
+            return std::array<double, 3>{a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+        };
+        auto normalize = [](std::array<double, 3> v) {
+            double length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+            if (length > 0.0) for (double& c : v) c /= length;
+            return v;
+        };
+        std::array<double, 3> forward = normalize(sub(target, eye));
+        std::array<double, 3> right = normalize(cross(forward, up));
+        std::array<double, 3> cameraUp = cross(right, forward);
+        double tanY = std::tan(fovYDegrees * 3.14159265358979323846 / 360.0);
+        double tanX = tanY * aspect;
+
+        VmaxFrustum frustum;
+        auto plane = [&eye](const std::array<double, 3>& normal, double offset) {
+            double d = -(normal[0] * eye[0] + normal[1] * eye[1] + normal[2] * eye[2]) - offset;
+            return std::array<double, 4>{normal[0], normal[1], normal[2], d};
+        };
+        auto combine = [](const std::array<double, 3>& a, double scale, const std::array<double, 3>& b, double sign) {
+            return std::array<double, 3>{a[0] * scale + b[0] * sign, a[1] * scale + b[1] * sign, a[2] * scale + b[2] * sign};
+        };
+        frustum.planes[0] = plane(forward, nearDistance);
+        frustum.planes[1] = plane({-forward[0], -forward[1], -forward[2]}, -farDistance);
+        frustum.planes[2] = plane(combine(forward, tanX, right, -1.0), 0.0); // right
+        frustum.planes[3] = plane(combine(forward, tanX, right, 1.0), 0.0);  // left
+        frustum.planes[4] = plane(combine(forward, tanY, cameraUp, -1.0), 0.0); // top
+        frustum.planes[5] = plane(combine(forward, tanY, cameraUp, 1.0), 0.0);  // bottom
+        return frustum;
+    }
+
+    // Conservative, a box is only rejected when it is entirely behind one plane
+    bool intersects(const VmaxBounds& bounds) const {
+        for (const auto& p : planes) {
+            double x = p[0] >= 0.0 ? bounds.max[0] : bounds.min[0]; // corner furthest along the normal
+            double y = p[1] >= 0.0 ? bounds.max[1] : bounds.min[1];
+            double z = p[2] >= 0.0 ? bounds.max[2] : bounds.min[2];
+            if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0) return false;
+        }
+        return true;
+    }
+};
+
+struct VmaxSceneDensity {
+    VmaxBounds sceneBounds;
+    size_t instanceCount = 0;
+    size_t nodeCount = 0;
+    int depth = 0;
+    double fillRatio = 0.0;        // summed instance volume / scene volume, above 1 means heavy overlap
+    size_t occupiedCells = 0;      // of kDensityGrid^3 cells over the scene bounds, by instance center
+    size_t busiestCell = 0;        // most instance centers in one cell
+    double meanPerOccupiedCell = 0.0;
+};
+
+class VmaxSceneBvh {
+public:
+    static constexpr int kLeafSize = 4;
+    static constexpr int kDensityGrid = 16;
+
+private:
+    struct Node {
+        VmaxBounds bounds;
+        uint32_t first = 0;  // leaf: first entry of order, inner: left child (right is left + 1)
+        uint32_t count = 0;  // instances in a leaf, 0 for an inner node
+    };
+
+    const std::vector<VmaxSceneInstance>& instances;
+    std::vector<uint32_t> order;  // instance indices, each leaf owns a contiguous range
+    std::vector<Node> nodes;
+    int maxDepth = 0;
+
+    // Median split on the longest axis of the centroids
+    void build(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth) {
+        maxDepth = std::max(maxDepth, depth);
+        VmaxBounds centroids;
+        for (uint32_t i = first; i < first + count; i++) {
+            nodes[nodeIndex].bounds.expand(instances[order[i]].bounds);
+            const VmaxBounds& b = instances[order[i]].bounds;
+            centroids.expand({b.center(0), b.center(1), b.center(2)});
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (centroids.extent(a) > centroids.extent(axis)) axis = a;
+        }
+        if (count <= kLeafSize || centroids.extent(axis) == 0.0) { // all centers coincide, splitting won't help
+            nodes[nodeIndex].first = first;
+            nodes[nodeIndex].count = count;
+            return;
+        }
+        uint32_t half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                         [this, axis](uint32_t a, uint32_t b) { return instances[a].bounds.center(axis) < instances[b].bounds.center(axis); });
+        uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        nodes.emplace_back();
+        nodes[nodeIndex].first = left;
+        nodes[nodeIndex].count = 0;
+        build(left, first, half, depth + 1);
+        build(left + 1, first + half, count - half, depth + 1);
+    }
+
+    template <typename Overlaps>
+    std::vector<size_t> collect(const Overlaps& overlaps) const {
+        std::vector<size_t> found;
+        if (nodes.empty()) return found;
+        std::vector<uint32_t> stack = {0};
+        while (!stack.empty()) {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (!overlaps(node.bounds)) continue;
+            if (node.count == 0) {
+                stack.push_back(node.first);
+                stack.push_back(node.first + 1);
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (overlaps(instances[order[i]].bounds)) found.push_back(order[i]);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+public:
+    // The instances must outlive the bvh
+    explicit VmaxSceneBvh(const std::vector<VmaxSceneInstance>& sceneInstances) : instances(sceneInstances) {
+        if (instances.empty()) return;
+        order.resize(instances.size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        nodes.reserve(instances.size() * 2);
+        nodes.emplace_back();
+        build(0, 0, static_cast<uint32_t>(order.size()), 1);
+    }
+
+    // Instances whose bounds touch the box, in index order
+    std::vector<size_t> queryBox(const VmaxBounds& box) const {
+        return collect([&box](const VmaxBounds& bounds) { return bounds.intersects(box); });
+    }
+
+    // Instances possibly visible from the camera, in index order
+    std::vector<size_t> queryFrustum(const VmaxFrustum& frustum) const {
+        return collect([&frustum](const VmaxBounds& bounds) { return frustum.intersects(bounds); });
+    }
+
+    // Later instances of a content placed with the same world matrix as an earlier one
+    // They render exactly on top of it, so they only cost memory and bvh time in bella
+    std::vector<size_t> findDuplicates(double tolerance = 1e-6) const {
+        std::vector<size_t> duplicates;
+        for (size_t i = 0; i < instances.size(); i++) {
+            for (size_t candidate : queryBox(instances[i].bounds)) {
+                if (candidate >= i) break; // only earlier instances can make this one a duplicate
+                const VmaxSceneInstance& other = instances[candidate];
+                if (other.content != instances[i].content) continue;
+                bool same = true;
+                for (int k = 0; k < 16 && same; k++) {
+                    same = std::abs(other.worldMatrix[k] - instances[i].worldMatrix[k]) <= tolerance * std::max(1.0, std::abs(other.worldMatrix[k]));
+                }
+                if (same) {
+                    duplicates.push_back(i);
+                    break;
+                }
+            }
+        }
+        return duplicates;
+    }
+
+    VmaxSceneDensity density() const {
+        VmaxSceneDensity report;
+        report.instanceCount = instances.size();
+        report.nodeCount = nodes.size();
+        report.depth = maxDepth;
+        if (nodes.empty()) return report;
+        report.sceneBounds = nodes[0].bounds;
+        double sceneVolume = report.sceneBounds.volume();
+        double instanceVolume = 0.0;
+        std::vector<uint32_t> cells(kDensityGrid * kDensityGrid * kDensityGrid, 0);
+        for (const VmaxSceneInstance& instance : instances) {
+            instanceVolume += instance.bounds.volume();
+            int cell[3];
+            for (int axis = 0; axis < 3; axis++) {
+                double extent = report.sceneBounds.extent(axis);
+                double t = extent > 0.0 ? (instance.bounds.center(axis) - report.sceneBounds.min[axis]) / extent : 0.0;
+                cell[axis] = std::min(kDensityGrid - 1, std::max(0, static_cast<int>(t * kDensityGrid)));
+            }
+            cells[cell[0] + cell[1] * kDensityGrid + cell[2] * kDensityGrid * kDensityGrid]++;
+        }
+        report.fillRatio = sceneVolume > 0.0 ? instanceVolume / sceneVolume : 0.0;
+        for (uint32_t count : cells) {
+            if (count == 0) continue;
+            report.occupiedCells++;
+            report.busiestCell = std::max<size_t>(report.busiestCell, count);
+        }
+        report.meanPerOccupiedCell = report.occupiedCells ? static_cast<double>(instances.size()) / report.occupiedCells : 0.0;
+        return report;
+    }
+
+    size_t size() const { return instances.size(); }
+};
+
+inline void printVmaxSceneDensity(const VmaxSceneDensity& report) {
+    std::cout << "scene density: " << report.instanceCount << " instances, bvh " << report.nodeCount << " nodes depth " << report.depth << std::endl;
+    if (!report.sceneBounds.valid()) return;
+    std::cout << "  bounds: (" << report.sceneBounds.min[0] << ", " << report.sceneBounds.min[1] << ", " << report.sceneBounds.min[2] << ") - ("
+              << report.sceneBounds.max[0] << ", " << report.sceneBounds.max[1] << ", " << report.sceneBounds.max[2] << ")" << std::endl;
+    std::cout << "  fill ratio: " << report.fillRatio << " (summed instance volume / scene volume)" << std::endl;
+    int totalCells = VmaxSceneBvh::kDensityGrid * VmaxSceneBvh::kDensityGrid * VmaxSceneBvh::kDensityGrid;
+    std::cout << "  occupied cells: " << report.occupiedCells << " of " << totalCells
+              << ", busiest " << report.busiestCell << ", mean " << report.meanPerOccupiedCell << " instances" << std::endl;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+// Subtree instancing for duplicated VoxelMax groups
+// Duplicating a group in VoxelMax (a house with its furniture, a vehicle) copies the whole
+// subtree, scene.json then holds structurally identical groups that differ only in their own
+// transform. Two groups are isomorphic when they hold objects of the same contents and child
+// groups that are isomorphic, all under the same relative transforms. Of every set of
+// isomorphic groups the first is kept as the prototype, the other copies keep just their own
+// xform and reference the prototype's contents, everything below a copy is dropped.
+// Larger subtrees are matched first so a duplicated street claims its houses before the
+// houses are matched on their own. Groups inside a prototype stay available, so the houses
+// of the kept street can still become the prototype of a house standing elsewhere.
+// Templated on the scene.json info structs so the library and vmax2bella both use it
+// Will avoid using bella_sdk
+
+#include <map>          // For std::map
+#include <set>          // For std::set
+#include <cmath>        // For std::llround
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <algorithm>    // For std::sort
+
+struct VmaxSubtreeInstancing {
+    std::set<std::string> prototypes;              // groups whose subtree is emitted and shared
+    std::map<std::string, std::string> copyOf;     // copy group -> its prototype group
+    std::set<std::string> droppedGroups;           // groups below a copy, never emitted
+    std::set<std::string> droppedObjects;          // objects below a copy, placed through the prototype
+};
+
+// Transform of a child relative to its group, rounded so json round trips still match
+inline std::string subtreeTransformKey(const std::vector<double>& position,
+                                       const std::vector<double>& rotation,
+                                       const std::vector<double>& scale) {
+    std::string key;
+    for (const std::vector<double>* values : {&position, &rotation, &scale}) {
+        for (double value : *values) {
+            key += std::to_string(std::llround(value * 1e5)) + ",";
+        }
+        key += ";";
+    }
+    return key;
+}
+
+// Find isomorphic group subtrees
+// @param groups: scene.json groups by id
+// @param contents: scene.json objects by content, as getModelContentVMaxbMap returns them
+template <typename GroupInfo, typename ModelInfo>
+VmaxSubtreeInstancing findInstancedSubtrees(const std::map<std::string, GroupInfo>& groups,
+                                            const std::map<std::string, std::vector<ModelInfo>>& contents) {
+    std::map<std::string, std::vector<std::string>> childGroups;
+    std::map<std::string, std::vector<const ModelInfo*>> childObjects;
+    for (const auto& [groupId, groupInfo] : groups) {
+        if (groups.count(groupInfo.parentId)) childGroups[groupInfo.parentId].push_back(groupId);
+    }
+    for (const auto& [contentName, objects] : contents) {
+        for (const ModelInfo& object : objects) {
+            if (groups.count(object.parentId)) childObjects[object.parentId].push_back(&object);
+        }
+    }
+
+    // Signatures are interned, a child group contributes its signature number not its text
+    std::map<std::string, size_t> signatureIds;
+    std::map<std::string, size_t> groupSignature;
+    std::map<std::string, size_t> subtreeSize;   // groups and objects below, ancestors are always larger
+    std::map<std::string, size_t> subtreeObjects;
+    auto signatureOf = [&](const std::string& groupId, auto& self) -> size_t {
+        auto known = groupSignature.find(groupId);
+        if (known != groupSignature.end()) return known->second;
+        std::vector<std::string> entries;
+        size_t size = 0;
+        size_t objectCount = 0;
+        for (const ModelInfo* object : childObjects[groupId]) {
+            entries.push_back("o" + object->dataFile + "@" + subtreeTransformKey(object->position, object->rotation, object->scale));
+            size++;
+            objectCount++;
+        }
+        for (const std::string& childId : childGroups[groupId]) {
+            const GroupInfo& child = groups.at(childId);
+            entries.push_back("g" + std::to_string(self(childId, self)) + "@" + subtreeTransformKey(child.position, child.rotation, child.scale));
+            size += 1 + subtreeSize[childId];
+            objectCount += subtreeObjects[childId];
+        }
+        std::sort(entries.begin(), entries.end()); // child order in scene.json doesn't matter
+        std::string signature;
+        for (const std::string& entry : entries) signature += entry + "|";
+        size_t id = signatureIds.emplace(signature, signatureIds.size()).first->second;
+        groupSignature[groupId] = id;
+        subtreeSize[groupId] = size;
+        subtreeObjects[groupId] = objectCount;
+        return id;
+    };
+
+    std::map<size_t, std::vector<std::string>> groupsBySignature;
+    std::vector<std::string> order;
+    for (const auto& [groupId, groupInfo] : groups) {
+        groupsBySignature[signatureOf(groupId, signatureOf)].push_back(groupId);
+        order.push_back(groupId);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const std::string& a, const std::string& b) {
+        return subtreeSize[a] > subtreeSize[b];
+    });
+
+    VmaxSubtreeInstancing instancing;
+    std::set<std::string> claimed; // prototypes, copies and everything dropped below copies
+    auto dropBelow = [&](const std::string& groupId, auto& self) -> void {
+        for (const ModelInfo* object : childObjects[groupId]) {
+            instancing.droppedObjects.insert(object->id);
+        }
+        for (const std::string& childId : childGroups[groupId]) {
+            claimed.insert(childId);
+            instancing.droppedGroups.insert(childId);
+            self(childId, self);
+        }
+    };
+    for (const std::string& groupId : order) {
+        if (claimed.count(groupId) || subtreeObjects[groupId] == 0) continue;
+        std::vector<std::string> copies;
+        for (const std::string& candidate : groupsBySignature[groupSignature[groupId]]) {
+            if (!claimed.count(candidate)) copies.push_back(candidate);
+        }
+        if (copies.size() < 2) continue;
+        const std::string& prototype = copies.front();
+        instancing.prototypes.insert(prototype);
+        for (const std::string& copy : copies) {
+            claimed.insert(copy);
+            if (copy == prototype) continue;
+            instancing.copyOf[copy] = prototype;
+            dropBelow(copy, dropBelow);
+        }
+    }
+    return instancing;
+}
+
+// Remove the objects placed through a prototype, and contents left without objects
+template <typename ModelInfo>
+void removeInstancedObjects(std::map<std::string, std::vector<ModelInfo>>& contents, const VmaxSubtreeInstancing& instancing) {
+    for (auto content = contents.begin(); content != contents.end();) {
+        std::vector<ModelInfo>& objects = content->second;
+        objects.erase(std::remove_if(objects.begin(), objects.end(), [&](const ModelInfo& object) {
+            return instancing.droppedObjects.count(object.id) > 0;
+        }), objects.end());
+        content = objects.empty() ? contents.erase(content) : std::next(content);
+    }
+}
+
+// Whether a prototype group is among the object's ancestors, every copy of the prototype
+// shows the object through the shared xform so it must stay in the node tree
+template <typename ModelInfo, typename GroupInfo>
+bool insidePrototype(const ModelInfo& object, const std::map<std::string, GroupInfo>& groups, const VmaxSubtreeInstancing& instancing) {
+    std::string parentId = object.parentId;
+    while (!parentId.empty()) {
+        if (instancing.prototypes.count(parentId)) return true;
+        auto parent = groups.find(parentId);
+        if (parent == groups.end()) break;
+        parentId = parent->second.parentId;
+    }
+    return false;
+}
@@ -0,0 +1,375 @@
+#pragma once
+
+// Dependency aware task graph executor used by vmax2bella
+// Conversion work is very uneven, one content can hold 2M voxels and another 200,
+// and one color bucket can dominate a model. Running tasks in submission order leaves
+// the giant job for last and the whole conversion waits on it.
+// Every task gets an upward rank (its cost plus the most expensive chain of tasks that
+// depend on it) and workers always run the highest ranked ready task, so the critical
+// path starts first. Each worker owns a ready queue, newly ready dependents stay on the
+// worker that produced their input and idle workers steal the best task from the others.
+// Started with a NUMA topology, workers are pinned to nodes and a task added with a node only
+// runs on workers of that node, so everything one content allocates stays node local.
+// A running task may add more tasks, for work whose shape is only known once its input
+// is decoded. They are held until the adding task returns so their dependencies can be
+// declared first, and skipped like any other dependent if it fails.
+// Will avoid using bella_sdk, bella nodes must only be touched from the main thread
+
+#include <mutex>              // For std::mutex
+#include <atomic>             // For std::atomic
+#include <memory>             // For std::unique_ptr
+#include <string>             // For std::string
+#include <thread>             // For std::thread
+#include <vector>             // For dynamic arrays (vectors)
+#include <cstddef>            // For size_t
+#include <algorithm>          // For std::push_heap, std::pop_heap
+#include <exception>          // For std::exception_ptr
+#include <functional>         // For std::function
+#include <stdexcept>          // For std::logic_error
+#include <condition_variable> // For waking workers and waiters
+
+#include "oomer_numa.h"       // For pinning workers to nodes
+
+class VmaxTaskGraph {
+public:
+    using TaskId = size_t;
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> work;
+        double cost = 1.0;
+        double rank = 0.0;                 // cost + highest rank of any dependent
+        int node = -1;                     // only runs on workers of this node, -1 anywhere
+        std::vector<TaskId> dependents;
+        std::atomic<int> pendingInputs{0}; // dependencies not finished yet
+        bool done = false;                 // guarded by doneMutex
+        std::exception_ptr error;          // set by the task or inherited from a failed input
+    };
+
+    // Ready tasks of one worker, a max heap on rank
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::vector<TaskId> heap;
+    };
+
+    // Tasks live in fixed blocks so running workers can read them while another task adds
+    // more, the block table is allocated once and a block never moves
+    static constexpr size_t kBlockSize = 1024;
+    static constexpr size_t kMaxBlocks = 4096;
+    std::unique_ptr<std::unique_ptr<Task[]>[]> blocks;
+    std::atomic<size_t> taskCount{0};
+    std::mutex addMutex;
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::vector<TaskId>> heldTasks;   // added by the task each worker is running
+    std::vector<std::thread> workers;
+    bool started = false;
+
+    size_t nodeCount = 1;
+    std::vector<int> workerNodes;                 // node of every worker, all 0 without NUMA
+    std::vector<std::vector<size_t>> nodeWorkers; // workers of every node
+    std::atomic<size_t> nextRouted{0};            // round robin over the workers of a node
+
+    std::mutex idleMutex;
+    std::condition_variable idleCondition;
+    std::atomic<size_t> readyCount{0};            // ready tasks that any worker may run
+    std::unique_ptr<std::atomic<size_t>[]> nodeReadyCount; // ready tasks pinned to each node
+    std::atomic<size_t> remainingCount{0};
+
+    std::mutex doneMutex;                         // also guards dependents once started
+    std::condition_variable doneCondition;
+
+    // Worker running on this thread, tasks it adds are held on its own list
+    static const VmaxTaskGraph*& currentGraph() { static thread_local const VmaxTaskGraph* graph = nullptr; return graph; }
+    static size_t& currentWorker() { static thread_local size_t worker = 0; return worker; }
+
+    Task& task(TaskId id) const { return blocks[id / kBlockSize][id % kBlockSize]; }
+
+    bool higherRank(TaskId a, TaskId b) const { return task(a).rank < task(b).rank; }
+
+    std::atomic<size_t>& readyCounter(TaskId id) {
+        return task(id).node < 0 ? readyCount : nodeReadyCount[task(id).node];
+    }
+
+    // Pinned tasks readied on another node move to a worker of their own node
+    void pushReady(size_t worker, TaskId id) {
+        int node = task(id).node;
+        if (node >= 0 && workerNodes[worker] != node) {
+            const std::vector<size_t>& candidates = nodeWorkers[node];
+            worker = candidates[nextRouted++ % candidates.size()];
+        }
+        WorkerQueue& queue = *queues[worker];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.heap.push_back(id);
+            std::push_heap(queue.heap.begin(), queue.heap.end(), [this](TaskId a, TaskId b) { return higherRank(a, b); });
+        }
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            readyCounter(id)++;
+        }
+        if (node >= 0) {
+            idleCondition.notify_all(); // notify_one could wake a worker of another node
+        } else {
+            idleCondition.notify_one();
+        }
+    }
+
+    bool popFrom(size_t worker, TaskId& id) {
+        WorkerQueue& queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.heap.empty()) return false;
+        std::pop_heap(queue.heap.begin(), queue.heap.end(), [this](TaskId a, TaskId b) { return higherRank(a, b); });
+        id = queue.heap.back();
+        queue.heap.pop_back();
+        readyCounter(id)--;
+        return true;
+    }
+
+    // Best unpinned task of a worker on another node, the heap front may be pinned there
+    bool popUnpinnedFrom(size_t worker, TaskId& id) {
+        WorkerQueue& queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        auto best = queue.heap.end();
+        for (auto it = queue.heap.begin(); it != queue.heap.end(); ++it) {
+            if (task(*it).node < 0 && (best == queue.heap.end() || higherRank(*best, *it))) best = it;
+        }
+        if (best == queue.heap.end()) return false;
+        id = *best;
+        queue.heap.erase(best);
+        std::make_heap(queue.heap.begin(), queue.heap.end(), [this](TaskId a, TaskId b) { return higherRank(a, b); });
+        readyCounter(id)--;
+        return true;
+    }
+
+    // Own queue first, otherwise steal the best task of the worker with the best task
+    // on this node, and only then an unpinned task from another node
+    bool findTask(size_t worker, TaskId& id) {
+        if (popFrom(worker, id)) return true;
+        size_t victim = queues.size();
+        double bestRank = -1.0;
+        for (size_t i : nodeWorkers[workerNodes[worker]]) {
+            if (i == worker) continue;
+            std::lock_guard<std::mutex> lock(queues[i]->mutex);
+            if (!queues[i]->heap.empty() && task(queues[i]->heap.front()).rank > bestRank) {
+                bestRank = task(queues[i]->heap.front()).rank;
+                victim = i;
+            }
+        }
+        if (victim < queues.size() && popFrom(victim, id)) return true;
+        if (readyCount == 0) return false;
+        for (size_t i = 0; i < queues.size(); i++) {
+            if (workerNodes[i] != workerNodes[worker] && popUnpinnedFrom(i, id)) return true;
+        }
+        return false;
+    }
+
+    void complete(size_t worker, TaskId id) {
+        Task& finished = task(id);
+        std::vector<TaskId> dependents;
+        {
+            // Once done, depend() on this task no longer waits for it
+            std::lock_guard<std::mutex> lock(doneMutex);
+            finished.done = true;
+            dependents = finished.dependents;
+            for (TaskId dependentId : dependents) {
+                Task& dependent = task(dependentId);
+                if (finished.error && !dependent.error) dependent.error = finished.error; // inputs missing, skip the work
+            }
+        }
+        doneCondition.notify_all();
+        for (TaskId dependentId : dependents) {
+            if (--task(dependentId).pendingInputs == 0) {
+                pushReady(worker, dependentId);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            remainingCount--;
+        }
+        idleCondition.notify_all();
+    }
+
+    void workerLoop(size_t worker) {
+        std::atomic<size_t>& nodeReady = nodeReadyCount[workerNodes[worker]];
+        while (true) {
+            TaskId id;
+            if (findTask(worker, id)) {
+                Task& running = task(id);
+                if (!running.error) {
+                    try {
+                        running.work();
+                    } catch (...) {
+                        running.error = std::current_exception();
+                    }
+                }
+                running.work = nullptr; // release captured buffers early
+                if (!heldTasks[worker].empty()) releaseHeld(worker, running.error);
+                complete(worker, id);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idleMutex);
+            if (remainingCount == 0) return;
+            idleCondition.wait(lock, [this, &nodeReady] { return readyCount > 0 || nodeReady > 0 || remainingCount == 0; });
+        }
+    }
+
+    // Upward rank in reverse topological order, tasks are always added before their
+    // dependents can be declared so a reverse walk over ids is enough
+    void computeRank(TaskId id) {
+        Task& ranked = task(id);
+        double longest = 0.0;
+        for (TaskId dependentId : ranked.dependents) {
+            longest = std::max(longest, task(dependentId).rank);
+        }
+        ranked.rank = ranked.cost + longest;
+    }
+
+    // Rank the tasks a finished task added, highest ids first like start(), and let them run
+    void releaseHeld(size_t worker, std::exception_ptr error) {
+        std::vector<TaskId> held;
+        held.swap(heldTasks[worker]);
+        {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            for (size_t i = held.size(); i-- > 0;) {
+                computeRank(held[i]);
+                if (error && !task(held[i]).error) task(held[i]).error = error;
+            }
+        }
+        for (TaskId id : held) {
+            if (--task(id).pendingInputs == 0) pushReady(worker, id);
+        }
+    }
+
+public:
+    VmaxTaskGraph() : blocks(std::make_unique<std::unique_ptr<Task[]>[]>(kMaxBlocks)) {}
+    ~VmaxTaskGraph() {
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    VmaxTaskGraph(const VmaxTaskGraph&) = delete;
+    VmaxTaskGraph& operator=(const VmaxTaskGraph&) = delete;
+
+    // @param cost: estimated work in any consistent unit, only the ordering matters
+    // @param node: NUMA node the task has to run on, -1 for any, ignored when started without NUMA
+    // Once started only a running task of this graph may add, the new task is held until that task returns
+    TaskId add(const std::string& name, double cost, std::function<void()> work, int node = -1) {
+        if (started && currentGraph() != this) throw std::logic_error("VmaxTaskGraph: add after start outside a task");
+        TaskId id;
+        {
+            std::lock_guard<std::mutex> lock(addMutex);
+            id = taskCount;
+            if (id / kBlockSize >= kMaxBlocks) throw std::length_error("VmaxTaskGraph: too many tasks");
+            if (!blocks[id / kBlockSize]) blocks[id / kBlockSize] = std::make_unique<Task[]>(kBlockSize);
+            Task& added = task(id);
+            added.name = name;
+            added.cost = cost;
+            added.node = node;
+            added.work = std::move(work);
+            if (started) {
+                added.node = nodeCount > 1 && node >= 0 ? node % static_cast<int>(nodeCount) : -1;
+                added.pendingInputs = 1; // the hold dropped by releaseHeld()
+            }
+            taskCount = id + 1;
+        }
+        if (started) {
+            heldTasks[currentWorker()].push_back(id);
+            std::lock_guard<std::mutex> lock(idleMutex);
+            remainingCount++; // the adding task is still running so the workers are still there
+        }
+        return id;
+    }
+
+    // after may only run once before has finished
+    // Once started, after must be a held task, a before that already finished is no dependency
+    void depend(TaskId before, TaskId after) {
+        if (before >= after) throw std::logic_error("VmaxTaskGraph: dependencies must point to later tasks");
+        std::lock_guard<std::mutex> lock(doneMutex);
+        Task& input = task(before);
+        if (input.done) {
+            if (input.error && !task(after).error) task(after).error = input.error;
+            return;
+        }
+        input.dependents.push_back(after);
+        task(after).pendingInputs++;
+    }
+
+    // Refine the estimate of a task that isn't ready yet, for example once a read
+    // task knows the voxel counts its decode task will have to process
+    void setCost(TaskId id, double cost) {
+        task(id).cost = cost;
+        computeRank(id);
+    }
+
+    // Start running, the calling thread is free to wait() for results in any order
+    // @param threadCount: number of workers, 0 picks one per hardware thread
+    // @param numa: spread the workers over its nodes and pin them, nullptr leaves placement to the OS
+    void start(unsigned int threadCount = 0, const VmaxNumaTopology* numa = nullptr) {
+        if (started) return;
+        started = true;
+        if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) threadCount = 1;
+        for (size_t i = taskCount; i-- > 0;) {
+            computeRank(i);
+        }
+
+        // Every node gets a worker before any node gets a second one
+        nodeCount = numa ? std::min<size_t>(numa->nodeCount(), threadCount) : 1;
+        nodeWorkers.assign(nodeCount, {});
+        nodeReadyCount = std::make_unique<std::atomic<size_t>[]>(nodeCount);
+        heldTasks.resize(threadCount);
+        for (unsigned int i = 0; i < threadCount; i++) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+            workerNodes.push_back(static_cast<int>(i % nodeCount));
+            nodeWorkers[i % nodeCount].push_back(i);
+        }
+        for (TaskId id = 0; id < taskCount; id++) {
+            Task& placed = task(id);
+            placed.node = nodeCount > 1 && placed.node >= 0 ? placed.node % static_cast<int>(nodeCount) : -1;
+        }
+        remainingCount = taskCount.load();
+
+        // Seed the roots largest first, dealt round robin so every worker starts busy
+        std::vector<TaskId> roots;
+        for (TaskId id = 0; id < taskCount; id++) {
+            if (task(id).pendingInputs == 0) roots.push_back(id);
+        }
+        std::sort(roots.begin(), roots.end(), [this](TaskId a, TaskId b) { return task(a).rank > task(b).rank; });
+        for (size_t i = 0; i < roots.size(); i++) {
+            pushReady(i % threadCount, roots[i]);
+        }
+        for (unsigned int i = 0; i < threadCount; i++) {
+            std::vector<int> cpus = nodeCount > 1 ? numa->nodeCpus[workerNodes[i]] : std::vector<int>();
+            workers.emplace_back([this, i, cpus] {
+                pinCurrentThread(cpus); // before the first task so its allocations are node local
+                currentGraph() = this;
+                currentWorker() = i;
+                workerLoop(i);
+            });
+        }
+    }
+
+    // Block until a task finished, rethrows its exception
+    void wait(TaskId id) {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [this, id] { return task(id).done; });
+        if (task(id).error) std::rethrow_exception(task(id).error);
+    }
+
+    // Run whatever is left and join the workers, rethrows the first failure
+    void finish() {
+        start();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+        for (TaskId id = 0; id < taskCount; id++) {
+            if (task(id).error) std::rethrow_exception(task(id).error);
+        }
+    }
+
+    size_t size() const { return taskCount; }
+    size_t threadCount() const { return queues.size(); }
+};
@@ -0,0 +1,219 @@
+#pragma once
+
+// In memory conversion of a VoxelMax .vmax package into geometry buffers
+// For services that embed the converter instead of spawning vmax2bella, writing a .bsz
+// and reading it back. Every input comes through a file provider callback and every output
+// is an owned buffer, nothing is global so a process can run any number of conversions at once.
+// Will avoid using bella_sdk, callers build their scene (or bella nodes) from the buffers
+
+#include "oomer_voxel_vmax.h"
+#include "oomer_voxel_ogt.h"
+
+#include <array>        // For per model materials
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For the directory provider
+#include <stdexcept>    // For std::runtime_error
+#include <functional>   // For std::function
+
+// Fill bytes with a file of the package and return true, false when it doesn't exist
+// name is relative to the package: "scene.json", "contents1.vmaxb", "palette1.png", "palette1.settings.vmaxpsb"
+// Only called from the thread running convertVmax
+using VmaxFileProvider = std::function<bool(const std::string& name, std::vector<uint8_t>& bytes)>;
+
+struct VmaxConvertOptions {
+    bool mesh = false;    // mesh every bucket, otherwise voxels come back as box instances (liquid is always a mesh)
+    bool greedy = false;  // merge coplanar faces when meshing
+};
+
+// One (material, color) bucket of a model
+struct VmaxBucketBuffer {
+    int material = 0;                // 0-7
+    int color = 0;                   // palette index 1-255
+    std::vector<float> positions;    // mesh: xyz per vertex in model space
+    std::vector<uint32_t> indices;   // mesh: 3 per triangle
+    std::vector<float> translations; // boxes: xyz center per voxel instance
+};
+
+// A canonical model, objects instance it with their world matrix
+struct VmaxModelBuffer {
+    std::string name;                  // contentsN.vmaxb
+    std::vector<VmaxRGBA> palette;     // 256 colors, bucket color c uses palette[c-1]
+    std::array<VmaxMaterial, 8> materials;
+    std::vector<VmaxBucketBuffer> buckets;
+};
+
+struct VmaxObjectBuffer {
+    std::string id;
+    std::string name;
+    size_t model = 0;                  // index into VmaxConversion::models
+    VmaxMatrix4x4 worldMatrix;         // object transform composed with all its groups, row vector
+};
+
+struct VmaxConversion {
+    std::vector<VmaxModelBuffer> models;
+    std::vector<VmaxObjectBuffer> objects;
+};
+
+// Provider reading straight from an unzipped .vmax directory, handy for tests and tools
+inline VmaxFileProvider vmaxDirectoryProvider(const std::string& vmaxDirName) {
+    return [vmaxDirName](const std::string& name, std::vector<uint8_t>& bytes) {
+        std::ifstream file(vmaxDirName + "/" + name, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+        bytes.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        return static_cast<bool>(file);
+    };
+}
+
+inline std::vector<uint8_t> provideVmaxFile(const VmaxFileProvider& provider, const std::string& name) {
+    std::vector<uint8_t> bytes;
+    if (!provider(name, bytes)) {
+        throw std::runtime_error("vmax file not provided: " + name);
+    }
+    return bytes;
+}
+
+// Mesh one bucket with ogt, positions come back in model space
+// The grid is sized from the bucket's bounds in the occupancy summary instead of a pass over its voxels
+inline void meshVmaxBucket(const VmaxModel& vmaxModel, int material, int color, bool simple, VmaxBucketBuffer& bucket) {
+    const std::vector<VmaxVoxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
+    const VmaxOccupancySummary::Bounds& bounds = vmaxModel.occupancy.bucketBoundsOf(material, color);
+    uint32_t sizeX = 1, sizeY = 1, sizeZ = 1; // voxel coordinates are 0-based
+    if (!bounds.empty) {
+        sizeX = static_cast<uint32_t>(bounds.hi[0]) + 1;
+        sizeY = static_cast<uint32_t>(bounds.hi[1]) + 1;
+        sizeZ = static_cast<uint32_t>(bounds.hi[2]) + 1;
+    }
+    std::vector<uint8_t> grid(static_cast<size_t>(sizeX) * sizeY * sizeZ, 0);
+    for (const auto& voxel : voxelsOfType) {
+        grid[voxel.x + voxel.y * sizeX + static_cast<size_t>(voxel.z) * sizeX * sizeY] = 1;
+    }
+    ogt_mesh_rgba palette[256] = {}; // vertex colors are unused, the bucket carries the color
+    palette[1] = ogt_mesh_rgba{255, 255, 255, 255};
+
+    ogt_voxel_meshify_context ctx = {};
+    ogt_mesh* mesh = simple ? ogt_mesh_from_paletted_voxels_simple(&ctx, grid.data(), sizeX, sizeY, sizeZ, palette)
+                            : ogt_mesh_from_paletted_voxels_greedy(&ctx, grid.data(), sizeX, sizeY, sizeZ, palette);
+    bucket.positions.reserve(mesh->vertex_count * 3);
+    for (uint32_t i = 0; i < mesh->vertex_count; i++) {
+        bucket.positions.push_back(mesh->vertices[i].pos.x);
+        bucket.positions.push_back(mesh->vertices[i].pos.y);
+        bucket.positions.push_back(mesh->vertices[i].pos.z);
+    }
+    bucket.indices.assign(mesh->indices, mesh->indices + mesh->index_count);
+    ogt_mesh_destroy(&ctx, mesh);
+}
+
+// Decode a contentsN.vmaxb held in memory, lzfse compressed as it is on disk, into vmaxModel
+// Touches nothing but its arguments so any number can run at once, see the Python module
+inline void decodeVmaxModel(const uint8_t* bytes, size_t size, VmaxModel& vmaxModel) {
+    plist_t plist_model_root = readPlistFromMemory(bytes, size, true); // decompress=true
+    if (!plist_model_root) { throw std::runtime_error("Failed to read model from: " + vmaxModel.vmaxbFileName); }
+    plist_t plist_snapshots_array = plist_dict_get_item(plist_model_root, "snapshots");
+    uint32_t snapshots_array_size = plist_array_get_size(plist_snapshots_array);
+    for (uint32_t i = 0; i < snapshots_array_size; i++) {
+        plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
+        plist_t plist_datastream = getNestedPlistNode(plist_snapshot, {"s", "ds"});
+        VmaxChunkInfo chunkInfo = vmaxChunkInfo(plist_snapshot);
+        uint64_t length = 0;
+        const uint8_t* data = plist_datastream ? reinterpret_cast<const uint8_t*>(plist_get_data_ptr(plist_datastream, &length)) : nullptr;
+        for (const VmaxStreamVoxel& voxel : VmaxSnapshotVoxels(data, length, chunkInfo.id, chunkInfo.mortoncode)) {
+            vmaxModel.addVoxel(voxel.infoX, voxel.infoY, voxel.infoZ, voxel.material, voxel.color, chunkInfo.id, chunkInfo.mortoncode);
+        }
+    }
+    plist_free(plist_model_root);
+}
+
+// Decode one content and its palette and materials, then fill its bucket buffers
+inline VmaxModelBuffer convertVmaxContent(const VmaxFileProvider& provider,
+                                          const JsonModelInfo& jsonModelInfo,
+                                          const VmaxConvertOptions& options) {
+    VmaxModelBuffer modelBuffer;
+    modelBuffer.name = jsonModelInfo.dataFile;
+
+    std::vector<uint8_t> pngBytes = provideVmaxFile(provider, jsonModelInfo.paletteFile);
+    modelBuffer.palette = read256x1PaletteFromMemory(pngBytes.data(), pngBytes.size());
+    if (modelBuffer.palette.empty()) { throw std::runtime_error("Failed to read palette from: png " + jsonModelInfo.paletteFile); }
+
+    std::string materialName = jsonModelInfo.paletteFile;
+    size_t pngExtension = materialName.rfind(".png");
+    if (pngExtension != std::string::npos) {
+        materialName.replace(pngExtension, 4, ".settings.vmaxpsb");
+    }
+    std::vector<uint8_t> materialBytes = provideVmaxFile(provider, materialName);
+    plist_t plist_material = readPlistFromMemory(materialBytes.data(), materialBytes.size(), false); // decompress=false
+    if (!plist_material) { throw std::runtime_error("Failed to read materials from: " + materialName); }
+    modelBuffer.materials = getVmaxMaterials(plist_material);
+    plist_free(plist_material);
+
+    VmaxModel vmaxModel(jsonModelInfo.dataFile);
+    {
+        std::vector<uint8_t> modelBytes = provideVmaxFile(provider, jsonModelInfo.dataFile);
+        decodeVmaxModel(modelBytes.data(), modelBytes.size(), vmaxModel);
+    } // compressed bytes aren't needed anymore
+
+    for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+        for (int color : colorID) {
+            const std::vector<VmaxVoxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
+            VmaxBucketBuffer bucket;
+            bucket.material = material;
+            bucket.color = color;
+            if (options.mesh || material == 7) { // liquid is always a mesh
+                meshVmaxBucket(vmaxModel, material, color, !options.greedy || material == 7, bucket);
+            } else {
+                bucket.translations.reserve(voxelsOfType.size() * 3);
+                for (const auto& voxel : voxelsOfType) {
+                    bucket.translations.push_back(voxel.x + 0.5f); // offset center of voxel to match mesh
+                    bucket.translations.push_back(voxel.y + 0.5f);
+                    bucket.translations.push_back(voxel.z + 0.5f);
+                }
+            }
+            modelBuffer.buckets.push_back(std::move(bucket));
+        }
+    }
+    return modelBuffer;
+}
+
+// Convert a whole package, contents are returned in scene.json content order
+// Throws std::runtime_error when a file is missing or can't be parsed
+inline VmaxConversion convertVmax(const VmaxFileProvider& provider, const VmaxConvertOptions& options = VmaxConvertOptions()) {
+    std::vector<uint8_t> sceneBytes = provideVmaxFile(provider, "scene.json");
+    JsonVmaxSceneParser vmaxSceneParser;
+    if (!vmaxSceneParser.parseSceneFromMemory(sceneBytes.data(), sceneBytes.size())) {
+        throw std::runtime_error("Failed to parse scene.json");
+    }
+    const auto& jsonGroups = vmaxSceneParser.getGroups();
+
+    VmaxConversion conversion;
+    for (const auto& [vmaxContentName, vmaxModelList] : vmaxSceneParser.getModelContentVMaxbMap()) {
+        conversion.models.push_back(convertVmaxContent(provider, vmaxModelList.front(), options));
+        for (const auto& jsonModelInfo : vmaxModelList) {
+            VmaxObjectBuffer object;
+            object.id = jsonModelInfo.id;
+            object.name = jsonModelInfo.name;
+            object.model = conversion.models.size() - 1;
+
+            // Object transform then every group above it, row vector so parents go on the right
+            object.worldMatrix = combineVmaxTransforms(jsonModelInfo.rotation[0], jsonModelInfo.rotation[1],
+                                                       jsonModelInfo.rotation[2], jsonModelInfo.rotation[3],
+                                                       jsonModelInfo.position[0], jsonModelInfo.position[1], jsonModelInfo.position[2],
+                                                       jsonModelInfo.scale[0], jsonModelInfo.scale[1], jsonModelInfo.scale[2]);
+            std::string parentId = jsonModelInfo.parentId;
+            while (!parentId.empty()) {
+                auto parent = jsonGroups.find(parentId);
+                if (parent == jsonGroups.end()) break;
+                const JsonGroupInfo& groupInfo = parent->second;
+                object.worldMatrix = object.worldMatrix * combineVmaxTransforms(groupInfo.rotation[0], groupInfo.rotation[1],
+                                                                                groupInfo.rotation[2], groupInfo.rotation[3],
+                                                                                groupInfo.position[0], groupInfo.position[1], groupInfo.position[2],
+                                                                                groupInfo.scale[0], groupInfo.scale[1], groupInfo.scale[2]);
+                parentId = groupInfo.parentId;
+            }
+            conversion.objects.push_back(std::move(object));
+        }
+    }
+    return conversion;
+}
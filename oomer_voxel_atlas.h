@@ -0,0 +1,267 @@
+#pragma once
+
+// Cross color greedy meshing with a baked color atlas
+// Greedy meshing a (material, color) bucket stops at every color boundary, on painted or
+// dithered models most merged faces are a single voxel wide and the triangle count barely
+// drops. Here every opaque color of a material is meshed together, faces are merged by
+// occupancy alone and each merged quad gets a w x h texel block in a texture atlas holding
+// the palette color of every voxel face it covers, one texel per voxel.
+// Blocks are shelf packed with a one texel gutter replicating their edge, so bilinear
+// filtering never pulls in a neighbouring block. The atlas is written as an RGBA png
+// (stored deflate, no zlib dependency) in sRGB, exactly the palette values.
+// UVs map quad corners onto texel edges, v runs bottom up like bella expects, image rows
+// are written top down.
+// Will avoid using bella_sdk
+
+#include <array>        // For std::array
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For writing the png
+#include <algorithm>    // For std::sort, std::max
+#include <stdexcept>    // For std::runtime_error
+
+struct VmaxAtlasMesh {
+    std::vector<float> positions;   // xyz per vertex, voxel grid space like the ogt meshes
+    std::vector<float> uvs;         // uv per vertex
+    std::vector<uint32_t> quads;    // 4 vertex indices per quad, counter clockwise seen from outside
+    std::vector<uint8_t> texels;    // RGBA atlas, width * height * 4, first row is the top
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    size_t quadCount() const { return quads.size() / 4; }
+    size_t vertexCount() const { return positions.size() / 3; }
+};
+
+// A merged face before packing, texels hold the palette index of every covered voxel face
+struct VmaxAtlasQuad {
+    std::array<float, 12> corners;  // 4 corners, counter clockwise seen from +axis
+    bool backFacing = false;        // faces -axis, emitted with reversed winding
+    uint32_t w = 0, h = 0;          // texels along the first and second corner edge
+    std::vector<uint8_t> colors;    // w * h palette indexes, row j covers corners 0->3 at step j
+    uint32_t atlasX = 0, atlasY = 0; // top left of the block inside its gutter
+};
+
+// Pack quads into shelves of a power of two wide atlas, tallest first
+inline void packAtlasQuads(std::vector<VmaxAtlasQuad>& quads, uint32_t& atlasWidth, uint32_t& atlasHeight) {
+    uint64_t area = 0;
+    uint32_t widest = 1;
+    for (const VmaxAtlasQuad& quad : quads) {
+        area += static_cast<uint64_t>(quad.w + 2) * (quad.h + 2);
+        widest = std::max(widest, quad.w + 2);
+    }
+    atlasWidth = 1;
+    while (static_cast<uint64_t>(atlasWidth) * atlasWidth < area || atlasWidth < widest) atlasWidth *= 2;
+    std::vector<size_t> order(quads.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return quads[a].h > quads[b].h; });
+    uint32_t x = 0, y = 0, shelfHeight = 0;
+    for (size_t index : order) {
+        VmaxAtlasQuad& quad = quads[index];
+        if (x + quad.w + 2 > atlasWidth) { // next shelf
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        quad.atlasX = x + 1;
+        quad.atlasY = y + 1;
+        x += quad.w + 2;
+        shelfHeight = std::max(shelfHeight, quad.h + 2);
+    }
+    atlasHeight = std::max<uint32_t>(1, y + shelfHeight);
+}
+
+// Mesh every voxel of these buckets as one surface, merging faces across colors
+// @param buckets: voxel lists sharing one material, any colors
+// @param palette: 256 colors, a voxel's palette index is 1 based like everywhere in vmax
+template <typename Voxel, typename RGBA>
+VmaxAtlasMesh meshVoxelsCrossColor(const std::vector<const std::vector<Voxel>*>& buckets, const std::vector<RGBA>& palette) {
+    VmaxAtlasMesh mesh;
+    int lo[3] = {256, 256, 256}, hi[3] = {-1, -1, -1};
+    for (const std::vector<Voxel>* bucket : buckets) {
+        for (const Voxel& voxel : *bucket) {
+            const int p[3] = {voxel.x, voxel.y, voxel.z};
+            for (int axis = 0; axis < 3; axis++) {
+                lo[axis] = std::min(lo[axis], p[axis]);
+                hi[axis] = std::max(hi[axis], p[axis]);
+            }
+        }
+    }
+    if (hi[0] < 0) return mesh;
+
+    // Palette index per cell with an empty border, 0 is empty
+    const int dims[3] = {hi[0] - lo[0] + 3, hi[1] - lo[1] + 3, hi[2] - lo[2] + 3};
+    std::vector<uint8_t> grid(static_cast<size_t>(dims[0]) * dims[1] * dims[2], 0);
+    auto cell = [&](const int p[3]) -> uint8_t& {
+        return grid[(static_cast<size_t>(p[2]) * dims[1] + p[1]) * dims[0] + p[0]];
+    };
+    for (const std::vector<Voxel>* bucket : buckets) {
+        for (const Voxel& voxel : *bucket) {
+            const int p[3] = {voxel.x - lo[0] + 1, voxel.y - lo[1] + 1, voxel.z - lo[2] + 1};
+            cell(p) = voxel.palette;
+        }
+    }
+
+    std::vector<VmaxAtlasQuad> quads;
+    std::vector<uint8_t> mask;
+    for (int axis = 0; axis < 3; axis++) {
+        const int u = (axis + 1) % 3, v = (axis + 2) % 3; // u x v points along +axis
+        mask.assign(static_cast<size_t>(dims[u]) * dims[v], 0);
+        for (int side = 1; side >= -1; side -= 2) {
+            for (int slice = 1; slice < dims[axis] - 1; slice++) {
+                // Palette index of every face of this slice looking out of side
+                bool any = false;
+                for (int j = 0; j < dims[v]; j++) {
+                    for (int i = 0; i < dims[u]; i++) {
+                        int p[3], q[3];
+                        p[axis] = slice; p[u] = i; p[v] = j;
+                        q[axis] = slice + side; q[u] = i; q[v] = j;
+                        uint8_t color = cell(p);
+                        uint8_t face = (color != 0 && cell(q) == 0) ? color : 0;
+                        mask[static_cast<size_t>(j) * dims[u] + i] = face;
+                        any = any || face != 0;
+                    }
+                }
+                if (!any) continue;
+
+                // Grow rectangles over occupied faces, whatever their color
+                for (int j = 0; j < dims[v]; j++) {
+                    for (int i = 0; i < dims[u];) {
+                        if (mask[static_cast<size_t>(j) * dims[u] + i] == 0) { i++; continue; }
+                        int w = 1;
+                        while (i + w < dims[u] && mask[static_cast<size_t>(j) * dims[u] + i + w] != 0) w++;
+                        int h = 1;
+                        for (bool grow = true; grow && j + h < dims[v]; ) {
+                            for (int k = 0; k < w; k++) {
+                                if (mask[static_cast<size_t>(j + h) * dims[u] + i + k] == 0) { grow = false; break; }
+                            }
+                            if (grow) h++;
+                        }
+                        VmaxAtlasQuad quad;
+                        quad.backFacing = side < 0;
+                        quad.w = static_cast<uint32_t>(w);
+                        quad.h = static_cast<uint32_t>(h);
+                        quad.colors.resize(static_cast<size_t>(w) * h);
+                        for (int b = 0; b < h; b++) {
+                            for (int a = 0; a < w; a++) {
+                                uint8_t& face = mask[static_cast<size_t>(j + b) * dims[u] + i + a];
+                                quad.colors[static_cast<size_t>(b) * w + a] = face;
+                                face = 0;
+                            }
+                        }
+                        // Corners in model voxel space, the face sits on the far side of the voxel for +side
+                        float plane = static_cast<float>(slice - 1 + lo[axis] + (side > 0 ? 1 : 0));
+                        float u0 = static_cast<float>(i - 1 + lo[u]), v0 = static_cast<float>(j - 1 + lo[v]);
+                        const float cornerUV[4][2] = {{u0, v0}, {u0 + w, v0}, {u0 + w, v0 + h}, {u0, v0 + h}};
+                        for (int c = 0; c < 4; c++) {
+                            quad.corners[c * 3 + axis] = plane;
+                            quad.corners[c * 3 + u] = cornerUV[c][0];
+                            quad.corners[c * 3 + v] = cornerUV[c][1];
+                        }
+                        quads.push_back(std::move(quad));
+                        i += w;
+                    }
+                }
+            }
+        }
+    }
+
+    packAtlasQuads(quads, mesh.width, mesh.height);
+    mesh.texels.assign(static_cast<size_t>(mesh.width) * mesh.height * 4, 0);
+    mesh.positions.reserve(quads.size() * 12);
+    mesh.uvs.reserve(quads.size() * 8);
+    mesh.quads.reserve(quads.size() * 4);
+    for (const VmaxAtlasQuad& quad : quads) {
+        // Block plus gutter, gutter texels repeat the nearest edge texel
+        for (int64_t b = -1; b <= static_cast<int64_t>(quad.h); b++) {
+            for (int64_t a = -1; a <= static_cast<int64_t>(quad.w); a++) {
+                int64_t sa = std::min<int64_t>(std::max<int64_t>(a, 0), quad.w - 1);
+                int64_t sb = std::min<int64_t>(std::max<int64_t>(b, 0), quad.h - 1);
+                const RGBA& color = palette[quad.colors[static_cast<size_t>(sb) * quad.w + sa] - 1];
+                size_t texel = ((quad.atlasY + b) * static_cast<size_t>(mesh.width) + (quad.atlasX + a)) * 4;
+                mesh.texels[texel + 0] = color.r;
+                mesh.texels[texel + 1] = color.g;
+                mesh.texels[texel + 2] = color.b;
+                mesh.texels[texel + 3] = color.a;
+            }
+        }
+        // Texel row b of the block holds faces b along corners 0->3, rows are stored top down
+        const uint32_t cornerTexel[4][2] = {{0, 0}, {quad.w, 0}, {quad.w, quad.h}, {0, quad.h}};
+        uint32_t first = static_cast<uint32_t>(mesh.vertexCount());
+        for (int c = 0; c < 4; c++) {
+            mesh.positions.insert(mesh.positions.end(), quad.corners.begin() + c * 3, quad.corners.begin() + c * 3 + 3);
+            mesh.uvs.push_back(static_cast<float>(quad.atlasX + cornerTexel[c][0]) / mesh.width);
+            mesh.uvs.push_back(1.0f - static_cast<float>(quad.atlasY + cornerTexel[c][1]) / mesh.height);
+        }
+        if (quad.backFacing) {
+            mesh.quads.insert(mesh.quads.end(), {first, first + 3, first + 2, first + 1});
+        } else {
+            mesh.quads.insert(mesh.quads.end(), {first, first + 1, first + 2, first + 3});
+        }
+    }
+    return mesh;
+}
+
+inline uint32_t atlasCrc32(const uint8_t* bytes, size_t size, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+// RGBA png with stored deflate blocks, larger than a compressed png but bit exact and dependency free
+inline std::vector<uint8_t> encodeAtlasPng(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> raw; // filter byte 0 then the row
+    raw.reserve(static_cast<size_t>(height) * (width * 4 + 1));
+    for (uint32_t row = 0; row < height; row++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + static_cast<size_t>(row) * width * 4, rgba.begin() + static_cast<size_t>(row + 1) * width * 4);
+    }
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535) {
+        size_t size = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + size >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<uint8_t>(size));
+        zlib.push_back(static_cast<uint8_t>(size >> 8));
+        zlib.push_back(static_cast<uint8_t>(~size));
+        zlib.push_back(static_cast<uint8_t>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        if (last) break;
+    }
+    uint32_t a = 1, b = 0; // adler32
+    for (uint8_t byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    for (int shift = 24; shift >= 0; shift -= 8) zlib.push_back(static_cast<uint8_t>(((b << 16) | a) >> shift));
+
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    auto putChunk = [&png](const char* type, const std::vector<uint8_t>& data) {
+        for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(data.size() >> shift));
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        uint32_t crc = atlasCrc32(png.data() + start, png.size() - start);
+        for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(crc >> shift));
+    };
+    std::vector<uint8_t> header;
+    for (uint32_t value : {width, height}) {
+        for (int shift = 24; shift >= 0; shift -= 8) header.push_back(static_cast<uint8_t>(value >> shift));
+    }
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA, no interlace
+    putChunk("IHDR", header);
+    putChunk("IDAT", zlib);
+    putChunk("IEND", {});
+    return png;
+}
+
+inline void writeAtlasPng(const VmaxAtlasMesh& mesh, const std::string& fileName) {
+    std::vector<uint8_t> png = encodeAtlasPng(mesh.texels, mesh.width, mesh.height);
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(png.data()), png.size())) {
+        throw std::runtime_error("Failed to write atlas: " + fileName);
+    }
+}
@@ -0,0 +1,324 @@
+#pragma once
+
+// Sparse brickmap export of a decoded vmax model for real-time viewers
+// Voxels are grouped into 8x8x8 bricks of palette indices, only bricks holding a voxel are
+// stored and their table is sorted by morton code so spatial neighbours are neighbours in the
+// file. Every level above the voxels halves the resolution (a cell keeps the most common
+// color of the 8 cells below it) up to a single brick for the whole 256^3 model, so a viewer
+// can stream the coarse levels first and range request fine bricks as the camera gets closer.
+// Bricks are fixed size so brick i of a level lives at dataOffset + i * kBrickBytes, and all
+// sections are 64 byte aligned, the file can be memory mapped and read with VmaxBrickmapView.
+// Level 0 bricks are laid out from the model's occupancy summary, then filled in one pass over
+// the decoded voxels through a slot per brick coordinate, no 256^3 grid is allocated.
+// Works with any model exposing getUsedMaterialsAndColors() and getVoxels(material, color)
+// Will avoid using bella_sdk
+//
+// File layout, all integers little endian:
+//   header      64 bytes   "VXBM", version, brick size, extent, level count, palette, level and file size offsets
+//   palette     1024 bytes 256 RGBA colors, brick color c uses palette[c-1]
+//   levels      24 bytes each: cell size, brick count, table offset, data offset
+//   per level, coarsest first:
+//     table     8 bytes per brick: morton of the brick coordinate, voxel count, dominant color, dominant material
+//     data      kBrickBytes per brick: 512 colors x fastest (0 empty), then 256 bytes of material nibbles
+
+#include <array>          // For fixed size bricks
+#include <string>         // For std::string
+#include <vector>         // For dynamic arrays (vectors)
+#include <cstdint>        // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>        // For std::memcmp
+#include <fstream>        // For writing the file
+#include <iostream>       // For input/output operations (cout, cin, etc.)
+#include <algorithm>      // For std::sort
+#include <unordered_map>  // For the sparse parent brick hash
+
+#include "oomer_voxel_occupancy.h" // For the bricks holding voxels
+
+const uint32_t kBrickmapVersion = 1;
+const int kBrickmapBrickSize = 8;
+const int kBrickmapExtent = 256;
+const int kBrickmapLevels = 6; // 8^3 bricks of 1, 2, 4, 8, 16 and 32 voxel cells, the last one covers the model
+const size_t kBrickmapHeaderBytes = 64;
+const size_t kBrickmapLevelBytes = 24;
+const size_t kBrickmapEntryBytes = 8;
+const size_t kBrickCells = kBrickmapBrickSize * kBrickmapBrickSize * kBrickmapBrickSize;
+const size_t kBrickBytes = kBrickCells + kBrickCells / 2;
+static_assert(kBrickmapBrickSize == VmaxOccupancySummary::kBrickSize, "level 0 bricks are the occupancy summary's bricks");
+
+struct VmaxBrick {
+    uint32_t morton = 0;                      // interleaved brick coordinate within its level
+    uint16_t voxelCount = 0;
+    std::array<uint8_t, kBrickCells> colors{};    // 0 is empty
+    std::array<uint8_t, kBrickCells> materials{};
+};
+
+struct VmaxBrickmap {
+    std::array<std::array<uint8_t, 4>, 256> palette{};
+    std::array<std::vector<VmaxBrick>, kBrickmapLevels> levels; // level 0 holds the voxels, sorted by morton
+};
+
+// Spread 5 bits so two zero bits follow each one, a brick coordinate is at most 31
+inline uint32_t brickmapSpreadBits(uint32_t v) {
+    uint32_t result = 0;
+    for (int bit = 0; bit < 5; bit++) {
+        result |= ((v >> bit) & 1u) << (bit * 3);
+    }
+    return result;
+}
+
+inline uint32_t brickmapMorton(uint32_t x, uint32_t y, uint32_t z) {
+    return brickmapSpreadBits(x) | (brickmapSpreadBits(y) << 1) | (brickmapSpreadBits(z) << 2);
+}
+
+inline void brickmapDecodeMorton(uint32_t morton, uint32_t& x, uint32_t& y, uint32_t& z) {
+    x = y = z = 0;
+    for (int bit = 0; bit < 5; bit++) {
+        x |= ((morton >> (bit * 3)) & 1u) << bit;
+        y |= ((morton >> (bit * 3 + 1)) & 1u) << bit;
+        z |= ((morton >> (bit * 3 + 2)) & 1u) << bit;
+    }
+}
+
+inline size_t brickCellIndex(int x, int y, int z) {
+    return x + y * kBrickmapBrickSize + z * kBrickmapBrickSize * kBrickmapBrickSize;
+}
+
+// Halve every brick of a level into an octant of its parent, a parent cell takes the
+// most common (color, material) of its 8 children
+inline std::vector<VmaxBrick> downsampleBrickLevel(const std::vector<VmaxBrick>& level) {
+    std::unordered_map<uint32_t, size_t> parentIndex;
+    std::vector<VmaxBrick> parents;
+    const int half = kBrickmapBrickSize / 2;
+    for (const VmaxBrick& brick : level) {
+        uint32_t bx, by, bz;
+        brickmapDecodeMorton(brick.morton, bx, by, bz);
+        uint32_t parentMorton = brickmapMorton(bx >> 1, by >> 1, bz >> 1);
+        auto [found, inserted] = parentIndex.emplace(parentMorton, parents.size());
+        if (inserted) {
+            parents.emplace_back();
+            parents.back().morton = parentMorton;
+        }
+        VmaxBrick& parent = parents[found->second];
+        int offsetX = (bx & 1) * half, offsetY = (by & 1) * half, offsetZ = (bz & 1) * half;
+        for (int z = 0; z < half; z++) {
+            for (int y = 0; y < half; y++) {
+                for (int x = 0; x < half; x++) {
+                    uint16_t children[8];
+                    int childCount = 0;
+                    for (int corner = 0; corner < 8; corner++) {
+                        size_t child = brickCellIndex(x * 2 + (corner & 1), y * 2 + ((corner >> 1) & 1), z * 2 + (corner >> 2));
+                        if (brick.colors[child] == 0) continue;
+                        children[childCount++] = static_cast<uint16_t>(brick.materials[child] << 8 | brick.colors[child]);
+                    }
+                    if (childCount == 0) continue;
+                    uint16_t best = children[0];
+                    int bestVotes = 0;
+                    for (int i = 0; i < childCount; i++) {
+                        int votes = 0;
+                        for (int j = 0; j < childCount; j++) votes += children[j] == children[i];
+                        if (votes > bestVotes) { bestVotes = votes; best = children[i]; }
+                    }
+                    size_t cell = brickCellIndex(offsetX + x, offsetY + y, offsetZ + z);
+                    parent.colors[cell] = static_cast<uint8_t>(best & 0xff);
+                    parent.materials[cell] = static_cast<uint8_t>(best >> 8);
+                    parent.voxelCount++;
+                }
+            }
+        }
+    }
+    return parents;
+}
+
+// Build the brickmap of a model in one pass over its buckets
+// @param palette: 256 colors with r, g, b, a members, bucket color c uses palette[c-1]
+// @param occupancy: the model's occupancy summary, its bricks become the level 0 bricks
+template <typename Model, typename Palette>
+VmaxBrickmap buildVmaxBrickmap(const Model& model, const Palette& palette, const VmaxOccupancySummary& occupancy) {
+    VmaxBrickmap brickmap;
+    for (size_t i = 0; i < brickmap.palette.size() && i < palette.size(); i++) {
+        brickmap.palette[i] = {palette[i].r, palette[i].g, palette[i].b, palette[i].a};
+    }
+
+    const uint32_t bricksPerAxis = kBrickmapExtent / kBrickmapBrickSize;
+    std::vector<uint32_t> brickSlot(bricksPerAxis * bricksPerAxis * bricksPerAxis, UINT32_MAX); // index into bricks by morton
+    std::vector<VmaxBrick>& bricks = brickmap.levels[0];
+    auto addBrick = [&](uint32_t morton) {
+        brickSlot[morton] = static_cast<uint32_t>(bricks.size());
+        bricks.emplace_back();
+        bricks.back().morton = morton;
+    };
+    const int chunksPerAxis = VmaxOccupancySummary::kChunksPerAxis;
+    const int bricksPerChunk = VmaxOccupancySummary::kBricksPerChunkAxis;
+    occupancy.forEachBrick([&](int chunk, int brick) {
+        uint32_t x = chunk % chunksPerAxis * bricksPerChunk + brick % bricksPerChunk;
+        uint32_t y = chunk / chunksPerAxis % chunksPerAxis * bricksPerChunk + brick / bricksPerChunk % bricksPerChunk;
+        uint32_t z = chunk / (chunksPerAxis * chunksPerAxis) * bricksPerChunk + brick / (bricksPerChunk * bricksPerChunk);
+        addBrick(brickmapMorton(x, y, z));
+    });
+    for (const auto& [material, colorID] : model.getUsedMaterialsAndColors()) {
+        for (int color : colorID) {
+            for (const auto& voxel : model.getVoxels(material, color)) {
+                uint32_t morton = brickmapMorton(voxel.x / kBrickmapBrickSize, voxel.y / kBrickmapBrickSize, voxel.z / kBrickmapBrickSize);
+                if (brickSlot[morton] == UINT32_MAX) addBrick(morton); // a summary that missed a voxel still gets it written
+                VmaxBrick& brick = bricks[brickSlot[morton]];
+                size_t cell = brickCellIndex(voxel.x % kBrickmapBrickSize, voxel.y % kBrickmapBrickSize, voxel.z % kBrickmapBrickSize);
+                if (brick.colors[cell] == 0) brick.voxelCount++; // stacked voxels count once, the last one wins
+                brick.colors[cell] = static_cast<uint8_t>(color);
+                brick.materials[cell] = static_cast<uint8_t>(material);
+            }
+        }
+    }
+    for (int level = 1; level < kBrickmapLevels; level++) {
+        brickmap.levels[level] = downsampleBrickLevel(brickmap.levels[level - 1]);
+    }
+    for (auto& level : brickmap.levels) {
+        std::sort(level.begin(), level.end(), [](const VmaxBrick& a, const VmaxBrick& b) { return a.morton < b.morton; });
+    }
+    return brickmap;
+}
+
+inline void brickmapPut(std::vector<uint8_t>& bytes, size_t offset, uint64_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        bytes[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+    }
+}
+
+inline uint64_t brickmapGet(const uint8_t* bytes, size_t offset, int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= static_cast<uint64_t>(bytes[offset + i]) << (i * 8);
+    }
+    return value;
+}
+
+inline size_t brickmapAlign(size_t offset) {
+    return (offset + 63) & ~static_cast<size_t>(63);
+}
+
+// Serialize to the file layout above
+inline std::vector<uint8_t> encodeVmaxBrickmap(const VmaxBrickmap& brickmap) {
+    size_t levelsOffset = kBrickmapHeaderBytes + 1024;
+    size_t offset = brickmapAlign(levelsOffset + kBrickmapLevels * kBrickmapLevelBytes);
+    std::array<size_t, kBrickmapLevels> tableOffsets, dataOffsets;
+    for (int level = kBrickmapLevels; level-- > 0;) { // coarsest first so a streamed prefix is a usable preview
+        tableOffsets[level] = offset;
+        dataOffsets[level] = brickmapAlign(offset + brickmap.levels[level].size() * kBrickmapEntryBytes);
+        offset = brickmapAlign(dataOffsets[level] + brickmap.levels[level].size() * kBrickBytes);
+    }
+
+    std::vector<uint8_t> bytes(offset, 0);
+    std::memcpy(bytes.data(), "VXBM", 4);
+    brickmapPut(bytes, 4, kBrickmapVersion, 4);
+    brickmapPut(bytes, 8, kBrickmapBrickSize, 4);
+    brickmapPut(bytes, 12, kBrickmapExtent, 4);
+    brickmapPut(bytes, 16, kBrickmapLevels, 4);
+    brickmapPut(bytes, 24, kBrickmapHeaderBytes, 8);
+    brickmapPut(bytes, 32, levelsOffset, 8);
+    brickmapPut(bytes, 40, bytes.size(), 8);
+    for (size_t i = 0; i < brickmap.palette.size(); i++) {
+        std::memcpy(&bytes[kBrickmapHeaderBytes + i * 4], brickmap.palette[i].data(), 4);
+    }
+
+    for (int level = 0; level < kBrickmapLevels; level++) {
+        const std::vector<VmaxBrick>& bricks = brickmap.levels[level];
+        size_t descriptor = levelsOffset + level * kBrickmapLevelBytes;
+        brickmapPut(bytes, descriptor, 1u << level, 4);
+        brickmapPut(bytes, descriptor + 4, bricks.size(), 4);
+        brickmapPut(bytes, descriptor + 8, tableOffsets[level], 8);
+        brickmapPut(bytes, descriptor + 16, dataOffsets[level], 8);
+        for (size_t i = 0; i < bricks.size(); i++) {
+            const VmaxBrick& brick = bricks[i];
+            // Dominant color of the brick, a viewer can draw a far brick as one box without fetching it
+            std::array<uint16_t, 256> colorVotes{};
+            for (uint8_t color : brick.colors) colorVotes[color]++;
+            colorVotes[0] = 0;
+            uint8_t dominant = static_cast<uint8_t>(std::max_element(colorVotes.begin(), colorVotes.end()) - colorVotes.begin());
+            uint8_t dominantMaterial = 0;
+            for (size_t cell = 0; cell < kBrickCells; cell++) {
+                if (brick.colors[cell] == dominant) { dominantMaterial = brick.materials[cell]; break; }
+            }
+            size_t entry = tableOffsets[level] + i * kBrickmapEntryBytes;
+            brickmapPut(bytes, entry, brick.morton, 4);
+            brickmapPut(bytes, entry + 4, brick.voxelCount, 2);
+            bytes[entry + 6] = dominant;
+            bytes[entry + 7] = dominantMaterial;
+
+            uint8_t* data = &bytes[dataOffsets[level] + i * kBrickBytes];
+            std::memcpy(data, brick.colors.data(), kBrickCells);
+            for (size_t cell = 0; cell < kBrickCells; cell++) {
+                data[kBrickCells + cell / 2] |= static_cast<uint8_t>((brick.materials[cell] & 0xf) << ((cell & 1) * 4));
+            }
+        }
+    }
+    return bytes;
+}
+
+inline bool writeVmaxBrickmap(const VmaxBrickmap& brickmap, const std::string& fileName) {
+    std::vector<uint8_t> bytes = encodeVmaxBrickmap(brickmap);
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open brickmap file: " << fileName << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return static_cast<bool>(file);
+}
+
+// Read only view over an encoded brickmap, a memory mapped file or a downloaded buffer
+// Nothing is copied, the bytes must outlive the view
+class VmaxBrickmapView {
+private:
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+
+    uint64_t levelField(int level, size_t field, int fieldSize) const {
+        return brickmapGet(bytes, brickmapGet(bytes, 32, 8) + level * kBrickmapLevelBytes + field, fieldSize);
+    }
+
+public:
+    VmaxBrickmapView(const uint8_t* data, size_t dataSize) : bytes(data), size(dataSize) {}
+
+    // Magic, version and every section inside the buffer
+    bool valid() const {
+        if (size < kBrickmapHeaderBytes || std::memcmp(bytes, "VXBM", 4) != 0) return false;
+        if (brickmapGet(bytes, 4, 4) != kBrickmapVersion || brickmapGet(bytes, 16, 4) != kBrickmapLevels) return false;
+        if (brickmapGet(bytes, 40, 8) > size || brickmapGet(bytes, 32, 8) + kBrickmapLevels * kBrickmapLevelBytes > size) return false;
+        for (int level = 0; level < kBrickmapLevels; level++) {
+            if (tableOffset(level) + brickCount(level) * kBrickmapEntryBytes > size) return false;
+            if (dataOffset(level) + brickCount(level) * kBrickBytes > size) return false;
+        }
+        return true;
+    }
+
+    const uint8_t* palette() const { return bytes + brickmapGet(bytes, 24, 8); }
+    int cellSize(int level) const { return static_cast<int>(levelField(level, 0, 4)); }
+    size_t brickCount(int level) const { return static_cast<size_t>(levelField(level, 4, 4)); }
+    size_t tableOffset(int level) const { return static_cast<size_t>(levelField(level, 8, 8)); }
+    size_t dataOffset(int level) const { return static_cast<size_t>(levelField(level, 16, 8)); }
+
+    uint32_t brickMorton(int level, size_t brick) const {
+        return static_cast<uint32_t>(brickmapGet(bytes, tableOffset(level) + brick * kBrickmapEntryBytes, 4));
+    }
+
+    // Index of the brick at this brick coordinate of the level, -1 when it is empty
+    long findBrick(int level, uint32_t bx, uint32_t by, uint32_t bz) const {
+        uint32_t morton = brickmapMorton(bx, by, bz);
+        size_t low = 0, high = brickCount(level);
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (brickMorton(level, middle) < morton) low = middle + 1; else high = middle;
+        }
+        return low < brickCount(level) && brickMorton(level, low) == morton ? static_cast<long>(low) : -1;
+    }
+
+    // Color and material of the cell holding voxel (x,y,z) at a level, color 0 when empty
+    uint8_t sample(int level, int x, int y, int z, uint8_t* material = nullptr) const {
+        if (x < 0 || y < 0 || z < 0 || x >= kBrickmapExtent || y >= kBrickmapExtent || z >= kBrickmapExtent) return 0;
+        int cellX = x >> level, cellY = y >> level, cellZ = z >> level;
+        long brick = findBrick(level, cellX / kBrickmapBrickSize, cellY / kBrickmapBrickSize, cellZ / kBrickmapBrickSize);
+        if (brick < 0) return 0;
+        const uint8_t* data = bytes + dataOffset(level) + brick * kBrickBytes;
+        size_t cell = brickCellIndex(cellX % kBrickmapBrickSize, cellY % kBrickmapBrickSize, cellZ % kBrickmapBrickSize);
+        if (material) *material = (data[kBrickCells + cell / 2] >> ((cell & 1) * 4)) & 0xf;
+        return data[cell];
+    }
+};
@@ -0,0 +1,334 @@
+#pragma once
+
+// Resource budget planning for vmax2bella
+// Farm nodes can have hard memory and time limits, instead of running out of memory
+// or timing out we estimate the cost of each model up front and degrade the
+// representation of the most expensive models until the scene fits the budget
+// Will avoid using bella_sdk, the converter maps a VmaxRepresentation onto bella nodes
+
+#include <map>          // For key-value pair data structures (maps)
+#include <cmath>        // For std::pow
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For reading and writing the cost table
+#include <iostream>     // For input/output operations (cout, cin, etc.)
+#include <stdexcept>    // For std::runtime_error
+#include <algorithm>    // For std::min, std::max
+#include <type_traits>  // For std::decay_t
+
+#include "thirdparty/json.hpp" // For the cost table
+
+// How a model is emitted into the Bella scene, ordered from most to least expensive
+// Each step down the ladder trades visual fidelity for fewer instances/triangles
+enum class VmaxRepresentation {
+    Box,        // one instancer box per voxel, the default
+    CulledBox,  // one instancer box per voxel with at least one exposed face
+    Mesh,       // one face per exposed voxel side
+    GreedyMesh, // exposed faces merged into cuboid faces
+    Lod2Mesh,   // greedy mesh of the model downsampled 2x
+    Lod4Mesh,   // greedy mesh of the model downsampled 4x
+};
+
+inline const char* representationName(VmaxRepresentation rep) {
+    switch (rep) {
+        case VmaxRepresentation::Box:        return "box";
+        case VmaxRepresentation::CulledBox:  return "culled box";
+        case VmaxRepresentation::Mesh:       return "mesh";
+        case VmaxRepresentation::GreedyMesh: return "greedy mesh";
+        case VmaxRepresentation::Lod2Mesh:   return "lod2 mesh";
+        case VmaxRepresentation::Lod4Mesh:   return "lod4 mesh";
+    }
+    return "unknown";
+}
+
+// Downsample factor applied to voxel coordinates before meshing
+inline int representationLodFactor(VmaxRepresentation rep) {
+    if (rep == VmaxRepresentation::Lod2Mesh) return 2;
+    if (rep == VmaxRepresentation::Lod4Mesh) return 4;
+    return 1;
+}
+
+inline bool representationIsMesh(VmaxRepresentation rep) {
+    return rep != VmaxRepresentation::Box && rep != VmaxRepresentation::CulledBox;
+}
+
+// Limits for a whole scene, 0 means unlimited
+struct VmaxBudget {
+    uint64_t maxInstances = 0;
+    uint64_t maxTriangles = 0;
+    uint64_t maxMemoryBytes = 0;
+    double maxSeconds = 0.0;
+
+    bool enabled() const {
+        return maxInstances > 0 || maxTriangles > 0 || maxMemoryBytes > 0 || maxSeconds > 0.0;
+    }
+};
+
+// What we know about a model before emitting it
+// Only voxel counts and the AABB are used so the estimate is cheap
+struct VmaxModelStats {
+    std::string name;
+    uint64_t voxelCount = 0;
+    uint32_t bucketCount = 0; // number of used (material, color) pairs
+    uint32_t sizeX = 0, sizeY = 0, sizeZ = 0; // AABB dimensions in voxels
+};
+
+// Estimated cost of one model in one representation
+struct VmaxModelCost {
+    uint64_t instances = 0;
+    uint64_t triangles = 0;
+    uint64_t memoryBytes = 0;
+    double seconds = 0.0;
+    double outputBytes = 0.0; // of the .bsz, only known with a calibrated cost table
+};
+
+// Per element costs the planner multiplies out
+// The defaults are rough numbers measured on a bella_gui build, good enough to rank choices,
+// vmax2bella --calibrate measures the Bella side on this machine and --costs loads the table
+struct VmaxCostTable {
+    uint64_t bytesPerInstance = 64 + 48; // Mat4f plus bvh leaf
+    uint64_t bytesPerTriangle = 2 * 12 + 16 + 32; // shared points, Vec4u face, bvh
+    uint64_t bytesPerBucket = 4096; // material + xform nodes
+    double secondsPerVoxel = 40e-9; // decode
+    double secondsPerDenseVoxel = 2e-9; // ogt meshing scans a dense grid
+    // Emission, node creation and array assignment
+    double secondsPerInstance = 30e-9;
+    double secondsPerTriangle = 60e-9;
+    double secondsPerBucket = 0.0;
+    // belScene.write
+    double writeSecondsPerInstance = 0.0;
+    double writeSecondsPerTriangle = 0.0;
+    double writeSecondsPerBucket = 0.0;
+    // .bsz size
+    double outputBytesPerInstance = 0.0;
+    double outputBytesPerTriangle = 0.0;
+    double outputBytesPerBucket = 0.0;
+};
+
+// Field names of the calibration json, every field is optional
+inline void writeCostTable(const VmaxCostTable& costs, const std::string& fileName) {
+    nlohmann::json table = {
+        {"bytesPerInstance", costs.bytesPerInstance},
+        {"bytesPerTriangle", costs.bytesPerTriangle},
+        {"bytesPerBucket", costs.bytesPerBucket},
+        {"secondsPerVoxel", costs.secondsPerVoxel},
+        {"secondsPerDenseVoxel", costs.secondsPerDenseVoxel},
+        {"secondsPerInstance", costs.secondsPerInstance},
+        {"secondsPerTriangle", costs.secondsPerTriangle},
+        {"secondsPerBucket", costs.secondsPerBucket},
+        {"writeSecondsPerInstance", costs.writeSecondsPerInstance},
+        {"writeSecondsPerTriangle", costs.writeSecondsPerTriangle},
+        {"writeSecondsPerBucket", costs.writeSecondsPerBucket},
+        {"outputBytesPerInstance", costs.outputBytesPerInstance},
+        {"outputBytesPerTriangle", costs.outputBytesPerTriangle},
+        {"outputBytesPerBucket", costs.outputBytesPerBucket},
+    };
+    std::ofstream file(fileName);
+    if (!file) throw std::runtime_error("Failed to write cost table: " + fileName);
+    file << table.dump(2) << std::endl;
+}
+
+inline VmaxCostTable loadCostTable(const std::string& fileName) {
+    std::ifstream file(fileName);
+    if (!file) throw std::runtime_error("Failed to read cost table: " + fileName);
+    nlohmann::json table = nlohmann::json::parse(file, nullptr, false);
+    if (!table.is_object()) throw std::runtime_error("Cost table is not a json object: " + fileName);
+    VmaxCostTable costs;
+    auto read = [&table](const char* key, auto& value) {
+        auto found = table.find(key);
+        if (found != table.end() && found->is_number()) value = found->get<std::decay_t<decltype(value)>>();
+    };
+    read("bytesPerInstance", costs.bytesPerInstance);
+    read("bytesPerTriangle", costs.bytesPerTriangle);
+    read("bytesPerBucket", costs.bytesPerBucket);
+    read("secondsPerVoxel", costs.secondsPerVoxel);
+    read("secondsPerDenseVoxel", costs.secondsPerDenseVoxel);
+    read("secondsPerInstance", costs.secondsPerInstance);
+    read("secondsPerTriangle", costs.secondsPerTriangle);
+    read("secondsPerBucket", costs.secondsPerBucket);
+    read("writeSecondsPerInstance", costs.writeSecondsPerInstance);
+    read("writeSecondsPerTriangle", costs.writeSecondsPerTriangle);
+    read("writeSecondsPerBucket", costs.writeSecondsPerBucket);
+    read("outputBytesPerInstance", costs.outputBytesPerInstance);
+    read("outputBytesPerTriangle", costs.outputBytesPerTriangle);
+    read("outputBytesPerBucket", costs.outputBytesPerBucket);
+    return costs;
+}
+
+// Estimate exposed faces from the AABB
+// A solid box exposes exactly its shell, a sparse or concave model exposes more
+// so we double the shell and never exceed 6 faces per voxel
+inline uint64_t estimateExposedFaces(const VmaxModelStats& stats, int lodFactor = 1) {
+    uint64_t dx = std::max<uint64_t>(1, (stats.sizeX + lodFactor - 1) / lodFactor);
+    uint64_t dy = std::max<uint64_t>(1, (stats.sizeY + lodFactor - 1) / lodFactor);
+    uint64_t dz = std::max<uint64_t>(1, (stats.sizeZ + lodFactor - 1) / lodFactor);
+    uint64_t voxels = stats.voxelCount / (lodFactor * lodFactor * lodFactor) + 1;
+    uint64_t shellFaces = 2 * (dx * dy + dy * dz + dx * dz);
+    return std::min<uint64_t>(6 * voxels, 2 * shellFaces);
+}
+
+inline VmaxModelCost estimateModelCost(const VmaxModelStats& stats, VmaxRepresentation rep, const VmaxCostTable& costs = VmaxCostTable()) {
+    VmaxModelCost cost;
+    uint64_t faces = 0;
+    switch (rep) {
+        case VmaxRepresentation::Box:
+            cost.instances = stats.voxelCount;
+            break;
+        case VmaxRepresentation::CulledBox:
+            // a box is kept when any of its faces is exposed, ~1/3 of exposed faces for solids
+            cost.instances = std::min<uint64_t>(stats.voxelCount, estimateExposedFaces(stats) / 3 + 1);
+            break;
+        case VmaxRepresentation::Mesh:
+            faces = estimateExposedFaces(stats);
+            break;
+        case VmaxRepresentation::GreedyMesh:
+        case VmaxRepresentation::Lod2Mesh:
+        case VmaxRepresentation::Lod4Mesh:
+            // greedy merging within a color bucket, assume 4 faces merge into one
+            faces = estimateExposedFaces(stats, representationLodFactor(rep)) / 4 + 1;
+            break;
+    }
+    cost.triangles = faces * 2;
+    cost.memoryBytes = cost.instances * costs.bytesPerInstance
+                     + cost.triangles * costs.bytesPerTriangle
+                     + stats.bucketCount * costs.bytesPerBucket;
+    cost.seconds = stats.voxelCount * costs.secondsPerVoxel
+                 + cost.instances * (costs.secondsPerInstance + costs.writeSecondsPerInstance)
+                 + cost.triangles * (costs.secondsPerTriangle + costs.writeSecondsPerTriangle)
+                 + stats.bucketCount * (costs.secondsPerBucket + costs.writeSecondsPerBucket);
+    cost.outputBytes = cost.instances * costs.outputBytesPerInstance
+                     + cost.triangles * costs.outputBytesPerTriangle
+                     + stats.bucketCount * costs.outputBytesPerBucket;
+    if (representationIsMesh(rep)) {
+        // every bucket is meshed from its own dense grid
+        int lod = representationLodFactor(rep);
+        double dense = double(stats.sizeX / lod + 1) * double(stats.sizeY / lod + 1) * double(stats.sizeZ / lod + 1);
+        cost.seconds += dense * stats.bucketCount * costs.secondsPerDenseVoxel;
+    }
+    return cost;
+}
+
+// Next cheaper representation, returns the same value at the bottom of the ladder
+inline VmaxRepresentation degradeRepresentation(VmaxRepresentation rep) {
+    switch (rep) {
+        case VmaxRepresentation::Box:        return VmaxRepresentation::CulledBox;
+        case VmaxRepresentation::CulledBox:  return VmaxRepresentation::GreedyMesh;
+        case VmaxRepresentation::Mesh:       return VmaxRepresentation::GreedyMesh;
+        case VmaxRepresentation::GreedyMesh: return VmaxRepresentation::Lod2Mesh;
+        case VmaxRepresentation::Lod2Mesh:   return VmaxRepresentation::Lod4Mesh;
+        case VmaxRepresentation::Lod4Mesh:   return VmaxRepresentation::Lod4Mesh;
+    }
+    return rep;
+}
+
+// Cheapest representation that still looks the same, boxes, culled boxes, faces or merged faces
+// Downsampled meshes are left to the budget, they change the look
+// Ranked by the time Bella spends on the model, a calibrated table makes this machine specific
+inline VmaxRepresentation cheapestRepresentation(const VmaxModelStats& stats, const VmaxCostTable& costs) {
+    VmaxRepresentation best = VmaxRepresentation::Box;
+    double bestSeconds = estimateModelCost(stats, best, costs).seconds;
+    for (VmaxRepresentation rep : {VmaxRepresentation::CulledBox, VmaxRepresentation::Mesh, VmaxRepresentation::GreedyMesh}) {
+        double seconds = estimateModelCost(stats, rep, costs).seconds;
+        if (seconds < bestSeconds) {
+            best = rep;
+            bestSeconds = seconds;
+        }
+    }
+    return best;
+}
+
+// Sum of how far each limited resource is over budget, 0 means within budget
+inline double budgetOverage(const VmaxBudget& budget, const VmaxModelCost& total) {
+    double overage = 0.0;
+    if (budget.maxInstances > 0)
+        overage += std::max(0.0, double(total.instances) / double(budget.maxInstances) - 1.0);
+    if (budget.maxTriangles > 0)
+        overage += std::max(0.0, double(total.triangles) / double(budget.maxTriangles) - 1.0);
+    if (budget.maxMemoryBytes > 0)
+        overage += std::max(0.0, double(total.memoryBytes) / double(budget.maxMemoryBytes) - 1.0);
+    if (budget.maxSeconds > 0.0)
+        overage += std::max(0.0, total.seconds / budget.maxSeconds - 1.0);
+    return overage;
+}
+
+inline void addCost(VmaxModelCost& total, const VmaxModelCost& cost, int sign = 1) {
+    total.instances += sign * int64_t(cost.instances);
+    total.triangles += sign * int64_t(cost.triangles);
+    total.memoryBytes += sign * int64_t(cost.memoryBytes);
+    total.seconds += sign * cost.seconds;
+    total.outputBytes += sign * cost.outputBytes;
+}
+
+/**
+ * Pick a representation per model that keeps the scene within budget
+ * Greedy: repeatedly apply the single degradation step that reduces the overage the most
+ * Every chosen degradation is logged so farm logs explain why a render looks coarse
+ *
+ * @param budget limits for the whole scene
+ * @param stats one entry per canonical model
+ * @param plan starting representation per entry in stats
+ * @param costs per element costs, calibrated with --calibrate or the defaults
+ * @return one representation per entry in stats
+ */
+inline std::vector<VmaxRepresentation> planBudget(const VmaxBudget& budget,
+                                                  const std::vector<VmaxModelStats>& stats,
+                                                  std::vector<VmaxRepresentation> plan,
+                                                  const VmaxCostTable& costs = VmaxCostTable()) {
+    if (!budget.enabled()) return plan;
+
+    VmaxModelCost total;
+    for (size_t i = 0; i < stats.size(); i++) {
+        addCost(total, estimateModelCost(stats[i], plan[i], costs));
+    }
+    double overage = budgetOverage(budget, total);
+
+    while (overage > 0.0) {
+        int best = -1;
+        double bestOverage = overage;
+        for (size_t i = 0; i < stats.size(); i++) {
+            VmaxRepresentation next = degradeRepresentation(plan[i]);
+            if (next == plan[i]) continue;
+            VmaxModelCost trial = total;
+            addCost(trial, estimateModelCost(stats[i], plan[i], costs), -1);
+            addCost(trial, estimateModelCost(stats[i], next, costs));
+            double trialOverage = budgetOverage(budget, trial);
+            if (trialOverage < bestOverage) {
+                bestOverage = trialOverage;
+                best = static_cast<int>(i);
+            }
+        }
+        if (best < 0) {
+            std::cout << "budget: cannot fit scene within budget, using cheapest representations found" << std::endl;
+            break;
+        }
+        VmaxRepresentation next = degradeRepresentation(plan[best]);
+        VmaxModelCost before = estimateModelCost(stats[best], plan[best], costs);
+        VmaxModelCost after = estimateModelCost(stats[best], next, costs);
+        std::cout << "budget: " << stats[best].name << " "
+                  << representationName(plan[best]) << " -> " << representationName(next)
+                  << " (instances " << before.instances << " -> " << after.instances
+                  << ", triangles " << before.triangles << " -> " << after.triangles
+                  << ", memory " << before.memoryBytes / (1024 * 1024) << "MB -> "
+                  << after.memoryBytes / (1024 * 1024) << "MB)" << std::endl;
+        addCost(total, before, -1);
+        addCost(total, after);
+        plan[best] = next;
+        overage = bestOverage;
+    }
+
+    std::cout << "budget: estimated instances " << total.instances
+              << " triangles " << total.triangles
+              << " memory " << total.memoryBytes / (1024 * 1024) << "MB"
+              << " time " << total.seconds << "s";
+    if (total.outputBytes > 0.0) std::cout << " bsz " << static_cast<uint64_t>(total.outputBytes) / (1024 * 1024) << "MB";
+    std::cout << std::endl;
+    return plan;
+}
+
+inline std::vector<VmaxRepresentation> planBudget(const VmaxBudget& budget,
+                                                  const std::vector<VmaxModelStats>& stats,
+                                                  VmaxRepresentation preferred,
+                                                  const VmaxCostTable& costs = VmaxCostTable()) {
+    return planBudget(budget, stats, std::vector<VmaxRepresentation>(stats.size(), preferred), costs);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+// Selective conversion, keep only some materials, colors, a crop box or some objects
+// Filters are applied as early as the data allows:
+//  - objects (by id, name or the name/id of any group above them) before any file is read,
+//    a content no kept object uses is never read or decoded
+//  - the crop box per snapshot before its ds is decoded, a snapshot covers a run of morton
+//    codes inside its chunk and the aligned morton block enclosing that run bounds it
+//  - materials, colors and the crop box per voxel as it is added to the model
+// Materials are the 8 vmax material slots (layers) 0-7, colors the 1-255 palette indexes,
+// the crop box is inclusive and in model voxel space like every other voxel coordinate.
+// Will avoid using bella_sdk
+
+#include <map>          // For key-value pair data structures (maps)
+#include <set>          // For std::set
+#include <bitset>       // For the material and color masks
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <iterator>     // For std::next
+#include <algorithm>    // For std::remove_if
+
+struct VmaxVoxelFilter {
+    std::bitset<8> materials;
+    std::bitset<256> colors;
+    bool cropping = false;
+    int cropMin[3] = {0, 0, 0};
+    int cropMax[3] = {255, 255, 255};
+
+    VmaxVoxelFilter() {
+        materials.set();
+        colors.set();
+    }
+
+    bool active() const { return !materials.all() || !colors.all() || cropping; }
+
+    bool keepBucket(int material, int color) const {
+        return material >= 0 && material < 8 && color >= 0 && color < 256 && materials[material] && colors[color];
+    }
+
+    // Inclusive box
+    bool keepBox(const int lo[3], const int hi[3]) const {
+        if (!cropping) return true;
+        for (int axis = 0; axis < 3; axis++) {
+            if (hi[axis] < cropMin[axis] || lo[axis] > cropMax[axis]) return false;
+        }
+        return true;
+    }
+
+    bool keepVoxel(int x, int y, int z, int material, int color) const {
+        const int p[3] = {x, y, z};
+        return keepBucket(material, color) && keepBox(p, p);
+    }
+
+    // Changes whenever the kept set does, 0 when nothing is filtered
+    uint32_t signature() const {
+        if (!active()) return 0;
+        uint32_t hash = 2166136261u;
+        auto mix = [&hash](uint32_t value) {
+            hash ^= value;
+            hash *= 16777619u;
+        };
+        mix(static_cast<uint32_t>(materials.to_ulong()));
+        for (int color = 0; color < 256; color++) mix(colors[color]);
+        mix(cropping);
+        for (int axis = 0; axis < 3; axis++) {
+            mix(static_cast<uint32_t>(cropMin[axis]));
+            mix(static_cast<uint32_t>(cropMax[axis]));
+        }
+        return hash == 0 ? 1 : hash;
+    }
+};
+
+inline uint32_t filterCompactBits(uint64_t morton) {
+    uint32_t value = 0;
+    for (int bit = 0; bit < 21; bit++) {
+        value |= static_cast<uint32_t>((morton >> (bit * 3)) & 1u) << bit;
+    }
+    return value;
+}
+
+// Inclusive bounds of the voxels a snapshot can hold
+// Its voxels are the morton codes [mortonMin, mortonMin + slots) inside its 32^3 chunk, the
+// chunk origin is the chunk id decoded as morton times 32, so a chunk covers
+// chunk * 32 + decode(morton) like oom::vmax::vmaxVoxelInfo and Model::addVoxel place them
+inline void vmaxSnapshotBox(uint64_t chunkId, uint64_t mortonMin, uint64_t slots, int lo[3], int hi[3]) {
+    uint64_t last = mortonMin + (slots > 0 ? slots - 1 : 0);
+    int level = 0; // smallest aligned 2^level block holding the whole run
+    while (level < 21 && (mortonMin >> (3 * level)) != (last >> (3 * level))) level++;
+    uint64_t blockStart = (mortonMin >> (3 * level)) << (3 * level);
+    const uint32_t chunk[3] = {filterCompactBits(chunkId), filterCompactBits(chunkId >> 1), filterCompactBits(chunkId >> 2)};
+    const uint32_t start[3] = {filterCompactBits(blockStart), filterCompactBits(blockStart >> 1), filterCompactBits(blockStart >> 2)};
+    for (int axis = 0; axis < 3; axis++) {
+        lo[axis] = static_cast<int>(chunk[axis] * 32 + start[axis]);
+        hi[axis] = lo[axis] + (1 << level) - 1;
+    }
+}
+
+// Keep the objects named in keep, by their id or name or those of a group above them
+// Contents left without objects are removed, so they are never read
+template <typename ModelInfo, typename GroupInfo>
+size_t filterVmaxObjects(std::map<std::string, std::vector<ModelInfo>>& contents,
+                         const std::map<std::string, GroupInfo>& groups,
+                         const std::set<std::string>& keep) {
+    auto groupKept = [&](std::string groupId) {
+        for (size_t depth = 0; !groupId.empty() && depth <= groups.size(); depth++) { // depth guards a cyclic scene.json
+            auto group = groups.find(groupId);
+            if (group == groups.end()) return false;
+            if (keep.count(group->second.id) || keep.count(group->second.name)) return true;
+            groupId = group->second.parentId;
+        }
+        return false;
+    };
+    size_t dropped = 0;
+    for (auto content = contents.begin(); content != contents.end();) {
+        std::vector<ModelInfo>& objects = content->second;
+        size_t before = objects.size();
+        objects.erase(std::remove_if(objects.begin(), objects.end(), [&](const ModelInfo& object) {
+            return !keep.count(object.id) && !keep.count(object.name) && !groupKept(object.parentId);
+        }), objects.end());
+        dropped += before - objects.size();
+        content = objects.empty() ? contents.erase(content) : std::next(content);
+    }
+    return dropped;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+// Hierarchical occupancy summary of a model, kept up to date as voxels are added
+// Consumers used to rediscover where a model or a bucket has voxels by scanning every voxel.
+// The summary answers that in constant time per chunk:
+//  - chunks, one bit per 32x32x32 chunk of the 256^3 model, 8x8x8 chunks
+//  - bricks, one 64 bit mask per chunk with a bit per 8x8x8 brick, 4x4x4 bricks per chunk
+//  - buckets, the chunks each (material, color) bucket touches and its inclusive bounds
+// Chunks are numbered x + 8 * y + 64 * z over chunk coordinates, like VmaxVoxelQuery, and
+// bricks x + 4 * y + 16 * z inside their chunk. Voxels are never removed so it only grows.
+// Will avoid using bella_sdk
+
+#include <array>        // For the fixed size masks
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <algorithm>    // For std::min, std::max
+
+#ifdef _MSC_VER
+#include <intrin.h>     // For _BitScanForward64
+#endif
+
+// Index of the lowest set bit, mask must not be 0
+inline int occupancyLowestBit(uint64_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+struct VmaxOccupancySummary {
+    static constexpr int kChunkSize = 32;
+    static constexpr int kBrickSize = 8;
+    static constexpr int kChunksPerAxis = 8;
+    static constexpr int kBricksPerChunkAxis = kChunkSize / kBrickSize;
+    static constexpr int kChunkCount = kChunksPerAxis * kChunksPerAxis * kChunksPerAxis;
+
+    // Inclusive voxel bounds, meaningless while empty
+    struct Bounds {
+        uint8_t lo[3] = {255, 255, 255};
+        uint8_t hi[3] = {0, 0, 0};
+        bool empty = true;
+
+        void add(int x, int y, int z) {
+            const int p[3] = {x, y, z};
+            for (int axis = 0; axis < 3; axis++) {
+                lo[axis] = static_cast<uint8_t>(std::min<int>(lo[axis], p[axis]));
+                hi[axis] = static_cast<uint8_t>(std::max<int>(hi[axis], p[axis]));
+            }
+            empty = false;
+        }
+    };
+
+    std::array<uint64_t, kChunkCount / 64> chunks{};
+    std::array<uint64_t, kChunkCount> bricks{};
+    std::array<std::array<uint64_t, kChunkCount / 64>, 8 * 256> bucketChunks{}; // material * 256 + color
+    std::array<Bounds, 8 * 256> bucketBounds{};
+
+    static int chunkIndex(int chunkX, int chunkY, int chunkZ) {
+        return chunkX + chunkY * kChunksPerAxis + chunkZ * kChunksPerAxis * kChunksPerAxis;
+    }
+
+    // Model space voxel, anything outside the 256^3 model or the 8 materials is ignored
+    void add(int x, int y, int z, int material, int color) {
+        if (x < 0 || y < 0 || z < 0 || x > 255 || y > 255 || z > 255) return;
+        if (material < 0 || material > 7 || color < 1 || color > 255) return;
+        int chunk = chunkIndex(x / kChunkSize, y / kChunkSize, z / kChunkSize);
+        int brick = (x % kChunkSize) / kBrickSize
+                  + (y % kChunkSize) / kBrickSize * kBricksPerChunkAxis
+                  + (z % kChunkSize) / kBrickSize * kBricksPerChunkAxis * kBricksPerChunkAxis;
+        uint64_t chunkBit = uint64_t(1) << (chunk % 64);
+        chunks[chunk / 64] |= chunkBit;
+        bricks[chunk] |= uint64_t(1) << brick;
+        bucketChunks[material * 256 + color][chunk / 64] |= chunkBit;
+        bucketBounds[material * 256 + color].add(x, y, z);
+    }
+
+    // The 8x8x8 brick holding model space voxel (x, y, z)
+    bool brickOccupied(int x, int y, int z) const {
+        if (x < 0 || y < 0 || z < 0 || x > 255 || y > 255 || z > 255) return false;
+        int brick = (x % kChunkSize) / kBrickSize
+                  + (y % kChunkSize) / kBrickSize * kBricksPerChunkAxis
+                  + (z % kChunkSize) / kBrickSize * kBricksPerChunkAxis * kBricksPerChunkAxis;
+        return (bricks[chunkIndex(x / kChunkSize, y / kChunkSize, z / kChunkSize)] >> brick) & 1;
+    }
+
+    bool bucketInChunk(int material, int color, int chunk) const {
+        return (bucketChunks[material * 256 + color][chunk / 64] >> (chunk % 64)) & 1;
+    }
+
+    const Bounds& bucketBoundsOf(int material, int color) const { return bucketBounds[material * 256 + color]; }
+
+    // Call visit(chunk) for every occupied chunk in index order, empty words are skipped whole
+    template <typename Visit>
+    void forEachChunk(Visit visit) const { forEachBit(chunks, visit); }
+
+    // Call visit(chunk, brick) for every occupied brick
+    template <typename Visit>
+    void forEachBrick(Visit visit) const {
+        forEachChunk([&](int chunk) {
+            for (uint64_t mask = bricks[chunk]; mask; mask &= mask - 1) visit(chunk, occupancyLowestBit(mask));
+        });
+    }
+
+private:
+    template <typename Visit>
+    static void forEachBit(const std::array<uint64_t, kChunkCount / 64>& words, Visit& visit) {
+        for (int word = 0; word < kChunkCount / 64; word++) {
+            for (uint64_t mask = words[word]; mask; mask &= mask - 1) visit(word * 64 + occupancyLowestBit(mask));
+        }
+    }
+};
@@ -110,7 +110,9 @@
 
 // Convert a vector of VmaxVoxel to an ogt_vox_model
 // Note: The returned ogt_vox_model must be freed using ogt_vox_free when no longer needed
-ogt_vox_model* convert_voxelsoftype_to_ogt_vox(const std::vector<VmaxVoxel>& voxelsOfType) {
+// @param bounds: the bucket's bounds from VmaxModel::occupancy, saves scanning the voxels for the size
+ogt_vox_model* convert_voxelsoftype_to_ogt_vox(const std::vector<VmaxVoxel>& voxelsOfType, 
+                                               const VmaxOccupancySummary::Bounds* bounds = nullptr) {
     // Find the maximum dimensions from the voxels
     uint32_t size_x = 0;
     uint32_t size_y = 0;
@@ -118,10 +120,16 @@ ogt_vox_model* convert_voxelsoftype_to_ogt_vox(const std::vector<VmaxVoxel>& vox
    
     // WARNING must add 1 to each dimension
     // because voxel coordinates are 0-based
-    for (const auto& voxel : voxelsOfType) {
-        size_x = std::max(size_x, static_cast<uint32_t>(voxel.x)+1);  // this seems wasteful 
-        size_y = std::max(size_y, static_cast<uint32_t>(voxel.y)+1);
-        size_z = std::max(size_z, static_cast<uint32_t>(voxel.z)+1);
+    if (bounds && !bounds->empty) {
+        size_x = static_cast<uint32_t>(bounds->hi[0]) + 1;
+        size_y = static_cast<uint32_t>(bounds->hi[1]) + 1;
+        size_z = static_cast<uint32_t>(bounds->hi[2]) + 1;
+    } else {
+        for (const auto& voxel : voxelsOfType) {
+            size_x = std::max(size_x, static_cast<uint32_t>(voxel.x)+1);
+            size_y = std::max(size_y, static_cast<uint32_t>(voxel.y)+1);
+            size_z = std::max(size_z, static_cast<uint32_t>(voxel.z)+1);
+        }
     }
     
     // Add some safety checks
@@ -197,6 +205,11 @@ ogt_vox_model* convert_voxelsoftype_to_ogt_vox(const std::vector<VmaxVoxel>& vox
     return model;
 }
 
+// One bucket of a model, sized from its occupancy summary
+ogt_vox_model* convert_voxelsoftype_to_ogt_vox(const VmaxModel& vmaxModel, int material, int color) {
+    return convert_voxelsoftype_to_ogt_vox(vmaxModel.getVoxels(material, color), &vmaxModel.occupancy.bucketBoundsOf(material, color));
+}
+
 // Free resources allocated for an ogt_vox_model created by convert_vmax_to_ogt_vox
 void free_ogt_vox_model(ogt_vox_model* model) {
     if (model) {
@@ -0,0 +1,235 @@
+#pragma once
+
+// Spatial queries over a decoded VmaxModel: point occupancy, box counts and ray casts
+// For tools (placement, collision proxies, lightmap probes) that only need to ask questions
+// about an asset, so they don't each rebuild getVoxelsAt style lookups.
+// Occupancy is kept at three levels: one bit per voxel, a voxel count per 8x8x8 brick and
+// a flag per 32x32x32 chunk. Rays step cell by cell like a 3D-DDA but jump over a whole
+// empty chunk or brick in one step. A built query is read only so any number of threads
+// can use it at once.
+// Will avoid using bella_sdk
+
+#include "oomer_voxel_vmax.h"
+
+#include <array>        // For fixed size vectors
+#include <cmath>        // For std::floor
+#include <limits>       // For std::numeric_limits
+#include <thread>       // For batch ray casts
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <algorithm>    // For std::min, std::max
+
+struct VmaxRay {
+    std::array<float, 3> origin = {0.0f, 0.0f, 0.0f};    // model space, one unit per voxel
+    std::array<float, 3> direction = {0.0f, 0.0f, 1.0f}; // doesn't need to be normalized
+    float maxDistance = std::numeric_limits<float>::max(); // in units of direction
+};
+
+struct VmaxRayHit {
+    bool hit = false;
+    float distance = 0.0f;                // ray parameter of the entry point, in units of direction
+    int x = 0, y = 0, z = 0;              // voxel that was hit
+    std::array<int, 3> normal = {0, 0, 0}; // face that was entered, zero when the ray starts inside
+    int material = 0;
+    int color = 0;
+};
+
+class VmaxVoxelQuery {
+public:
+    static constexpr int kExtent = 256;     // vmax models are at most 256 voxels per axis
+    static constexpr int kBrickSize = 8;
+    static constexpr int kChunkSize = 32;
+
+private:
+    static constexpr int kBricksPerAxis = kExtent / kBrickSize;
+    static constexpr int kChunksPerAxis = kExtent / kChunkSize;
+
+    const VmaxModel& model;
+    std::vector<uint64_t> voxelBits;     // kExtent^3 bits, x fastest
+    std::vector<uint16_t> brickCounts;   // voxels per brick, up to 512
+    std::vector<uint8_t> chunkOccupied;  // any voxel in the chunk
+
+    static size_t voxelIndex(int x, int y, int z) {
+        return static_cast<size_t>(x) + static_cast<size_t>(y) * kExtent + static_cast<size_t>(z) * kExtent * kExtent;
+    }
+    static size_t brickIndex(int x, int y, int z) {
+        return (x / kBrickSize) + (y / kBrickSize) * kBricksPerAxis + (z / kBrickSize) * kBricksPerAxis * kBricksPerAxis;
+    }
+    static size_t chunkIndex(int x, int y, int z) {
+        return (x / kChunkSize) + (y / kChunkSize) * kChunksPerAxis + (z / kChunkSize) * kChunksPerAxis * kChunksPerAxis;
+    }
+    static bool inBounds(int x, int y, int z) {
+        return x >= 0 && y >= 0 && z >= 0 && x < kExtent && y < kExtent && z < kExtent;
+    }
+
+    // Ray parameter where it leaves the aligned cell of this size around (x,y,z), and through which axis
+    static float cellExit(const VmaxRay& ray, int x, int y, int z, int cellSize, int& exitAxis) {
+        int cell[3] = {x / cellSize * cellSize, y / cellSize * cellSize, z / cellSize * cellSize};
+        float exitT = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; axis++) {
+            float d = ray.direction[axis];
+            if (d == 0.0f) continue;
+            float boundary = static_cast<float>(d > 0.0f ? cell[axis] + cellSize : cell[axis]);
+            float t = (boundary - ray.origin[axis]) / d;
+            if (t < exitT) {
+                exitT = t;
+                exitAxis = axis;
+            }
+        }
+        return exitT;
+    }
+
+public:
+    // Builds the occupancy levels in one pass over the model's buckets
+    // The model must outlive the query, hits look their material up in it
+    explicit VmaxVoxelQuery(const VmaxModel& vmaxModel)
+        : model(vmaxModel),
+          voxelBits(static_cast<size_t>(kExtent) * kExtent * kExtent / 64, 0),
+          brickCounts(kBricksPerAxis * kBricksPerAxis * kBricksPerAxis, 0),
+          chunkOccupied(kChunksPerAxis * kChunksPerAxis * kChunksPerAxis, 0) {
+        for (const auto& [material, colorID] : model.getUsedMaterialsAndColors()) {
+            for (int color : colorID) {
+                for (const VmaxVoxel& voxel : model.getVoxels(material, color)) {
+                    size_t bit = voxelIndex(voxel.x, voxel.y, voxel.z);
+                    uint64_t mask = uint64_t(1) << (bit & 63);
+                    if (voxelBits[bit >> 6] & mask) continue; // stacked voxels count once
+                    voxelBits[bit >> 6] |= mask;
+                    brickCounts[brickIndex(voxel.x, voxel.y, voxel.z)]++;
+                }
+            }
+        }
+        model.occupancy.forEachChunk([&](int chunk) { chunkOccupied[chunk] = 1; }); // same chunk numbering
+    }
+
+    bool occupied(int x, int y, int z) const {
+        if (!inBounds(x, y, z)) return false;
+        size_t bit = voxelIndex(x, y, z);
+        return (voxelBits[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    // Voxels inside the inclusive box, whole bricks are counted from their totals
+    size_t countInBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) const {
+        minX = std::max(minX, 0); minY = std::max(minY, 0); minZ = std::max(minZ, 0);
+        maxX = std::min(maxX, kExtent - 1); maxY = std::min(maxY, kExtent - 1); maxZ = std::min(maxZ, kExtent - 1);
+        size_t count = 0;
+        for (int bz = minZ / kBrickSize; bz <= maxZ / kBrickSize && minZ <= maxZ; bz++) {
+            for (int by = minY / kBrickSize; by <= maxY / kBrickSize && minY <= maxY; by++) {
+                for (int bx = minX / kBrickSize; bx <= maxX / kBrickSize && minX <= maxX; bx++) {
+                    int x0 = bx * kBrickSize, y0 = by * kBrickSize, z0 = bz * kBrickSize;
+                    uint16_t brickCount = brickCounts[brickIndex(x0, y0, z0)];
+                    if (brickCount == 0) continue;
+                    int x1 = x0 + kBrickSize - 1, y1 = y0 + kBrickSize - 1, z1 = z0 + kBrickSize - 1;
+                    if (x0 >= minX && y0 >= minY && z0 >= minZ && x1 <= maxX && y1 <= maxY && z1 <= maxZ) {
+                        count += brickCount;
+                        continue;
+                    }
+                    for (int z = std::max(z0, minZ); z <= std::min(z1, maxZ); z++) {
+                        for (int y = std::max(y0, minY); y <= std::min(y1, maxY); y++) {
+                            for (int x = std::max(x0, minX); x <= std::min(x1, maxX); x++) {
+                                count += occupied(x, y, z);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return count;
+    }
+
+    // First voxel along the ray, empty chunks and bricks are crossed in a single step
+    VmaxRayHit castRay(const VmaxRay& ray) const {
+        VmaxRayHit result;
+        // Step just past a cell boundary, a ten thousandth of a voxel whatever the direction's length
+        float largestComponent = std::max({std::abs(ray.direction[0]), std::abs(ray.direction[1]), std::abs(ray.direction[2])});
+        if (largestComponent == 0.0f) return result;
+        const float kNudge = 1e-4f / largestComponent;
+
+        // Clip the ray to the model box with the slab test
+        float t = 0.0f;
+        float tEnd = ray.maxDistance;
+        for (int axis = 0; axis < 3; axis++) {
+            float o = ray.origin[axis];
+            float d = ray.direction[axis];
+            if (d == 0.0f) {
+                if (o < 0.0f || o >= kExtent) return result;
+                continue;
+            }
+            float t0 = (0.0f - o) / d;
+            float t1 = (static_cast<float>(kExtent) - o) / d;
+            if (t0 > t1) std::swap(t0, t1);
+            t = std::max(t, t0);
+            tEnd = std::min(tEnd, t1);
+        }
+        if (t > tEnd) return result;
+
+        int enteredAxis = -1;
+        if (t > 0.0f) { // entered the model box through one of its faces
+            float bestT = -1.0f;
+            for (int axis = 0; axis < 3; axis++) {
+                float d = ray.direction[axis];
+                if (d == 0.0f) continue;
+                float t0 = ((d > 0.0f ? 0.0f : static_cast<float>(kExtent)) - ray.origin[axis]) / d;
+                if (t0 > bestT) { bestT = t0; enteredAxis = axis; }
+            }
+        }
+        while (t <= tEnd) {
+            float p[3];
+            for (int axis = 0; axis < 3; axis++) {
+                p[axis] = ray.origin[axis] + ray.direction[axis] * (t + kNudge);
+            }
+            int x = static_cast<int>(std::floor(p[0]));
+            int y = static_cast<int>(std::floor(p[1]));
+            int z = static_cast<int>(std::floor(p[2]));
+            if (!inBounds(x, y, z)) break;
+
+            int cellSize = 1;
+            if (!chunkOccupied[chunkIndex(x, y, z)]) {
+                cellSize = kChunkSize;
+            } else if (brickCounts[brickIndex(x, y, z)] == 0) {
+                cellSize = kBrickSize;
+            } else if (occupied(x, y, z)) {
+                result.hit = true;
+                result.distance = t;
+                result.x = x;
+                result.y = y;
+                result.z = z;
+                if (enteredAxis >= 0) {
+                    result.normal[enteredAxis] = ray.direction[enteredAxis] > 0.0f ? -1 : 1;
+                }
+                const std::vector<VmaxVoxel>& voxelsHere = model.getVoxelsAt(x, y, z);
+                if (!voxelsHere.empty()) {
+                    result.material = voxelsHere.front().material;
+                    result.color = voxelsHere.front().palette;
+                }
+                return result;
+            }
+            float exitT = cellExit(ray, x, y, z, cellSize, enteredAxis);
+            t = std::max(exitT, t + kNudge); // always make progress
+        }
+        return result;
+    }
+
+    // Cast a batch of rays split evenly over threads, results are in ray order
+    // @param threadCount: 0 picks one per hardware thread
+    std::vector<VmaxRayHit> castRays(const std::vector<VmaxRay>& rays, unsigned int threadCount = 0) const {
+        std::vector<VmaxRayHit> hits(rays.size());
+        if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0) threadCount = 1;
+        size_t perThread = (rays.size() + threadCount - 1) / threadCount;
+        if (threadCount == 1 || rays.size() < 1024) { // not worth starting threads
+            for (size_t i = 0; i < rays.size(); i++) hits[i] = castRay(rays[i]);
+            return hits;
+        }
+        std::vector<std::thread> workers;
+        for (size_t begin = 0; begin < rays.size(); begin += perThread) {
+            size_t end = std::min(begin + perThread, rays.size());
+            workers.emplace_back([this, &rays, &hits, begin, end] {
+                for (size_t i = begin; i < end; i++) hits[i] = castRay(rays[i]);
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        return hits;
+    }
+};
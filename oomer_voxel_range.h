@@ -0,0 +1,274 @@
+#pragma once
+
+// Lazy voxel ranges over snapshot streams and model buckets
+// decodeVoxels and vmaxVoxelInfo copy the ds stream, decode it into a vector and copy that
+// into another vector, only for the caller to walk it once. These ranges decode on demand
+// straight from the plist's own bytes and never allocate:
+//  - VmaxSnapshotVoxels, the voxels of one snapshot ds stream
+//  - VmaxContentVoxels, the voxels of every snapshot of a contentsN.vmaxb plist
+//  - VmaxModelVoxels, the voxels of a decoded model's buckets
+// An optional VmaxVoxelFilter is fused into the iteration: empty slots and rejected
+// materials and colors are skipped before their morton code is decoded, a snapshot or
+// bucket the filter can't touch yields nothing without being walked.
+// Stream voxels are in model space (chunk * 32 + position in the chunk) like the models,
+// info* is the position vmaxVoxelInfo reports, which is what Model::addVoxel expects.
+// Templated on the model so the library and vmax2bella both use it
+// Will avoid using bella_sdk
+
+#include <array>        // For std::array
+#include <cstddef>      // For std::ptrdiff_t
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <vector>       // For dynamic arrays (vectors)
+#include <utility>      // For std::declval
+#include <iterator>     // For std::input_iterator_tag
+#include <type_traits>  // For std::decay
+
+#include "../libplist/include/plist/plist.h" // For reading snapshots in place
+#include "oomer_voxel_filter.h"              // For the fused filter
+
+struct VmaxStreamVoxel {
+    uint8_t x, y, z;                // model space
+    uint8_t material;
+    uint8_t color;                  // palette index 1-255
+    uint8_t infoX, infoY, infoZ;    // chunk * 8 + position in the chunk, as vmaxVoxelInfo reports it
+};
+
+inline uint32_t streamCompactBits(uint32_t n) {
+    n &= 0x49249249;
+    n = (n ^ (n >> 2)) & 0xc30c30c3;
+    n = (n ^ (n >> 4)) & 0x0f00f00f;
+    n = (n ^ (n >> 8)) & 0x00ff00ff;
+    n = (n ^ (n >> 16)) & 0x0000ffff;
+    return n;
+}
+
+// The voxels of one snapshot, ds holds a (material, color) pair per morton slot from mortonMin on
+// ds must outlive the range, it is typically the plist node's own buffer (plist_get_data_ptr)
+class VmaxSnapshotVoxels {
+public:
+    VmaxSnapshotVoxels(const uint8_t* ds, size_t size, uint64_t chunkId, uint64_t mortonMin, const VmaxVoxelFilter* filter = nullptr)
+        : data(ds), slots(ds ? size / 2 : 0), mortonMin(mortonMin), filter(filter) {
+        uint32_t chunk = static_cast<uint32_t>(chunkId);
+        chunkCell = {streamCompactBits(chunk), streamCompactBits(chunk >> 1), streamCompactBits(chunk >> 2)};
+        if (filter && filter->cropping && slots > 0) {
+            int lo[3], hi[3];
+            vmaxSnapshotBox(chunkId, mortonMin, slots, lo, hi);
+            if (!filter->keepBox(lo, hi)) slots = 0; // nothing in it can pass
+        }
+    }
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = VmaxStreamVoxel;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const VmaxStreamVoxel*;
+        using reference = const VmaxStreamVoxel&;
+
+        iterator(const VmaxSnapshotVoxels* range, size_t slot) : range(range), slot(slot) { settle(); }
+        reference operator*() const { return current; }
+        pointer operator->() const { return &current; }
+        iterator& operator++() {
+            slot++;
+            settle();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return slot == other.slot; }
+        bool operator!=(const iterator& other) const { return slot != other.slot; }
+        void rebind(const VmaxSnapshotVoxels* owner) { range = owner; } // the range was copied along with the iterator
+
+    private:
+        // Move to the first slot at or after this one holding a voxel the filter keeps
+        void settle() {
+            const VmaxVoxelFilter* filter = range->filter;
+            for (; slot < range->slots; slot++) {
+                uint8_t material = range->data[slot * 2];
+                uint8_t color = range->data[slot * 2 + 1];
+                if (color == 0) continue;
+                if (filter && !filter->keepBucket(material, color)) continue;
+                uint32_t morton = static_cast<uint32_t>(range->mortonMin + slot);
+                uint32_t local[3] = {streamCompactBits(morton), streamCompactBits(morton >> 1), streamCompactBits(morton >> 2)};
+                uint32_t position[3];
+                for (int axis = 0; axis < 3; axis++) position[axis] = range->chunkCell[axis] * 32 + local[axis];
+                if (filter && filter->cropping) {
+                    const int p[3] = {static_cast<int>(position[0]), static_cast<int>(position[1]), static_cast<int>(position[2])};
+                    if (!filter->keepBox(p, p)) continue;
+                }
+                current = VmaxStreamVoxel{static_cast<uint8_t>(position[0]), static_cast<uint8_t>(position[1]), static_cast<uint8_t>(position[2]),
+                                          material, color,
+                                          static_cast<uint8_t>(range->chunkCell[0] * 8 + local[0]),
+                                          static_cast<uint8_t>(range->chunkCell[1] * 8 + local[1]),
+                                          static_cast<uint8_t>(range->chunkCell[2] * 8 + local[2])};
+                return;
+            }
+            slot = range->slots;
+        }
+
+        const VmaxSnapshotVoxels* range;
+        size_t slot;
+        VmaxStreamVoxel current{};
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, slots); }
+
+private:
+    const uint8_t* data;
+    size_t slots;
+    uint64_t mortonMin;
+    const VmaxVoxelFilter* filter;
+    std::array<uint32_t, 3> chunkCell;
+};
+
+// Chunk id and morton origin of a snapshot item, s.id.c and s.st.min[3]
+inline void streamSnapshotHeader(plist_t snapshotItem, uint64_t& chunkId, uint64_t& mortonMin) {
+    chunkId = 0;
+    mortonMin = 0;
+    plist_t snapshot = plist_dict_get_item(snapshotItem, "s");
+    plist_t id = snapshot ? plist_dict_get_item(snapshot, "id") : nullptr;
+    plist_t chunk = id ? plist_dict_get_item(id, "c") : nullptr;
+    if (chunk) plist_get_uint_val(chunk, &chunkId);
+    plist_t stats = snapshot ? plist_dict_get_item(snapshot, "st") : nullptr;
+    plist_t minimum = stats ? plist_dict_get_item(stats, "min") : nullptr;
+    plist_t origin = minimum ? plist_array_get_item(minimum, 3) : nullptr;
+    if (origin) plist_get_uint_val(origin, &mortonMin);
+}
+
+// ds stream of a snapshot item in place, nullptr when it has none
+inline const uint8_t* streamSnapshotData(plist_t snapshotItem, uint64_t& size) {
+    size = 0;
+    plist_t snapshot = plist_dict_get_item(snapshotItem, "s");
+    plist_t ds = snapshot ? plist_dict_get_item(snapshot, "ds") : nullptr;
+    if (!ds) return nullptr;
+    return reinterpret_cast<const uint8_t*>(plist_get_data_ptr(ds, &size));
+}
+
+// Every voxel of every snapshot of a contentsN.vmaxb plist, in snapshot order
+// The plist must outlive the range
+class VmaxContentVoxels {
+public:
+    explicit VmaxContentVoxels(plist_t plistModel, const VmaxVoxelFilter* filter = nullptr)
+        : snapshots(plistModel ? plist_dict_get_item(plistModel, "snapshots") : nullptr),
+          snapshotCount(snapshots ? plist_array_get_size(snapshots) : 0), filter(filter) {}
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = VmaxStreamVoxel;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const VmaxStreamVoxel*;
+        using reference = const VmaxStreamVoxel&;
+
+        iterator(const VmaxContentVoxels* range, uint32_t snapshot)
+            : range(range), snapshot(snapshot), voxels(nullptr, 0, 0, 0), at(voxels.end()) { open(); }
+        iterator(const iterator& other) : range(other.range), snapshot(other.snapshot), voxels(other.voxels), at(other.at) { at.rebind(&voxels); }
+        iterator& operator=(const iterator& other) {
+            range = other.range;
+            snapshot = other.snapshot;
+            voxels = other.voxels;
+            at = other.at;
+            at.rebind(&voxels);
+            return *this;
+        }
+        reference operator*() const { return *at; }
+        pointer operator->() const { return &*at; }
+        iterator& operator++() {
+            ++at;
+            if (at == voxels.end()) {
+                snapshot++;
+                open();
+            }
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return snapshot == other.snapshot && (snapshot == range->snapshotCount || at == other.at); }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        // Open snapshots from this one on until one yields a voxel
+        void open() {
+            for (; snapshot < range->snapshotCount; snapshot++) {
+                plist_t item = plist_array_get_item(range->snapshots, snapshot);
+                uint64_t chunkId = 0, mortonMin = 0, size = 0;
+                streamSnapshotHeader(item, chunkId, mortonMin);
+                const uint8_t* ds = streamSnapshotData(item, size);
+                voxels = VmaxSnapshotVoxels(ds, static_cast<size_t>(size), chunkId, mortonMin, range->filter);
+                at = voxels.begin();
+                if (at != voxels.end()) return;
+            }
+        }
+
+        const VmaxContentVoxels* range;
+        uint32_t snapshot;
+        VmaxSnapshotVoxels voxels;
+        VmaxSnapshotVoxels::iterator at;
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, snapshotCount); }
+
+private:
+    plist_t snapshots;
+    uint32_t snapshotCount;
+    const VmaxVoxelFilter* filter;
+};
+
+// Voxels of a decoded model's buckets, material by material and color by color
+// Buckets the filter rejects are never walked, the crop box is tested per voxel
+template <typename Model>
+class VmaxModelVoxels {
+public:
+    using Voxel = typename std::decay<decltype(std::declval<const Model&>().getVoxels(0, 1).front())>::type;
+
+    explicit VmaxModelVoxels(const Model& model, const VmaxVoxelFilter* filter = nullptr) : model(model), filter(filter) {}
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Voxel;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Voxel*;
+        using reference = const Voxel&;
+
+        iterator(const VmaxModelVoxels* range, int bucket) : range(range), bucket(bucket), index(0) { settle(); }
+        reference operator*() const { return (*voxels)[index]; }
+        pointer operator->() const { return &(*voxels)[index]; }
+        iterator& operator++() {
+            index++;
+            settle();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return bucket == other.bucket && index == other.index; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        // bucket is material * 256 + color, color 0 is never used
+        void settle() {
+            const VmaxVoxelFilter* filter = range->filter;
+            for (; bucket < 8 * 256; bucket++, index = 0) {
+                int material = bucket / 256;
+                int color = bucket % 256;
+                if (color == 0 || (filter && !filter->keepBucket(material, color))) continue;
+                voxels = &range->model.getVoxels(material, color);
+                for (; index < voxels->size(); index++) {
+                    const Voxel& voxel = (*voxels)[index];
+                    if (!filter || !filter->cropping) return;
+                    const int p[3] = {voxel.x, voxel.y, voxel.z};
+                    if (filter->keepBox(p, p)) return;
+                }
+            }
+            index = 0;
+        }
+
+        const VmaxModelVoxels* range;
+        int bucket;
+        size_t index;
+        const std::vector<Voxel>* voxels = nullptr;
+    };
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, 8 * 256); }
+
+private:
+    const Model& model;
+    const VmaxVoxelFilter* filter;
+};
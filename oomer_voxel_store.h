@@ -0,0 +1,237 @@
+#pragma once
+
+// Out-of-core store for decoded models
+// Large projects with hundreds of dense contents don't fit in worker RAM when every
+// decoded model is kept alive until the scene is built.
+// The store keeps a compact replay log of each model (the arguments given to addVoxel)
+// and spills the least recently used logs to an mmap-able file once a memory limit is hit.
+// Spilled models are paged back on demand through the mapping, the OS can drop those
+// pages again so peak RSS stays near the limit plus the one model being emitted.
+// Will avoid using bella_sdk
+
+#include <list>         // For LRU ordering
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdio>       // For FILE, fopen, fwrite
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>      // For memcpy
+#include <iostream>     // For input/output operations (cout, cin, etc.)
+#include <stdexcept>    // For std::runtime_error
+#include <filesystem>   // For removing the spill file
+
+#ifdef _WIN32
+#include <windows.h>    // For CreateFileMapping, MapViewOfFile
+#else
+#include <fcntl.h>      // For open
+#include <unistd.h>     // For close
+#include <sys/mman.h>   // For mmap, madvise
+#endif
+
+// One addVoxel call, 16 bytes instead of the two copies plus map node a decoded model holds
+struct VmaxStoredVoxel {
+    uint8_t x, y, z;
+    uint8_t material;
+    uint8_t palette;
+    uint8_t pad[3];
+    uint32_t chunk;     // chunk ID passed to addVoxel
+    uint32_t chunkMin;  // morton offset passed to addVoxel
+};
+static_assert(sizeof(VmaxStoredVoxel) == 16, "VmaxStoredVoxel must stay tightly packed for the spill file");
+
+// Non owning view of a model's voxels, either resident or inside the file mapping
+struct VmaxStoredVoxelSpan {
+    const VmaxStoredVoxel* data = nullptr;
+    size_t count = 0;
+    const VmaxStoredVoxel* begin() const { return data; }
+    const VmaxStoredVoxel* end() const { return data + count; }
+    size_t size() const { return count; }
+};
+
+class VmaxModelStore {
+private:
+    struct Entry {
+        std::string name;
+        std::vector<VmaxStoredVoxel> voxels; // empty once spilled
+        uint64_t count = 0;
+        uint64_t fileOffset = 0;
+        bool spilled = false;
+    };
+
+    std::vector<Entry> entries;
+    std::list<size_t> lru; // resident entries, least recently used first
+    std::string spillPath;
+    uint64_t memoryLimit;  // bytes, 0 means never spill
+    uint64_t residentBytes = 0;
+    uint64_t fileSize = 0;
+    FILE* spillFile = nullptr;
+
+    // Read only mapping of the spill file, remapped when the file grows
+    const uint8_t* mapping = nullptr;
+    uint64_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mapHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+
+    static constexpr char kMagic[8] = {'V','M','X','S','T','O','R','E'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint64_t kHeaderSize = 16; // magic + version + reserved, keeps records 16 byte aligned
+
+    void openSpillFile() {
+        spillFile = std::fopen(spillPath.c_str(), "w+b");
+        if (!spillFile) {
+            std::cerr << "Error: Could not create model store: " << spillPath << std::endl;
+            throw std::runtime_error("Error creating model store");
+        }
+        uint32_t header[2] = {kVersion, 0};
+        if (std::fwrite(kMagic, 1, sizeof(kMagic), spillFile) != sizeof(kMagic) ||
+            std::fwrite(header, 1, sizeof(header), spillFile) != sizeof(header)) {
+            std::cerr << "Error: Could not write model store: " << spillPath << std::endl;
+            throw std::runtime_error("Error writing model store");
+        }
+        fileSize = kHeaderSize;
+    }
+
+    void unmap() {
+        if (!mapping) return;
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(mapHandle);
+        CloseHandle(fileHandle);
+        mapHandle = nullptr;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        munmap(const_cast<uint8_t*>(mapping), mappedSize);
+        close(fileDescriptor);
+        fileDescriptor = -1;
+#endif
+        mapping = nullptr;
+        mappedSize = 0;
+    }
+
+    void map() {
+        if (mapping && mappedSize == fileSize) return;
+        unmap();
+        std::fflush(spillFile);
+#ifdef _WIN32
+        fileHandle = CreateFileA(spillPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        mapHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        mapping = mapHandle ? static_cast<const uint8_t*>(MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+        fileDescriptor = open(spillPath.c_str(), O_RDONLY);
+        void* address = fileDescriptor >= 0 ? mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fileDescriptor, 0) : MAP_FAILED;
+        mapping = address == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(address);
+#endif
+        if (!mapping) {
+            std::cerr << "Error: Could not map model store: " << spillPath << std::endl;
+            throw std::runtime_error("Error mapping model store");
+        }
+        mappedSize = fileSize;
+    }
+
+    // Append a resident entry to the spill file and free its memory
+    void spill(size_t index) {
+        Entry& entry = entries[index];
+        if (!spillFile) openSpillFile();
+        // A short write (full disk) would leave a truncated store that get() maps back later,
+        // flush too so buffered bytes that can't land are caught here and not at map()
+        if (std::fseek(spillFile, 0, SEEK_END) != 0 ||
+            std::fwrite(entry.voxels.data(), sizeof(VmaxStoredVoxel), entry.voxels.size(), spillFile) != entry.voxels.size() ||
+            std::fflush(spillFile) != 0) {
+            std::cerr << "Error: Could not spill " << entry.name << " to model store: " << spillPath << std::endl;
+            throw std::runtime_error("Error writing model store");
+        }
+        entry.fileOffset = fileSize;
+        entry.spilled = true;
+        fileSize += entry.count * sizeof(VmaxStoredVoxel);
+        residentBytes -= entry.count * sizeof(VmaxStoredVoxel);
+        std::vector<VmaxStoredVoxel>().swap(entry.voxels); // actually release the capacity
+        lru.remove(index);
+        std::cout << "model store: spilled " << entry.name << " (" << entry.count << " voxels)" << std::endl;
+    }
+
+    void enforceLimit(size_t keep) {
+        if (memoryLimit == 0) return;
+        while (residentBytes > memoryLimit && !lru.empty()) {
+            size_t victim = lru.front();
+            if (victim == keep) {
+                if (lru.size() == 1) break; // the newest model alone is over the limit, keep it resident
+                lru.pop_front();
+                lru.push_back(victim);
+                continue;
+            }
+            spill(victim);
+        }
+    }
+
+    void touch(size_t index) {
+        lru.remove(index);
+        lru.push_back(index);
+    }
+
+public:
+    // @param path: spill file, created on first eviction and removed by the destructor
+    // @param limitBytes: resident voxel memory allowed before spilling, 0 never spills
+    VmaxModelStore(const std::string& path, uint64_t limitBytes) : spillPath(path), memoryLimit(limitBytes) {
+    }
+
+    ~VmaxModelStore() {
+        unmap();
+        if (spillFile) {
+            std::fclose(spillFile);
+            std::error_code ec;
+            std::filesystem::remove(spillPath, ec);
+        }
+    }
+
+    VmaxModelStore(const VmaxModelStore&) = delete;
+    VmaxModelStore& operator=(const VmaxModelStore&) = delete;
+
+    // Take ownership of a model's replay log, may spill older models
+    // @return index used to fetch the model back
+    size_t add(const std::string& name, std::vector<VmaxStoredVoxel>&& voxels) {
+        Entry entry;
+        entry.name = name;
+        entry.count = voxels.size();
+        entry.voxels = std::move(voxels);
+        entry.voxels.shrink_to_fit();
+        entries.push_back(std::move(entry));
+        size_t index = entries.size() - 1;
+        residentBytes += entries[index].count * sizeof(VmaxStoredVoxel);
+        lru.push_back(index);
+        enforceLimit(index);
+        return index;
+    }
+
+    // Page a model back in, spilled models are read through the file mapping
+    // The span stays valid until the next add() or get()
+    VmaxStoredVoxelSpan get(size_t index) {
+        Entry& entry = entries.at(index);
+        if (!entry.spilled) {
+            touch(index);
+            return VmaxStoredVoxelSpan{entry.voxels.data(), entry.voxels.size()};
+        }
+        map();
+        return VmaxStoredVoxelSpan{reinterpret_cast<const VmaxStoredVoxel*>(mapping + entry.fileOffset), entry.count};
+    }
+
+    // Done with a model, let the OS reclaim its pages
+    void release(size_t index) {
+        Entry& entry = entries.at(index);
+        if (!entry.spilled || !mapping) return;
+#ifndef _WIN32
+        long pageSize = sysconf(_SC_PAGESIZE);
+        uint64_t start = entry.fileOffset - entry.fileOffset % pageSize;
+        uint64_t end = entry.fileOffset + entry.count * sizeof(VmaxStoredVoxel);
+        madvise(const_cast<uint8_t*>(mapping) + start, end - start, MADV_DONTNEED);
+#endif
+    }
+
+    const std::string& name(size_t index) const { return entries.at(index).name; }
+    size_t size() const { return entries.size(); }
+    uint64_t getResidentBytes() const { return residentBytes; }
+    uint64_t getSpilledBytes() const { return fileSize > kHeaderSize ? fileSize - kHeaderSize : 0; }
+};
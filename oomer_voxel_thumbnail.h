@@ -0,0 +1,161 @@
+#pragma once
+
+// Isometric scene thumbnail, the thumb target of --export
+// Each content is reduced to splats, the voxels with at least one empty neighbour, shaded by
+// which of the faces the isometric camera sees (top, left, right) are exposed. Export tasks
+// build them concurrently from the decoded models, the thumbnail then walks the same node
+// tree as the glb export and z-buffers the splats of every object through its world matrix.
+// The camera looks down along (1, 1, -1) with z up, the scene is fitted into the image.
+// Huge scenes are sampled down to kThumbnailMaxSplats splats, plenty for a few hundred pixels.
+// Will avoid using bella_sdk
+
+#include <cmath>        // For std::sqrt, std::ceil
+#include <limits>       // For std::numeric_limits
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For writing the png
+#include <stdexcept>    // For std::runtime_error
+#include <algorithm>    // For std::min, std::max
+
+#include "oomer_gltf_export.h" // For the scene node tree
+#include "oomer_voxel_atlas.h"  // For encodeAtlasPng
+
+const uint32_t kThumbnailSize = 256;
+const uint64_t kThumbnailMaxSplats = 1ull << 24;
+
+struct VmaxThumbnailSplat {
+    uint8_t x, y, z;
+    uint8_t r, g, b;
+    uint8_t shade;  // 0-255 brightness of the most lit visible face
+};
+
+// Surface voxels of a model, palette holds the 255 colors, color index 1 is palette[0]
+template <typename Model, typename RGBA>
+std::vector<VmaxThumbnailSplat> buildThumbnailSplats(const Model& model, const std::vector<RGBA>& palette) {
+    std::vector<uint64_t> occupancy(256 * 256 * 256 / 64, 0);
+    auto bit = [](int x, int y, int z) { return static_cast<size_t>(x) | (static_cast<size_t>(y) << 8) | (static_cast<size_t>(z) << 16); };
+    auto filled = [&](int x, int y, int z) {
+        if (x < 0 || y < 0 || z < 0 || x > 255 || y > 255 || z > 255) return false;
+        size_t index = bit(x, y, z);
+        return ((occupancy[index / 64] >> (index % 64)) & 1u) != 0;
+    };
+    for (int material = 0; material < 8; material++) {
+        for (int color = 1; color < 256; color++) {
+            for (const auto& voxel : model.voxels[material][color]) {
+                size_t index = bit(voxel.x, voxel.y, voxel.z);
+                occupancy[index / 64] |= 1ull << (index % 64);
+            }
+        }
+    }
+    std::vector<VmaxThumbnailSplat> splats;
+    for (int material = 0; material < 8; material++) {
+        for (int color = 1; color < 256; color++) {
+            const RGBA& rgba = palette[color - 1];
+            for (const auto& voxel : model.voxels[material][color]) {
+                int x = voxel.x, y = voxel.y, z = voxel.z;
+                uint8_t shade = 0;
+                if (!filled(x, y, z + 1)) shade = 255;                       // top
+                else if (!filled(x - 1, y, z)) shade = 200;                   // left
+                else if (!filled(x, y - 1, z)) shade = 160;                   // right
+                else if (!filled(x + 1, y, z) || !filled(x, y + 1, z) || !filled(x, y, z - 1)) shade = 120; // seen through gaps only
+                if (shade == 0) continue;
+                splats.push_back(VmaxThumbnailSplat{voxel.x, voxel.y, voxel.z, rgba.r, rgba.g, rgba.b, shade});
+            }
+        }
+    }
+    return splats;
+}
+
+// RGBA image, first row is the top, transparent where nothing was drawn
+// @param splats: per mesh index of the scene nodes
+inline std::vector<uint8_t> renderThumbnail(const VmaxGltfScene& scene, const std::vector<std::vector<VmaxThumbnailSplat>>& splats, uint32_t size) {
+    // World matrices of every object node, parents on the right like oom::vmax::combineTransforms
+    struct Placement { VmaxGltfMatrix world; int mesh; };
+    std::vector<Placement> placements;
+    auto multiply = [](const VmaxGltfMatrix& a, const VmaxGltfMatrix& b) {
+        VmaxGltfMatrix result{};
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                for (int k = 0; k < 4; k++) result[r * 4 + c] += a[r * 4 + k] * b[k * 4 + c];
+            }
+        }
+        return result;
+    };
+    auto walk = [&](int node, const VmaxGltfMatrix& parentWorld, auto& self) -> void {
+        VmaxGltfMatrix world = multiply(scene.nodes[node].matrix, parentWorld);
+        int mesh = scene.nodes[node].mesh;
+        if (mesh >= 0 && mesh < static_cast<int>(splats.size()) && !splats[mesh].empty()) placements.push_back(Placement{world, mesh});
+        for (int child : scene.nodes[node].children) self(child, world, self);
+    };
+    for (int root : scene.roots) walk(root, kGltfIdentity, walk);
+
+    uint64_t total = 0;
+    for (const Placement& placement : placements) total += splats[placement.mesh].size();
+    size_t stride = static_cast<size_t>(std::max<uint64_t>(1, (total + kThumbnailMaxSplats - 1) / kThumbnailMaxSplats));
+
+    // Isometric basis, view direction (1, 1, -1)
+    const double right[3] = {0.70710678, -0.70710678, 0.0};
+    const double up[3] = {0.40824829, 0.40824829, 0.81649658};
+    const double toward[3] = {-0.57735027, -0.57735027, 0.57735027}; // larger is nearer
+    auto project = [&](const VmaxGltfMatrix& m, double x, double y, double z, double out[3]) {
+        double p[3];
+        for (int c = 0; c < 3; c++) p[c] = x * m[c] + y * m[4 + c] + z * m[8 + c] + m[12 + c];
+        out[0] = p[0] * right[0] + p[1] * right[1] + p[2] * right[2];
+        out[1] = p[0] * up[0] + p[1] * up[1] + p[2] * up[2];
+        out[2] = p[0] * toward[0] + p[1] * toward[1] + p[2] * toward[2];
+    };
+
+    // Fit the projected bounds of every placement into the image with a small margin
+    double lo[2] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    double hi[2] = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+    for (const Placement& placement : placements) {
+        for (size_t i = 0; i < splats[placement.mesh].size(); i += stride) {
+            const VmaxThumbnailSplat& splat = splats[placement.mesh][i];
+            double q[3];
+            project(placement.world, splat.x + 0.5, splat.y + 0.5, splat.z + 0.5, q);
+            for (int a = 0; a < 2; a++) {
+                lo[a] = std::min(lo[a], q[a]);
+                hi[a] = std::max(hi[a], q[a]);
+            }
+        }
+    }
+    std::vector<uint8_t> rgba(static_cast<size_t>(size) * size * 4, 0);
+    if (placements.empty() || lo[0] > hi[0]) return rgba;
+    double extent = std::max({hi[0] - lo[0], hi[1] - lo[1], 1.0});
+    double scale = size * 0.9 / extent;
+    double center[2] = {(lo[0] + hi[0]) * 0.5, (lo[1] + hi[1]) * 0.5};
+
+    std::vector<float> depth(static_cast<size_t>(size) * size, std::numeric_limits<float>::lowest());
+    for (const Placement& placement : placements) {
+        const VmaxGltfMatrix& m = placement.world;
+        double voxelScale = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+        int radius = std::max(0, static_cast<int>(std::ceil(voxelScale * scale * std::sqrt(static_cast<double>(stride)) * 0.5)) - 1);
+        for (size_t i = 0; i < splats[placement.mesh].size(); i += stride) {
+            const VmaxThumbnailSplat& splat = splats[placement.mesh][i];
+            double q[3];
+            project(m, splat.x + 0.5, splat.y + 0.5, splat.z + 0.5, q);
+            int px = static_cast<int>((q[0] - center[0]) * scale + size * 0.5);
+            int py = static_cast<int>(size * 0.5 - (q[1] - center[1]) * scale);
+            for (int y = std::max(0, py - radius); y <= std::min<int>(size - 1, py + radius); y++) {
+                for (int x = std::max(0, px - radius); x <= std::min<int>(size - 1, px + radius); x++) {
+                    size_t pixel = static_cast<size_t>(y) * size + x;
+                    if (q[2] <= depth[pixel]) continue;
+                    depth[pixel] = static_cast<float>(q[2]);
+                    rgba[pixel * 4 + 0] = static_cast<uint8_t>(splat.r * splat.shade / 255);
+                    rgba[pixel * 4 + 1] = static_cast<uint8_t>(splat.g * splat.shade / 255);
+                    rgba[pixel * 4 + 2] = static_cast<uint8_t>(splat.b * splat.shade / 255);
+                    rgba[pixel * 4 + 3] = 255;
+                }
+            }
+        }
+    }
+    return rgba;
+}
+
+inline void writeThumbnail(const VmaxGltfScene& scene, const std::vector<std::vector<VmaxThumbnailSplat>>& splats, const std::string& fileName) {
+    std::vector<uint8_t> png = encodeAtlasPng(renderThumbnail(scene, splats, kThumbnailSize), kThumbnailSize, kThumbnailSize);
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("Failed to write thumbnail: " + fileName);
+    file.write(reinterpret_cast<const char*>(png.data()), png.size());
+}
@@ -15,7 +15,10 @@
 #include <filesystem>   // For file system operations (directory handling, path manipulation)
 
 #include "../lzfse/src/lzfse.h"
+#include "oomer_lzfse_blocks.h" // block parallel lzfse decoding
 #include "../libplist/include/plist/plist.h" // Library for handling Apple property list files
+#include "oomer_voxel_range.h" // For decoding snapshots in place
+#include "oomer_voxel_occupancy.h" // For the occupancy summary VmaxModel keeps
 #include "thirdparty/json.hpp"
 
 using json = nlohmann::json;
@@ -152,16 +155,8 @@ struct VmaxRGBA {
     uint8_t r, g, b, a;
 };
 
-// Read a 256x1 PNG file and return a vector of VmaxRGBA colors
-std::vector<VmaxRGBA> read256x1PaletteFromPNG(const std::string& filename) {
-    int width, height, channels;
-    // Load the image with 4 desired channels (RGBA)
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 4);
-    
-    if (!data) {
-        std::cerr << "Error loading PNG file: " << filename << std::endl;
-        return {};
-    }
+// Copy the first row of an RGBA image into a palette, shared by the file and memory readers
+inline std::vector<VmaxRGBA> paletteFromRGBA(const unsigned char* data, int width, int height) {
     // Make sure the image is 256x1 as expected
     if (width != 256 || height != 1) {
         std::cerr << "Warning: Expected a 256x1 image, but got " << width << "x" << height << std::endl;
@@ -177,6 +172,33 @@ std::vector<VmaxRGBA> read256x1PaletteFromPNG(const std::string& filename) {
         color.a = data[i * 4 + 3];
         palette.push_back(color);
     }
+    return palette;
+}
+
+// Read a 256x1 PNG file and return a vector of VmaxRGBA colors
+std::vector<VmaxRGBA> read256x1PaletteFromPNG(const std::string& filename) {
+    int width, height, channels;
+    // Load the image with 4 desired channels (RGBA)
+    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &channels, 4);
+    
+    if (!data) {
+        std::cerr << "Error loading PNG file: " << filename << std::endl;
+        return {};
+    }
+    std::vector<VmaxRGBA> palette = paletteFromRGBA(data, width, height);
+    stbi_image_free(data); // Free the image data
+    return palette;
+}
+
+// Same as read256x1PaletteFromPNG for a PNG that is already in memory
+inline std::vector<VmaxRGBA> read256x1PaletteFromMemory(const uint8_t* bytes, size_t size) {
+    int width, height, channels;
+    unsigned char* data = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &channels, 4);
+    if (!data) {
+        std::cerr << "Error decoding PNG from memory" << std::endl;
+        return {};
+    }
+    std::vector<VmaxRGBA> palette = paletteFromRGBA(data, width, height);
     stbi_image_free(data); // Free the image data
     return palette;
 }
@@ -289,6 +311,9 @@ struct VmaxModel {
     std::array<VmaxRGBA, 256> colors;
     uint8_t maxx=0, maxy=0, maxz=0;
 
+    // Which chunks, bricks and buckets hold voxels, so passes skip empty regions without scanning voxels
+    VmaxOccupancySummary occupancy;
+
     // Constructor
     VmaxModel(const std::string& modelName) : vmaxbFileName(modelName) {
     }
@@ -328,6 +353,7 @@ struct VmaxModel {
             if (x > maxx) maxx = x;
             if (y > maxy) maxy = y;
             if (z > maxz) maxz = z;
+            occupancy.add(x, y, z, material, color);
         }
     }
     
@@ -582,46 +608,12 @@ VmaxChunkInfo vmaxChunkInfo(const plist_t& plist_snapshot_dict_item) {
 std::vector<VmaxVoxel> vmaxVoxelInfo(plist_t& plist_datastream, uint64_t chunkID, uint64_t minMorton) {
     std::vector<VmaxVoxel> voxelsArray; 
     try {
-
-        // Extract the binary data
-        char* data = nullptr;
+        // Decode straight from the plist's own buffer, see oomer_voxel_range.h
         uint64_t length = 0;
-        plist_get_data_val(plist_datastream, &data, &length);
-        auto foo =  std::vector<uint8_t>(data, data + length) ;
-        std::vector<VmaxVoxel> allModelVoxels = decodeVoxels(std::vector<uint8_t>(data, data + length), minMorton, chunkID);
-
-        //std::cout << "allModelVoxels: " << allModelVoxels.size() << std::endl;
-
-        uint32_t model_8x8x8_x, model_8x8x8_y, model_8x8x8_z;
-        decodeMorton3DOptimized(chunkID, 
-                                model_8x8x8_x, 
-                                model_8x8x8_y, 
-                                model_8x8x8_z); // index IS the morton code
-        int model_256x256x256_x = model_8x8x8_x * 8; // convert to model space
-        int model_256x256x256_y = model_8x8x8_y * 8;
-        int model_256x256x256_z = model_8x8x8_z * 8;
-
-        for (const VmaxVoxel& eachVmaxVoxel : allModelVoxels) {
-            auto [  chunk_32x32x32_x, 
-                    chunk_32x32x32_y, 
-                    chunk_32x32x32_z, 
-                    materialMap, 
-                    colorMap, 
-                    chunkID, 
-                    minMorton] = eachVmaxVoxel;
-
-            int voxel_256x256x256_x = model_256x256x256_x + chunk_32x32x32_x;
-            int voxel_256x256x256_y = model_256x256x256_y + chunk_32x32x32_y;
-            int voxel_256x256x256_z = model_256x256x256_z + chunk_32x32x32_z;
-
-            auto one_voxel = VmaxVoxel(voxel_256x256x256_x, 
-                                    voxel_256x256x256_y, 
-                                    voxel_256x256x256_z, 
-                                    materialMap, 
-                                    colorMap,
-                                    chunkID,
-                                    minMorton);
-            voxelsArray.push_back(one_voxel);
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(plist_get_data_ptr(plist_datastream, &length));
+        voxelsArray.reserve(length / 2);
+        for (const VmaxStreamVoxel& voxel : VmaxSnapshotVoxels(data, length, chunkID, minMorton)) {
+            voxelsArray.push_back(VmaxVoxel(voxel.infoX, voxel.infoY, voxel.infoZ, voxel.material, voxel.color, chunkID, minMorton));
         }
         return voxelsArray;
     } catch (std::exception& e) {
@@ -645,57 +637,20 @@ std::vector<VmaxVoxel> vmaxVoxelInfo(plist_t& plist_datastream, uint64_t chunkID
  * @param plistName Name of the plist file to write (optional)
  * @return plist_t A pointer to the root node of the parsed plist, or nullptr if failed
  */
-// read binary lzfse compressed/uncompressed file 
-inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist, bool decompress) {
-    // Get file size using std::filesystem
-    size_t rawFileSize = std::filesystem::file_size(inStrPlist);
-    std::vector<uint8_t> rawBytes(rawFileSize);
+// Parse plist bytes that are already in memory, lzfse compressed or not
+// Used by readPlist and by callers that never touch the disk (see oomer_vmax_convert.h)
+// @param outStrPlist: optionally write the decompressed plist to this file for debugging
+inline plist_t readPlistFromMemory(const uint8_t* rawBytes, size_t rawSize, bool decompress, const std::string& outStrPlist = "") {
     std::vector<uint8_t> outBuffer;
-    size_t decodedSize = 0;
+    const uint8_t* plistBytes = rawBytes;
+    size_t decodedSize = rawSize; // decodedSize is the same as rawSize when data is not compressed
     if (decompress) { // files are either lzfse compressed or uncompressed
-        std::ifstream rawBytesFile(inStrPlist, std::ios::binary);
-        if (!rawBytesFile.is_open()) {
-            std::cerr << "Error: Could not open plist file: " << inStrPlist << std::endl;
-            throw std::runtime_error("Error message"); // [learned] no need to return nullptr
-        }
-        
-        rawBytesFile.read(reinterpret_cast<char*>(rawBytes.data()), rawFileSize);
-        rawBytesFile.close();
-        // Start with output buffer 4x input size (compression ratio is usually < 4)
-        size_t outAllocatedSize = rawFileSize * 8;
-        // vector<uint8_t> automatically manages memory allocation/deallocation
-        //std::vector<uint8_t> outBuffer(outAllocatedSize);
-        outBuffer.resize(outAllocatedSize);  // Resize preserves existing content
-
-        // LZFSE needs a scratch buffer for its internal operations
-        // Get the required size and allocate it
-        size_t scratchSize = lzfse_decode_scratch_size();
-        std::vector<uint8_t> scratch(scratchSize);
-
-        // Decompress the data, growing the output buffer if needed
-        //size_t decodedSize = 0;
-        while (true) {
-            // Try to decompress with current buffer size
-            decodedSize = lzfse_decode_buffer(
-                outBuffer.data(),     // Where to store decompressed data
-                outAllocatedSize,     // Size of output buffer
-                rawBytes.data(),            // Source of compressed data
-                rawBytes.size(),            // Size of compressed data
-                scratch.data());      // Scratch space for LZFSE
-
-            // Check if we need a larger buffer:
-            // - decodedSize == 0 indicates failure
-            // - decodedSize == outAllocatedSize might mean buffer was too small
-            if (decodedSize == 0 || decodedSize == outAllocatedSize) {
-                outAllocatedSize *= 2;  // Double the buffer size
-                outBuffer.resize(outAllocatedSize);  // Resize preserves existing content
-                continue;  // Try again with larger buffer
-            }
-            break;  // Successfully decompressed
-        }
+        // Block headers give the exact output size, independent blocks decode in parallel
+        bool decoded = decodeLzfseStream(rawBytes, rawSize, outBuffer);
+        decodedSize = outBuffer.size();
 
         // Check if decompression failed
-        if (decodedSize == 0) {
+        if (!decoded || decodedSize == 0) {
             std::cerr << "Failed to decompress data" << std::endl;
             return nullptr;
         }
@@ -710,20 +665,8 @@ inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist,
                 std::cerr << "Failed to write plist to file: " << outStrPlist << std::endl;
             }
         }
-    } else {
-        outBuffer.resize(rawFileSize); 
-        // if the file is not compressed, just read the raw bytes
-        std::ifstream rawBytesFile(inStrPlist, std::ios::binary);
-        if (!rawBytesFile.is_open()) {
-            std::cerr << "Error: Could not open plist file: " << inStrPlist << std::endl;
-            throw std::runtime_error("Error message"); // [learned] no need to return nullptr
-        }
-        rawBytesFile.read(reinterpret_cast<char*>(outBuffer.data()), rawFileSize);
-        rawBytesFile.close();
-        decodedSize = rawFileSize; // decodedSize is the same as rawFileSize when data is not compressed
-
-
-    } // outBuffer now contains the raw bytes of the plist file
+        plistBytes = outBuffer.data();
+    } // plistBytes now points at the raw bytes of the plist
 
     // Parse the decompressed data as a plist
     plist_t root_node = nullptr;
@@ -731,7 +674,7 @@ inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist,
     
     // Convert the raw decompressed data into a plist structure
     plist_err_t err = plist_from_memory(
-        reinterpret_cast<const char*>(outBuffer.data()),  // Cast uint8_t* to char*
+        reinterpret_cast<const char*>(plistBytes),        // Cast uint8_t* to char*
         static_cast<uint32_t>(decodedSize),               // Cast size_t to uint32_t
         &root_node,                                       // Where to store the parsed plist
         &format);                                         // Where to store the format
@@ -745,7 +688,21 @@ inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist,
     return root_node;  // Caller is responsible for calling plist_free()
 }
 
-// Overload for when you only want to specify inStrPlist and decompress
+// read binary lzfse compressed/uncompressed file 
+inline plist_t readPlist(const std::string& inStrPlist, std::string outStrPlist, bool decompress) {
+    // Get file size using std::filesystem
+    size_t rawFileSize = std::filesystem::file_size(inStrPlist);
+    std::vector<uint8_t> rawBytes(rawFileSize);
+    std::ifstream rawBytesFile(inStrPlist, std::ios::binary);
+    if (!rawBytesFile.is_open()) {
+        std::cerr << "Error: Could not open plist file: " << inStrPlist << std::endl;
+        throw std::runtime_error("Error message"); // [learned] no need to return nullptr
+    }
+    rawBytesFile.read(reinterpret_cast<char*>(rawBytes.data()), rawFileSize);
+    rawBytesFile.close();
+    return readPlistFromMemory(rawBytes.data(), rawBytes.size(), decompress, outStrPlist);
+}
+
 inline plist_t readPlist(const std::string& inStrPlist, bool decompress) {
     return readPlist(inStrPlist, "", decompress);
 }
@@ -804,7 +761,26 @@ public:
             json sceneData;
             file >> sceneData;
             file.close();
-            
+            return parseSceneData(sceneData);
+        } catch (const std::exception& e) {
+            std::cerr << "Error parsing JSON: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    // Same as parseScene for a scene.json that is already in memory
+    bool parseSceneFromMemory(const uint8_t* bytes, size_t size) {
+        try {
+            json sceneData = json::parse(bytes, bytes + size);
+            return parseSceneData(sceneData);
+        } catch (const std::exception& e) {
+            std::cerr << "Error parsing JSON: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    bool parseSceneData(const json& sceneData) {
+        try {
             // Parse groups
             if (sceneData.contains("groups") && sceneData["groups"].is_array()) {
                 for (const auto& group : sceneData["groups"]) {
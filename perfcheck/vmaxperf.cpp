@@ -0,0 +1,528 @@
+// vmaxperf.cpp - performance regression gate for vmax2bella
+//
+// make perfcheck uses this tool to
+//   1. generate a fixed synthetic .vmax project (always byte identical)
+//   2. compare the --stats json of a vmax2bella run against perfcheck/baseline.json
+// make perfbaseline records a new baseline from a run on the reference machine
+// make perfnuma converts the corpus with and without --numa and prints the speedup
+// make perfcheck also converts a corpus of duplicated nested groups with --subtrees, alone
+// and with --batchsmall, and checks the exact prototype, copy and object xform counts
+//
+// Usage:
+//   vmaxperf generate <out.vmax>
+//   vmaxperf subtrees <out.vmax>
+//   vmaxperf expect <stats.json> <count>=<value>...
+//   vmaxperf compare <baseline.json> <stats.json>
+//   vmaxperf baseline <stats.json> <baseline.json>
+//   vmaxperf versus <default.json> <variant.json>
+
+#include <map>          // For key-value pair data structures (maps)
+#include <cmath>        // For std::abs
+#include <algorithm>    // For std::max
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <cstring>      // For strcmp
+#include <fstream>      // For file operations (reading/writing files)
+#include <iostream>     // For input/output operations (cout, cin, etc.)
+#include <filesystem>   // For creating the project directory
+
+#include "../../lzfse/src/lzfse.h"
+#include "../../libplist/include/plist/plist.h" // Library for handling Apple property list files
+#include "../thirdparty/json.hpp"
+
+using json = nlohmann::json;
+
+//==============================================================================
+// SYNTHETIC CORPUS
+//==============================================================================
+
+// Deterministic generator so the corpus never changes between machines
+struct PerfRandom {
+    uint32_t state;
+    explicit PerfRandom(uint32_t seed) : state(seed) {}
+    uint32_t next() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+// Inverse of compactBits, spreads the low 10 bits so that every 3rd bit is used
+inline uint32_t spreadBits(uint32_t n) {
+    n &= 0x000003ff;
+    n = (n ^ (n << 16)) & 0xff0000ff;
+    n = (n ^ (n << 8)) & 0x0300f00f;
+    n = (n ^ (n << 4)) & 0x030c30c3;
+    n = (n ^ (n << 2)) & 0x09249249;
+    return n;
+}
+
+inline uint32_t encodeMorton3D(uint32_t x, uint32_t y, uint32_t z) {
+    return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+}
+
+// One 32x32x32 chunk as VoxelMax stores it, ds holds (material, color) per morton index
+struct PerfChunk {
+    uint32_t chunkID;
+    std::vector<uint8_t> ds = std::vector<uint8_t>(32 * 32 * 32 * 2, 0);
+
+    void set(uint32_t x, uint32_t y, uint32_t z, uint8_t material, uint8_t color) {
+        uint32_t index = encodeMorton3D(x, y, z);
+        ds[index * 2] = material;
+        ds[index * 2 + 1] = color;
+    }
+};
+
+plist_t makeUintArray(std::initializer_list<uint64_t> values) {
+    plist_t array = plist_new_array();
+    for (uint64_t value : values) plist_array_append_item(array, plist_new_uint(value));
+    return array;
+}
+
+bool writeBytes(const std::filesystem::path& fileName, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not write file: " << fileName << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return true;
+}
+
+std::vector<uint8_t> plistToBinary(plist_t root) {
+    char* data = nullptr;
+    uint32_t length = 0;
+    plist_to_bin(root, &data, &length);
+    std::vector<uint8_t> bytes(data, data + length);
+    plist_mem_free(data);
+    return bytes;
+}
+
+// contentsN.vmaxb is an lzfse compressed binary plist of snapshots
+bool writeContents(const std::filesystem::path& fileName, const std::vector<PerfChunk>& chunks) {
+    plist_t root = plist_new_dict();
+    plist_t snapshots = plist_new_array();
+    for (const PerfChunk& chunk : chunks) {
+        uint64_t count = 0;
+        std::vector<uint8_t> layerColors(256, 0);
+        for (size_t i = 0; i < chunk.ds.size(); i += 2) {
+            if (chunk.ds[i + 1] == 0) continue;
+            count++;
+            layerColors[chunk.ds[i + 1]] = 1;
+        }
+        plist_t id = plist_new_dict();
+        plist_dict_set_item(id, "c", plist_new_uint(chunk.chunkID));
+        plist_dict_set_item(id, "s", plist_new_uint(10));
+        plist_dict_set_item(id, "t", plist_new_uint(4)); // checkpoint
+        plist_t stats = plist_new_dict();
+        plist_dict_set_item(stats, "c", plist_new_uint(count));
+        plist_dict_set_item(stats, "min", makeUintArray({0, 0, 0, 0}));
+        plist_dict_set_item(stats, "max", makeUintArray({31, 31, 31, 32767}));
+        plist_t snapshot = plist_new_dict();
+        plist_dict_set_item(snapshot, "id", id);
+        plist_dict_set_item(snapshot, "st", stats);
+        plist_dict_set_item(snapshot, "ds", plist_new_data(reinterpret_cast<const char*>(chunk.ds.data()), chunk.ds.size()));
+        plist_dict_set_item(snapshot, "lc", plist_new_data(reinterpret_cast<const char*>(layerColors.data()), layerColors.size()));
+        plist_t item = plist_new_dict();
+        plist_dict_set_item(item, "s", snapshot);
+        plist_array_append_item(snapshots, item);
+    }
+    plist_dict_set_item(root, "snapshots", snapshots);
+    std::vector<uint8_t> raw = plistToBinary(root);
+    plist_free(root);
+
+    std::vector<uint8_t> compressed(raw.size() + 4096);
+    std::vector<uint8_t> scratch(lzfse_encode_scratch_size());
+    size_t compressedSize = lzfse_encode_buffer(compressed.data(), compressed.size(), raw.data(), raw.size(), scratch.data());
+    if (compressedSize == 0) {
+        std::cerr << "Failed to compress: " << fileName << std::endl;
+        return false;
+    }
+    compressed.resize(compressedSize);
+    return writeBytes(fileName, compressed);
+}
+
+// paletteN.settings.vmaxpsb is an uncompressed binary plist with 8 materials
+bool writeMaterials(const std::filesystem::path& fileName) {
+    plist_t root = plist_new_dict();
+    plist_t materials = plist_new_array();
+    for (int i = 0; i < 8; i++) {
+        plist_t material = plist_new_dict();
+        plist_dict_set_item(material, "mi", plist_new_string(("perf" + std::to_string(i)).c_str()));
+        plist_dict_set_item(material, "tc", plist_new_real(i == 5 ? 0.5 : 0.0));
+        plist_dict_set_item(material, "sic", plist_new_real(i == 4 ? 1.0 : 0.0));
+        plist_dict_set_item(material, "rc", plist_new_real(i * 0.125));
+        plist_dict_set_item(material, "mc", plist_new_real(i == 3 ? 1.0 : 0.0));
+        plist_dict_set_item(material, "sh", plist_new_bool(1));
+        plist_array_append_item(materials, material);
+    }
+    plist_dict_set_item(root, "materials", materials);
+    std::vector<uint8_t> raw = plistToBinary(root);
+    plist_free(root);
+    return writeBytes(fileName, raw);
+}
+
+uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(value >> 24); out.push_back(value >> 16); out.push_back(value >> 8); out.push_back(value);
+}
+
+void appendPngChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+    appendBigEndian(png, static_cast<uint32_t>(data.size()));
+    std::vector<uint8_t> typed(type, type + 4);
+    typed.insert(typed.end(), data.begin(), data.end());
+    png.insert(png.end(), typed.begin(), typed.end());
+    appendBigEndian(png, crc32(typed.data(), typed.size()));
+}
+
+// paletteN.png is 256x1 RGBA, written with a stored (uncompressed) deflate block
+bool writePalette(const std::filesystem::path& fileName, uint32_t seed) {
+    PerfRandom random(seed);
+    std::vector<uint8_t> scanline = {0}; // filter type none
+    for (int i = 0; i < 256; i++) {
+        scanline.push_back(random.below(256));
+        scanline.push_back(random.below(256));
+        scanline.push_back(random.below(256));
+        scanline.push_back(i % 17 == 16 ? 128 : 255); // a few translucent colors become glass
+    }
+    uint32_t a = 1, b = 0; // adler32
+    for (uint8_t byte : scanline) { a = (a + byte) % 65521; b = (b + a) % 65521; }
+    std::vector<uint8_t> zlib = {0x78, 0x01, 0x01}; // zlib header, final stored block
+    uint16_t length = static_cast<uint16_t>(scanline.size());
+    zlib.push_back(length & 0xff); zlib.push_back(length >> 8);
+    zlib.push_back(~length & 0xff); zlib.push_back((~length >> 8) & 0xff);
+    zlib.insert(zlib.end(), scanline.begin(), scanline.end());
+    appendBigEndian(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> header;
+    appendBigEndian(header, 256);
+    appendBigEndian(header, 1);
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8 bit RGBA
+    std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    appendPngChunk(png, "IHDR", header);
+    appendPngChunk(png, "IDAT", zlib);
+    appendPngChunk(png, "IEND", {});
+    return writeBytes(fileName, png);
+}
+
+json perfTransform(double x, double y, double z, double angle) {
+    return json{{"t_p", {x, y, z}}, {"t_r", {0.0, 1.0, 0.0, angle}}, {"t_s", {1.0, 1.0, 1.0}},
+                {"e_c", {0.0, 0.0, 0.0}}, {"e_mi", {0.0, 0.0, 0.0}}, {"e_ma", {0.0, 0.0, 0.0}}};
+}
+
+// Three contents that stress different paths
+//   contents0 dense single color terrain, 4 chunks, one instance
+//   contents1 sparse noise with every material and many colors, two instances
+//   contents2 small prop, 64 instances inside a group
+bool generateCorpus(const std::filesystem::path& dirName) {
+    std::filesystem::create_directories(dirName);
+
+    std::vector<PerfChunk> terrain;
+    for (uint32_t cz = 0; cz < 2; cz++) {
+        for (uint32_t cx = 0; cx < 2; cx++) {
+            PerfChunk chunk{encodeMorton3D(cx, 0, cz)};
+            for (uint32_t z = 0; z < 32; z++) {
+                for (uint32_t x = 0; x < 32; x++) {
+                    uint32_t height = 8 + ((x + cx * 32) * 7 + (z + cz * 32) * 13) % 16;
+                    for (uint32_t y = 0; y < height; y++) {
+                        chunk.set(x, y, z, 0, y + 1 < height ? 12 : 40);
+                    }
+                }
+            }
+            terrain.push_back(chunk);
+        }
+    }
+
+    PerfRandom random(1234);
+    PerfChunk noise{0};
+    for (uint32_t i = 0; i < 32 * 32 * 32 / 20; i++) {
+        noise.set(random.below(32), random.below(32), random.below(32), random.below(8), 1 + random.below(200));
+    }
+
+    PerfChunk prop{0};
+    for (uint32_t z = 0; z < 6; z++) {
+        for (uint32_t y = 0; y < 6; y++) {
+            for (uint32_t x = 0; x < 6; x++) {
+                prop.set(x, y, z, (x + y + z) % 3, 1 + (x ^ z) % 4);
+            }
+        }
+    }
+
+    std::vector<std::vector<PerfChunk>> contents = {terrain, {noise}, {prop}};
+    for (size_t i = 0; i < contents.size(); i++) {
+        std::string index = std::to_string(i);
+        if (!writeContents(dirName / ("contents" + index + ".vmaxb"), contents[i])) return false;
+        if (!writePalette(dirName / ("palette" + index + ".png"), static_cast<uint32_t>(i + 1))) return false;
+        if (!writeMaterials(dirName / ("palette" + index + ".settings.vmaxpsb"))) return false;
+    }
+
+    json scene;
+    json group = perfTransform(10.0, 0.0, 10.0, 0.3);
+    group["id"] = "group-props";
+    group["name"] = "props";
+    scene["groups"] = json::array({group});
+    scene["objects"] = json::array();
+    auto addObject = [&](const std::string& id, const std::string& parentId, int content, json transform) {
+        transform["id"] = id;
+        transform["pid"] = parentId;
+        transform["n"] = id;
+        transform["data"] = "contents" + std::to_string(content) + ".vmaxb";
+        transform["pal"] = "palette" + std::to_string(content) + ".png";
+        transform["hist"] = "";
+        scene["objects"].push_back(transform);
+    };
+    addObject("object-terrain", "", 0, perfTransform(0.0, 0.0, 0.0, 0.0));
+    addObject("object-noise-a", "", 1, perfTransform(80.0, 0.0, 0.0, 0.0));
+    addObject("object-noise-b", "", 1, perfTransform(80.0, 0.0, 40.0, 1.57));
+    for (int i = 0; i < 64; i++) {
+        addObject("object-prop-" + std::to_string(i), "group-props", 2, perfTransform((i % 8) * 8.0, 24.0, (i / 8) * 8.0, i * 0.1));
+    }
+    std::ofstream sceneFile(dirName / "scene.json");
+    sceneFile << scene.dump(2);
+    std::cout << "Generated synthetic corpus: " << dirName.string() << std::endl;
+    return static_cast<bool>(sceneFile);
+}
+
+// Duplicated nested groups for --subtrees
+//   street-a and street-b are identical streets of two identical houses, house-c is one
+//   more house standing alone. Each house holds a table (contents0) and a chair (contents1)
+// The larger subtree wins, street-b is a copy of street-a and only then the houses are
+// matched: house-c comes first in id order so both houses of street-a become its copies.
+// Matching the houses first would also turn both houses of street-b into copies.
+// That's 2 prototypes, 3 copies and 2 object xforms (house-c's) out of 10 objects
+bool generateSubtreeCorpus(const std::filesystem::path& dirName) {
+    std::filesystem::create_directories(dirName);
+
+    PerfChunk table{0};
+    for (uint32_t x = 0; x < 8; x++) {
+        for (uint32_t z = 0; z < 8; z++) {
+            table.set(x, 6, z, 0, 3);
+        }
+    }
+    for (uint32_t y = 0; y < 6; y++) {
+        table.set(0, y, 0, 0, 4);
+        table.set(7, y, 7, 0, 4);
+    }
+    PerfChunk chair{0};
+    for (uint32_t y = 0; y < 8; y++) {
+        chair.set(0, y, 0, 1, 9);
+        chair.set(3, y / 2, 3, 1, 9);
+    }
+
+    std::vector<std::vector<PerfChunk>> contents = {{table}, {chair}};
+    for (size_t i = 0; i < contents.size(); i++) {
+        std::string index = std::to_string(i);
+        if (!writeContents(dirName / ("contents" + index + ".vmaxb"), contents[i])) return false;
+        if (!writePalette(dirName / ("palette" + index + ".png"), static_cast<uint32_t>(i + 7))) return false;
+        if (!writeMaterials(dirName / ("palette" + index + ".settings.vmaxpsb"))) return false;
+    }
+
+    json scene;
+    scene["groups"] = json::array();
+    scene["objects"] = json::array();
+    auto addGroup = [&](const std::string& id, const std::string& parentId, json transform) {
+        transform["id"] = id;
+        transform["pid"] = parentId;
+        transform["name"] = id;
+        scene["groups"].push_back(transform);
+    };
+    auto addObject = [&](const std::string& id, const std::string& parentId, int content, json transform) {
+        transform["id"] = id;
+        transform["pid"] = parentId;
+        transform["n"] = id;
+        transform["data"] = "contents" + std::to_string(content) + ".vmaxb";
+        transform["pal"] = "palette" + std::to_string(content) + ".png";
+        transform["hist"] = "";
+        scene["objects"].push_back(transform);
+    };
+    auto addHouse = [&](const std::string& id, const std::string& parentId, json transform) {
+        addGroup(id, parentId, transform);
+        addObject(id + "-table", id, 0, perfTransform(2.0, 0.0, 2.0, 0.0));
+        addObject(id + "-chair", id, 1, perfTransform(6.0, 0.0, 2.0, 1.57));
+    };
+    for (const std::string street : {"street-a", "street-b"}) {
+        addGroup(street, "", perfTransform(0.0, 0.0, street == "street-a" ? 0.0 : 100.0, 0.0));
+        addHouse(street + "-house-1", street, perfTransform(0.0, 0.0, 0.0, 0.0));
+        addHouse(street + "-house-2", street, perfTransform(40.0, 0.0, 0.0, 0.0));
+    }
+    addHouse("house-c", "", perfTransform(200.0, 0.0, 0.0, 0.5));
+    std::ofstream sceneFile(dirName / "scene.json");
+    sceneFile << scene.dump(2);
+    std::cout << "Generated subtree corpus: " << dirName.string() << std::endl;
+    return static_cast<bool>(sceneFile);
+}
+
+//==============================================================================
+// BASELINE COMPARISON
+//==============================================================================
+
+bool readJson(const std::string& fileName, json& result) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << fileName << std::endl;
+        return false;
+    }
+    try {
+        file >> result;
+    } catch (const std::exception& e) {
+        std::cerr << "Error parsing JSON: " << fileName << " " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Time and memory may grow by a relative tolerance, tiny phases also get an absolute
+// allowance so scheduler noise doesn't fail the gate. Geometry counts must match
+// within countTolerance, a changed count means the output scene changed.
+int compareStats(const json& baseline, const json& stats) {
+    const json tolerances = baseline.value("tolerances", json::object());
+    double timeTolerance = tolerances.value("time", 0.25);
+    double timeFloorSeconds = tolerances.value("timeFloorSeconds", 0.05);
+    double memoryTolerance = tolerances.value("memory", 0.15);
+    double countTolerance = tolerances.value("count", 0.0);
+    const json metrics = baseline.value("metrics", json::object());
+    if (metrics.empty()) { // an empty baseline would pass any numbers, that's not a gate
+        std::cout << "perfcheck: FAIL baseline has no metrics, record one with make perfbaseline and commit it" << std::endl;
+        return 1;
+    }
+
+    int regressions = 0;
+    auto report = [&](const std::string& name, double base, double current, bool failed) {
+        std::cout << (failed ? "FAIL " : "ok   ") << name << ": baseline " << base << " current " << current;
+        if (base > 0.0) std::cout << " (" << (current / base - 1.0) * 100.0 << "%)";
+        std::cout << std::endl;
+        if (failed) regressions++;
+    };
+
+    const json basePhases = metrics.value("phases", json::object());
+    const json currentPhases = stats.value("phases", json::object());
+    for (const auto& [phase, base] : basePhases.items()) {
+        double current = currentPhases.value(phase, 0.0);
+        double allowed = std::max(base.get<double>() * (1.0 + timeTolerance), base.get<double>() + timeFloorSeconds);
+        report("phase " + phase, base.get<double>(), current, current > allowed);
+    }
+    if (metrics.contains("totalSeconds")) {
+        double base = metrics["totalSeconds"].get<double>();
+        double current = stats.value("totalSeconds", 0.0);
+        report("totalSeconds", base, current, current > std::max(base * (1.0 + timeTolerance), base + timeFloorSeconds));
+    }
+    if (metrics.contains("peakRssBytes")) {
+        double base = metrics["peakRssBytes"].get<double>();
+        double current = stats.value("peakRssBytes", 0.0);
+        report("peakRssBytes", base, current, current > base * (1.0 + memoryTolerance));
+    }
+    const json baseCounts = metrics.value("counts", json::object());
+    const json currentCounts = stats.value("counts", json::object());
+    for (const auto& [count, base] : baseCounts.items()) {
+        double current = currentCounts.value(count, 0.0);
+        double difference = std::abs(current - base.get<double>());
+        report("count " + count, base.get<double>(), current, difference > base.get<double>() * countTolerance);
+    }
+
+    if (regressions > 0) {
+        std::cout << "perfcheck: " << regressions << " regression(s) beyond tolerance" << std::endl;
+        return 1;
+    }
+    std::cout << "perfcheck: passed" << std::endl;
+    return 0;
+}
+
+// Exact geometry counts of a run, for corpora whose output is known by construction
+int expectCounts(const json& stats, int argc, char** argv) {
+    const json counts = stats.value("counts", json::object());
+    int mismatches = 0;
+    for (int i = 0; i < argc; i++) {
+        std::string expectation = argv[i];
+        size_t equals = expectation.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << "Error: expected <count>=<value>, got " << expectation << std::endl;
+            return 2;
+        }
+        std::string name = expectation.substr(0, equals);
+        double expected = std::stod(expectation.substr(equals + 1));
+        double current = counts.value(name, -1.0);
+        bool failed = current != expected;
+        std::cout << (failed ? "FAIL " : "ok   ") << "count " << name << ": expected " << expected << " current " << current << std::endl;
+        if (failed) mismatches++;
+    }
+    return mismatches > 0 ? 1 : 0;
+}
+
+// Side by side timings of two runs of the same corpus, for trying a mode against the default
+// Not a gate, only a changed geometry count fails since both runs must build the same scene
+int versusStats(const json& base, const json& variant) {
+    auto row = [](const std::string& name, double baseSeconds, double variantSeconds) {
+        std::cout << name << ": " << baseSeconds << "s -> " << variantSeconds << "s";
+        if (variantSeconds > 0.0) std::cout << " (" << baseSeconds / variantSeconds << "x)";
+        std::cout << std::endl;
+    };
+    const json basePhases = base.value("phases", json::object());
+    const json variantPhases = variant.value("phases", json::object());
+    for (const auto& [phase, seconds] : basePhases.items()) {
+        row("phase " + phase, seconds.get<double>(), variantPhases.value(phase, 0.0));
+    }
+    row("totalSeconds", base.value("totalSeconds", 0.0), variant.value("totalSeconds", 0.0));
+
+    int mismatches = 0;
+    const json baseCounts = base.value("counts", json::object());
+    const json variantCounts = variant.value("counts", json::object());
+    for (const auto& [count, value] : baseCounts.items()) {
+        if (variantCounts.value(count, 0.0) != value.get<double>()) {
+            std::cout << "FAIL count " << count << ": " << value.get<double>() << " vs " << variantCounts.value(count, 0.0) << std::endl;
+            mismatches++;
+        }
+    }
+    return mismatches > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::strcmp(argv[1], "generate") == 0) {
+        return generateCorpus(argv[2]) ? 0 : 1;
+    }
+    if (argc == 3 && std::strcmp(argv[1], "subtrees") == 0) {
+        return generateSubtreeCorpus(argv[2]) ? 0 : 1;
+    }
+    if (argc >= 4 && std::strcmp(argv[1], "expect") == 0) {
+        json stats;
+        if (!readJson(argv[2], stats)) return 1;
+        return expectCounts(stats, argc - 3, argv + 3);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "compare") == 0) {
+        json baseline, stats;
+        if (!readJson(argv[2], baseline) || !readJson(argv[3], stats)) return 1;
+        return compareStats(baseline, stats);
+    }
+    if (argc == 4 && std::strcmp(argv[1], "baseline") == 0) {
+        // Keep the committed tolerances, replace the measured metrics
+        json stats, baseline;
+        if (!readJson(argv[2], stats)) return 1;
+        readJson(argv[3], baseline);
+        if (!baseline.is_object()) baseline = json::object();
+        baseline["metrics"] = stats;
+        std::ofstream file(argv[3]);
+        file << baseline.dump(2) << std::endl;
+        std::cout << "Recorded baseline: " << argv[3] << std::endl;
+        return file ? 0 : 1;
+    }
+    if (argc == 4 && std::strcmp(argv[1], "versus") == 0) {
+        json base, variant;
+        if (!readJson(argv[2], base) || !readJson(argv[3], variant)) return 1;
+        return versusStats(base, variant);
+    }
+    std::cerr << "Usage: vmaxperf generate <out.vmax>" << std::endl;
+    std::cerr << "       vmaxperf subtrees <out.vmax>" << std::endl;
+    std::cerr << "       vmaxperf expect <stats.json> <count>=<value>..." << std::endl;
+    std::cerr << "       vmaxperf compare <baseline.json> <stats.json>" << std::endl;
+    std::cerr << "       vmaxperf baseline <stats.json> <baseline.json>" << std::endl;
+    std::cerr << "       vmaxperf versus <default.json> <variant.json>" << std::endl;
+    return 2;
+}
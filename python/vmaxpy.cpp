@@ -0,0 +1,386 @@
+// vmaxpy.cpp - Python module over the vmax decode library
+//
+// Lets asset validation scripts read contentsN.vmaxb files without parsing them in Python.
+// A decoded model hands out its voxel buckets, block occupancy masks and palette as NumPy
+// arrays through the buffer protocol, every array is a view into the decoded model and keeps
+// it alive, nothing is copied. load() releases the GIL while it reads and decodes so a
+// ThreadPoolExecutor decodes many files at once.
+//
+//   import vmaxpy, numpy as np
+//   model = vmaxpy.load("bear.vmax/contents1.vmaxb", palette="bear.vmax/palette1.png")
+//   for material, color in model.buckets():
+//       xyz = model.bucket(material, color)       # (n, 3) uint8, model space
+//   occupied = model.occupancy                     # (512, 4096) uint8, one bit per voxel
+//   bits = np.unpackbits(occupied[block], bitorder="little").reshape(32, 32, 32)  # [z][y][x]
+//   rgba = model.palette                           # (256, 4) uint8, bucket color c is rgba[c - 1]
+//
+// occupancy has a row per 32^3 block of model space. Row i is the block at model space
+// origin 32 * (bx, by, bz) where i interleaves the bits of bx, by and bz (x lowest), and
+// bit x + 32 * y + 1024 * z of the row is the voxel at block origin + (x, y, z).
+// Without NumPy the same views come back as memoryviews.
+//
+// Build with make python, the module lands next to vmax2bella
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <array>        // For std::array
+#include <string>       // For std::string
+#include <vector>       // For dynamic arrays (vectors)
+#include <cstddef>      // For offsetof
+#include <cstdint>      // For fixed-size integer types (uint8_t, uint32_t, etc.)
+#include <fstream>      // For reading the files
+#include <filesystem>   // For the model name
+#include <stdexcept>    // For std::runtime_error
+
+#define OGT_VOX_IMPLEMENTATION
+#include "../../opengametools/src/ogt_vox.h"
+
+#include "../oomer_vmax_convert.h" // For decodeVmaxModel
+
+const size_t kBlockCount = 8 * 8 * 8;               // 32^3 blocks of a 256^3 model
+const size_t kBlockMaskBytes = 32 * 32 * 32 / 8;    // one bit per voxel of a block
+
+// Everything load() produces, filled without the GIL
+struct VmaxPyDecoded {
+    VmaxModel model;
+    std::vector<uint8_t> occupancy;     // kBlockCount * kBlockMaskBytes
+    std::vector<VmaxRGBA> palette;      // empty without a palette file
+    std::array<VmaxMaterial, 8> materials{};
+    bool hasMaterials = false;
+    uint64_t voxelCount = 0;
+
+    explicit VmaxPyDecoded(const std::string& name) : model(name) {}
+};
+
+std::vector<uint8_t> readVmaxPyFile(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) throw std::runtime_error("Failed to open: " + fileName);
+    std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    if (!file) throw std::runtime_error("Failed to read: " + fileName);
+    return bytes;
+}
+
+inline uint32_t spreadBlockBits(uint32_t n) { // 3 bit coordinate into every 3rd bit
+    return (n & 1u) | ((n & 2u) << 2) | ((n & 4u) << 4);
+}
+
+// Per 32^3 block occupancy masks and voxel count of the decoded model
+void fillVmaxPyOccupancy(VmaxPyDecoded& decoded) {
+    decoded.voxelCount = 0;
+    decoded.occupancy.assign(kBlockCount * kBlockMaskBytes, 0);
+    for (int material = 0; material < 8; material++) {
+        for (int color = 1; color < 256; color++) {
+            for (const VmaxVoxel& voxel : decoded.model.voxels[material][color]) {
+                uint32_t block = spreadBlockBits(voxel.x >> 5) | (spreadBlockBits(voxel.y >> 5) << 1) | (spreadBlockBits(voxel.z >> 5) << 2);
+                uint32_t bit = (voxel.x & 31u) + 32u * (voxel.y & 31u) + 1024u * (voxel.z & 31u);
+                decoded.occupancy[block * kBlockMaskBytes + bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+            }
+            decoded.voxelCount += decoded.model.voxels[material][color].size();
+        }
+    }
+}
+
+void decodeVmaxPy(VmaxPyDecoded& decoded, const std::string& contentsName, const std::string& paletteName, const std::string& materialsName) {
+    {
+        std::vector<uint8_t> bytes = readVmaxPyFile(contentsName);
+        decodeVmaxModel(bytes.data(), bytes.size(), decoded.model);
+    }
+    fillVmaxPyOccupancy(decoded);
+    if (!paletteName.empty()) {
+        std::vector<uint8_t> bytes = readVmaxPyFile(paletteName);
+        decoded.palette = read256x1PaletteFromMemory(bytes.data(), bytes.size());
+        if (decoded.palette.empty()) throw std::runtime_error("Failed to read palette from: " + paletteName);
+        decoded.palette.resize(256, VmaxRGBA{0, 0, 0, 0});
+    }
+    if (!materialsName.empty()) {
+        std::vector<uint8_t> bytes = readVmaxPyFile(materialsName);
+        plist_t plist_material = readPlistFromMemory(bytes.data(), bytes.size(), false); // decompress=false
+        if (!plist_material) throw std::runtime_error("Failed to read materials from: " + materialsName);
+        decoded.materials = getVmaxMaterials(plist_material);
+        decoded.hasMaterials = true;
+        plist_free(plist_material);
+    }
+}
+
+//==============================================================================
+// BUFFER
+//==============================================================================
+
+// A read only strided view into a model, exported through the buffer protocol
+struct VmaxPyBuffer {
+    PyObject_HEAD
+    PyObject* owner;        // the Model the memory belongs to
+    char* data;
+    const char* format;
+    Py_ssize_t itemSize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+int vmaxPyBufferGet(PyObject* self, Py_buffer* view, int flags) {
+    VmaxPyBuffer* buffer = reinterpret_cast<VmaxPyBuffer*>(self);
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "vmaxpy views are read only");
+        return -1;
+    }
+    bool contiguous = buffer->strides[buffer->ndim - 1] == buffer->itemSize &&
+                      (buffer->ndim == 1 || buffer->strides[0] == buffer->shape[1] * buffer->itemSize);
+    if (!contiguous && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+        PyErr_SetString(PyExc_BufferError, "vmaxpy bucket views are strided");
+        return -1;
+    }
+    view->buf = buffer->data;
+    view->obj = self;
+    Py_INCREF(self);
+    view->len = buffer->itemSize;
+    for (int axis = 0; axis < buffer->ndim; axis++) view->len *= buffer->shape[axis];
+    view->readonly = 1;
+    view->itemsize = buffer->itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(buffer->format) : nullptr;
+    view->ndim = buffer->ndim;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? buffer->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? buffer->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+void vmaxPyBufferDealloc(PyObject* self) {
+    Py_XDECREF(reinterpret_cast<VmaxPyBuffer*>(self)->owner);
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyBufferProcs s_vmaxPyBufferProcs = {vmaxPyBufferGet, nullptr};
+
+PyTypeObject s_vmaxPyBufferType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+PyObject* s_numpyAsarray = nullptr; // numpy.asarray, nullptr when numpy isn't installed
+
+// Wrap memory owned by owner, as a NumPy array when NumPy is there, a memoryview otherwise
+PyObject* vmaxPyView(PyObject* owner, const void* data, const char* format, Py_ssize_t itemSize,
+                     int ndim, const Py_ssize_t* shape, const Py_ssize_t* strides) {
+    static char empty = 0; // buffers may not point at nullptr
+    VmaxPyBuffer* buffer = PyObject_New(VmaxPyBuffer, &s_vmaxPyBufferType);
+    if (!buffer) return nullptr;
+    Py_INCREF(owner);
+    buffer->owner = owner;
+    buffer->data = data ? static_cast<char*>(const_cast<void*>(data)) : &empty;
+    buffer->format = format;
+    buffer->itemSize = itemSize;
+    buffer->ndim = ndim;
+    for (int axis = 0; axis < ndim; axis++) {
+        buffer->shape[axis] = shape[axis];
+        buffer->strides[axis] = strides[axis];
+    }
+    PyObject* view = s_numpyAsarray ? PyObject_CallOneArg(s_numpyAsarray, reinterpret_cast<PyObject*>(buffer))
+                                    : PyMemoryView_FromObject(reinterpret_cast<PyObject*>(buffer));
+    Py_DECREF(buffer);
+    return view;
+}
+
+//==============================================================================
+// MODEL
+//==============================================================================
+
+struct VmaxPyModel {
+    PyObject_HEAD
+    VmaxPyDecoded* decoded;
+};
+
+void vmaxPyModelDealloc(PyObject* self) {
+    delete reinterpret_cast<VmaxPyModel*>(self)->decoded;
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* vmaxPyModelBuckets(PyObject* self, PyObject*) {
+    const VmaxModel& model = reinterpret_cast<VmaxPyModel*>(self)->decoded->model;
+    PyObject* buckets = PyList_New(0);
+    if (!buckets) return nullptr;
+    for (const auto& [material, colorID] : model.getUsedMaterialsAndColors()) {
+        for (int color : colorID) {
+            PyObject* bucket = Py_BuildValue("(ii)", material, color);
+            if (!bucket || PyList_Append(buckets, bucket) < 0) {
+                Py_XDECREF(bucket);
+                Py_DECREF(buckets);
+                return nullptr;
+            }
+            Py_DECREF(bucket);
+        }
+    }
+    return buckets;
+}
+
+// xyz of every voxel of a bucket, strided over the VmaxVoxel array
+PyObject* vmaxPyModelBucket(PyObject* self, PyObject* args) {
+    int material = 0, color = 0;
+    if (!PyArg_ParseTuple(args, "ii", &material, &color)) return nullptr;
+    if (material < 0 || material > 7 || color < 1 || color > 255) {
+        PyErr_SetString(PyExc_ValueError, "material is 0-7 and color 1-255");
+        return nullptr;
+    }
+    const std::vector<VmaxVoxel>& voxels = reinterpret_cast<VmaxPyModel*>(self)->decoded->model.voxels[material][color];
+    static_assert(offsetof(VmaxVoxel, y) == offsetof(VmaxVoxel, x) + 1 && offsetof(VmaxVoxel, z) == offsetof(VmaxVoxel, x) + 2,
+                  "bucket views expect x, y, z next to each other");
+    const Py_ssize_t shape[2] = {static_cast<Py_ssize_t>(voxels.size()), 3};
+    const Py_ssize_t strides[2] = {sizeof(VmaxVoxel), 1};
+    return vmaxPyView(self, voxels.empty() ? nullptr : &voxels.front().x, "B", 1, 2, shape, strides);
+}
+
+PyObject* vmaxPyModelOccupancy(PyObject* self, void*) {
+    const std::vector<uint8_t>& occupancy = reinterpret_cast<VmaxPyModel*>(self)->decoded->occupancy;
+    const Py_ssize_t shape[2] = {static_cast<Py_ssize_t>(kBlockCount), static_cast<Py_ssize_t>(kBlockMaskBytes)};
+    const Py_ssize_t strides[2] = {static_cast<Py_ssize_t>(kBlockMaskBytes), 1};
+    return vmaxPyView(self, occupancy.data(), "B", 1, 2, shape, strides);
+}
+
+PyObject* vmaxPyModelPalette(PyObject* self, void*) {
+    const std::vector<VmaxRGBA>& palette = reinterpret_cast<VmaxPyModel*>(self)->decoded->palette;
+    if (palette.empty()) Py_RETURN_NONE;
+    static_assert(sizeof(VmaxRGBA) == 4, "palette views expect packed rgba");
+    const Py_ssize_t shape[2] = {static_cast<Py_ssize_t>(palette.size()), 4};
+    const Py_ssize_t strides[2] = {4, 1};
+    return vmaxPyView(self, palette.data(), "B", 1, 2, shape, strides);
+}
+
+PyObject* vmaxPyModelMaterials(PyObject* self, void*) {
+    const VmaxPyDecoded* decoded = reinterpret_cast<VmaxPyModel*>(self)->decoded;
+    if (!decoded->hasMaterials) Py_RETURN_NONE;
+    PyObject* materials = PyList_New(0);
+    if (!materials) return nullptr;
+    for (const VmaxMaterial& material : decoded->materials) {
+        PyObject* entry = Py_BuildValue("{s:s,s:d,s:d,s:d,s:d,s:O}",
+                                        "name", material.materialName.c_str(),
+                                        "transmission", material.transmission,
+                                        "roughness", material.roughness,
+                                        "metalness", material.metalness,
+                                        "emission", material.emission,
+                                        "shadows", material.enableShadows ? Py_True : Py_False);
+        if (!entry || PyList_Append(materials, entry) < 0) {
+            Py_XDECREF(entry);
+            Py_DECREF(materials);
+            return nullptr;
+        }
+        Py_DECREF(entry);
+    }
+    return materials;
+}
+
+PyObject* vmaxPyModelName(PyObject* self, void*) {
+    return PyUnicode_FromString(reinterpret_cast<VmaxPyModel*>(self)->decoded->model.vmaxbFileName.c_str());
+}
+
+PyObject* vmaxPyModelVoxelCount(PyObject* self, void*) {
+    return PyLong_FromUnsignedLongLong(reinterpret_cast<VmaxPyModel*>(self)->decoded->voxelCount);
+}
+
+PyMethodDef s_vmaxPyModelMethods[] = {
+    {"buckets", vmaxPyModelBuckets, METH_NOARGS, "used (material, color) pairs"},
+    {"bucket", vmaxPyModelBucket, METH_VARARGS, "bucket(material, color), (n, 3) uint8 model space xyz of its voxels"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef s_vmaxPyModelGetSet[] = {
+    {"name", vmaxPyModelName, nullptr, "contents file name", nullptr},
+    {"voxel_count", vmaxPyModelVoxelCount, nullptr, "voxels over all buckets", nullptr},
+    {"occupancy", vmaxPyModelOccupancy, nullptr, "(512, 4096) uint8, a bit per voxel of each 32^3 model space block", nullptr},
+    {"palette", vmaxPyModelPalette, nullptr, "(256, 4) uint8 rgba, None without a palette", nullptr},
+    {"materials", vmaxPyModelMaterials, nullptr, "8 material dicts, None without materials", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyTypeObject s_vmaxPyModelType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+//==============================================================================
+// MODULE
+//==============================================================================
+
+// load(contents, palette=None, materials=None), decoding runs without the GIL
+PyObject* vmaxPyLoad(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"contents", "palette", "materials", nullptr};
+    PyObject* contentsPath = nullptr;
+    PyObject* palettePath = nullptr;
+    PyObject* materialsPath = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|O&O&", const_cast<char**>(keywords),
+                                     PyUnicode_FSConverter, &contentsPath,
+                                     PyUnicode_FSConverter, &palettePath,
+                                     PyUnicode_FSConverter, &materialsPath)) {
+        return nullptr;
+    }
+    std::string contentsName = PyBytes_AsString(contentsPath);
+    std::string paletteName = palettePath ? PyBytes_AsString(palettePath) : "";
+    std::string materialsName = materialsPath ? PyBytes_AsString(materialsPath) : "";
+    Py_DECREF(contentsPath);
+    Py_XDECREF(palettePath);
+    Py_XDECREF(materialsPath);
+
+    std::string fileName = std::filesystem::path(contentsName).filename().string();
+    VmaxPyDecoded* decoded = new VmaxPyDecoded(fileName);
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        decodeVmaxPy(*decoded, contentsName, paletteName, materialsName);
+    } catch (std::exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        delete decoded;
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+    VmaxPyModel* model = PyObject_New(VmaxPyModel, &s_vmaxPyModelType);
+    if (!model) {
+        delete decoded;
+        return nullptr;
+    }
+    model->decoded = decoded;
+    return reinterpret_cast<PyObject*>(model);
+}
+
+PyMethodDef s_vmaxPyMethods[] = {
+    {"load", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)(void)>(vmaxPyLoad)), METH_VARARGS | METH_KEYWORDS,
+     "load(contents, palette=None, materials=None), decode a contentsN.vmaxb with its paletteN.png and paletteN.settings.vmaxpsb"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef s_vmaxPyModule = {PyModuleDef_HEAD_INIT, "vmaxpy", "Zero copy access to decoded VoxelMax models", -1, s_vmaxPyMethods};
+
+PyMODINIT_FUNC PyInit_vmaxpy(void) {
+    s_vmaxPyBufferType.tp_name = "vmaxpy.Buffer";
+    s_vmaxPyBufferType.tp_basicsize = sizeof(VmaxPyBuffer);
+    s_vmaxPyBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+    s_vmaxPyBufferType.tp_dealloc = vmaxPyBufferDealloc;
+    s_vmaxPyBufferType.tp_as_buffer = &s_vmaxPyBufferProcs;
+    s_vmaxPyBufferType.tp_doc = "read only view into a decoded model";
+    if (PyType_Ready(&s_vmaxPyBufferType) < 0) return nullptr;
+
+    s_vmaxPyModelType.tp_name = "vmaxpy.Model";
+    s_vmaxPyModelType.tp_basicsize = sizeof(VmaxPyModel);
+    s_vmaxPyModelType.tp_flags = Py_TPFLAGS_DEFAULT;
+    s_vmaxPyModelType.tp_dealloc = vmaxPyModelDealloc;
+    s_vmaxPyModelType.tp_methods = s_vmaxPyModelMethods;
+    s_vmaxPyModelType.tp_getset = s_vmaxPyModelGetSet;
+    s_vmaxPyModelType.tp_doc = "a decoded contentsN.vmaxb, see vmaxpy.load";
+    if (PyType_Ready(&s_vmaxPyModelType) < 0) return nullptr;
+
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    if (numpy) {
+        s_numpyAsarray = PyObject_GetAttrString(numpy, "asarray");
+        Py_DECREF(numpy);
+    }
+    PyErr_Clear(); // memoryviews without numpy
+
+    PyObject* module = PyModule_Create(&s_vmaxPyModule);
+    if (!module) return nullptr;
+    Py_INCREF(&s_vmaxPyModelType);
+    if (PyModule_AddObject(module, "Model", reinterpret_cast<PyObject*>(&s_vmaxPyModelType)) < 0) {
+        Py_DECREF(&s_vmaxPyModelType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -184,6 +184,9 @@ The 't' field in the snapshot's 's.id' dictionary indicates the type of snapshot
 #include <unistd.h> // For fork, exec
 #include <sys/wait.h> // For waitpid
 #endif
+#ifdef __APPLE__
+#include <mach-o/dyld.h> // For _NSGetExecutablePath
+#endif
 
 // oomer's helper utility code to make main cpp smaller
 #include "../oom/oom_bella_long.h"   
@@ -195,6 +198,35 @@ The 't' field in the snapshot's 's.id' dictionary indicates the type of snapshot
 #include "../oom/oom_bella_premade.h" // oomer's helper code for bella scenes
 #include "../oom/oom_bella_misc.h"    // oomer's hlper code for bella misc code
 
+#include "oomer_voxel_budget.h"          // resource budget planning
+#include "oomer_voxel_store.h"           // spill-to-disk store for decoded models
+#include "oomer_task_graph.h"            // largest first work stealing scheduler
+#include "oomer_voxel_brickmap.h"        // sparse brickmap export for real-time viewers
+#include "oomer_perf.h"                  // phase timings and geometry counts for --stats
+#include "oomer_batch_journal.h"         // resumable --batch runs
+#include "oomer_lzfse_blocks.h"          // block parallel lzfse decoding and --compact
+#include "oomer_scene_bvh.h"             // world space instance bounds for culling and density
+#include "oomer_instance_pack.h"         // parallel SIMD box instance transforms
+#include "oomer_subtree_instancing.h"    // duplicated groups emitted once and referenced
+#include "oomer_voxel_atlas.h"           // cross color greedy meshes with a baked color atlas
+#include "oomer_chunk_cache.h"           // chunk fingerprints and cached tiles for --incremental
+#include "oomer_voxel_filter.h"          // --materials, --colors, --crop and --objects selection
+#include "oomer_voxel_range.h"           // lazy voxel ranges decoding snapshots in place
+#include "oomer_gltf_export.h"           // glb preview target of --export
+#include "oomer_voxel_thumbnail.h"       // isometric thumbnail target of --export
+#include "oomer_voxel_occupancy.h"       // chunks, bricks and buckets holding voxels of a decoded model
+
+#include <cmath> // For std::floor
+#include <tuple> // For std::tie
+#include <sstream> // For parsing number lists
+#include <mutex> // For the model store shared by decode workers
+#include <memory> // For std::unique_ptr
+#include <functional> // For the mesh task adder shared by bucket and plan tasks
+#include <filesystem> // For std::filesystem::file_size
+
+#include <chrono> // For wall time budget
+#include <iomanip> // For the --calibrate table
+
 #define OGT_VOX_IMPLEMENTATION
 #include "../opengametools/src/ogt_vox.h"
 
@@ -202,6 +234,22 @@ The 't' field in the snapshot's 's.id' dictionary indicates the type of snapshot
 // GLOBAL VARIABLES AND FUNCTIONS
 //==============================================================================
 
+// Phase timings and output counts, written by --stats and checked by make perfcheck
+VmaxPerfStats s_perfStats;
+
+// Where --meshtype:atlas writes its color atlases, next to the .bsz being written
+std::filesystem::path s_textureDir;
+
+int convertVmaxPackage(dl::Args& args, dl::String vmaxDirName);
+int runVmaxBatch(dl::Args& args);
+int compactVmaxPackage(const std::string& vmaxDirName, const std::string& outDirName);
+int calibrateBellaCosts(dl::Args& args, const std::string& costTableName);
+void trimVmaxScene( dl::Args& args, 
+                    std::map<std::string, std::vector<oom::vmax::JsonModelInfo>>& modelVmaxbMap,
+                    const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups);
+dl::String bszNameForVmax(dl::String vmaxDirName);
+VmaxVoxelFilter parseVoxelFilter(dl::Args& args);
+
 // oomer helper functions from ../oom
 //dl::bella_sdk::Node oom::bella::defaultSceneVoxel(dl::bella_sdk::Scene& belScene);
 dl::bella_sdk::Node add_ogt_mesh_to_scene(  dl::String bellaName, 
@@ -209,30 +257,266 @@ dl::bella_sdk::Node add_ogt_mesh_to_scene(  dl::String bellaName,
                                             dl::bella_sdk::Scene& belScene, 
                                             dl::bella_sdk::Node& belWorld );
 
+// Buckets meshed ahead of emission on worker threads, keyed by (material, color)
+// Emission takes ownership of a mesh by nulling its slot, whatever is left gets destroyed
+using VmaxBucketMeshes = std::map<std::pair<int, int>, ogt_mesh*>;
+
 // Forward declaration
 dl::bella_sdk::Node addModelToScene(dl::Args& args, 
                                     dl::bella_sdk::Scene& belScene, 
                                     dl::bella_sdk::Node& belWorld, 
                                     const oom::vmax::Model& vmaxModel, 
                                     const std::vector<oom::vmax::RGBA>& vmaxPalette, 
-                                    const std::array<oom::vmax::Material, 8>& vmaxMaterial); 
+                                    const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                                    VmaxRepresentation representation,
+                                    VmaxBucketMeshes* premeshed = nullptr,
+                                    std::map<int, VmaxAtlasMesh>* atlasMeshes = nullptr,
+                                    const VmaxOccupancySummary* occupancy = nullptr); 
+
+// One instancer for every object of a content under the same parent group
+void addObjectInstancer(dl::bella_sdk::Scene& belScene,
+                        std::map<dl::String, dl::bella_sdk::Node>& belGroupNodes,
+                        const std::string& jsonParentId,
+                        const std::vector<const oom::vmax::JsonModelInfo*>& objects);
+
+// Everything decoded from one contentN.vmaxb and its palette and material files
+// Produced on a worker thread so it must not touch bella_sdk
+struct DecodedVmaxContent {
+    oom::vmax::Model model;
+    std::vector<oom::vmax::RGBA> palette;
+    std::array<oom::vmax::Material, 8> materials;
+    std::vector<VmaxStoredVoxel> storedVoxels; // addVoxel replay log, only filled for the model store
+    VmaxOccupancySummary occupancy;            // of the kept voxels in model space, stays while the store pages the model out
+    VmaxModelStats stats;
+
+    DecodedVmaxContent(const std::string& name) : model(name) {}
+};
+
+// One content on its way through the task graph
+// read -> decode -> bucket -> mesh run on workers, the main thread emits the bella nodes in scene order
+// With a budget every model's mesh tasks wait for planning, which needs all of them decoded
+struct VmaxContentJob {
+    std::string name;
+    oom::vmax::JsonModelInfo jsonModelInfo; // first object using this content, others are instances
+    plist_t plistModel = nullptr;           // read stage output, freed by the decode stage
+    uint64_t voxelEstimate = 0;             // sum of st.c over the snapshots, known after read
+    DecodedVmaxContent decoded;
+    size_t storeIndex = 0;                  // slot in the model store when --modelmemory is used
+    int numaNode = -1;                      // every task of this content runs on this node with --numa
+    unsigned int lzfseThreads = 1;          // block parallel decode threads of the read stage, a share of --threads
+    VmaxTaskGraph::TaskId decodeTask = 0;
+    VmaxTaskGraph::TaskId bucketTask = 0;
+    std::vector<VmaxTaskGraph::TaskId> meshTasks;
+    std::vector<VmaxTaskGraph::TaskId> exportTasks; // glb mesh and thumbnail splats, read meshes and model only
+    VmaxBucketMeshes meshes;
+    std::map<int, VmaxAtlasMesh> atlasMeshes; // per material with --meshtype:atlas
+
+    // --incremental, see oomer_chunk_cache.h
+    std::string cacheFile;                  // empty without --incremental
+    int tileSize = 32;                      // dirty tiles are tracked at the mesh tile size
+    VmaxContentCache cache;                 // previous conversion, loaded by the read stage
+    VmaxContentCache nextCache;             // this conversion, saved once the model is meshed
+    std::set<VmaxTileKey> dirtyTiles;       // filled by decode, only when cached tiles exist
+    size_t changedChunks = 0;
+    size_t reusedTiles = 0;
+    size_t meshedTiles = 0;
+    std::mutex cacheMutex;                  // stitch tasks of different buckets add tiles to nextCache
+    const VmaxVoxelFilter* filter = nullptr; // --materials, --colors, --crop, nullptr keeps every voxel
+
+    // Cached tiles were meshed from filtered voxels, they only match under the same filter
+    int32_t meshSettings(VmaxRepresentation representation) const {
+        return static_cast<int32_t>(representation) ^ static_cast<int32_t>((filter ? filter->signature() : 0u) << 8);
+    }
+
+    VmaxContentJob(const std::string& contentName, const oom::vmax::JsonModelInfo& info) 
+        : name(contentName), jsonModelInfo(info), decoded(contentName) {}
+    ~VmaxContentJob();
+};
+
+// Task costs are in voxel equivalents, only their ordering matters to the scheduler
+const double kReadCostPerByte = 1.0;        // lzfse and plist parsing of the compressed file
+const double kDecodeVoxelsPerByte = 4.0;    // guess used until the read stage has summed st.c
+const double kBucketCostPerVoxel = 0.25;    // stats and model store handoff
+
+double estimateReadCost(const std::string& fileName);
+void readVmaxContent(const std::string& vmaxDirName, VmaxContentJob& job);
+void decodeVmaxContent(VmaxContentJob& job, bool recordStoredVoxels);
+ogt_mesh* takeBucketMesh(VmaxBucketMeshes* premeshed, int material, int color);
+void destroyBucketMeshes(VmaxBucketMeshes& meshes);
+
+// A bucket holding most of a model (terrain, a base color) is split into tiles meshed in
+// parallel. Each tile sees a one voxel halo of its neighbours so seam faces are culled
+// exactly like in an untiled mesh, then the tile meshes are stitched back into one.
+const uint64_t kTiledMeshMinVoxels = 65536; // smaller buckets are meshed in one task
+const int kTiledMeshExtent = 256;           // vmax models are at most 256 voxels per axis
+struct VmaxTiledBucket {
+    int tileSize = 32;
+    int tilesPerAxis = kTiledMeshExtent / 32;
+    std::vector<uint64_t> occupancy;       // one bit per voxel of the 256^3 model space
+    std::vector<ogt_mesh*> tileMeshes;     // nullptr for tiles without voxels of the bucket
+
+    VmaxTiledBucket(int size) : tileSize(size), tilesPerAxis(kTiledMeshExtent / size), 
+                                tileMeshes(tilesPerAxis * tilesPerAxis * tilesPerAxis, nullptr) {}
+    ~VmaxTiledBucket();
+    bool occupied(int x, int y, int z) const {
+        if (x < 0 || y < 0 || z < 0 || x >= kTiledMeshExtent || y >= kTiledMeshExtent || z >= kTiledMeshExtent) return false;
+        size_t bit = static_cast<size_t>(x) + static_cast<size_t>(y) * kTiledMeshExtent + static_cast<size_t>(z) * kTiledMeshExtent * kTiledMeshExtent;
+        return (occupancy[bit >> 6] >> (bit & 63)) & 1;
+    }
+};
+void fillTiledBucket(VmaxTiledBucket& tiled, const std::vector<oom::vmax::Voxel>& voxelsOfType);
+bool bucketInTile(const VmaxOccupancySummary& occupancy, int material, int color, int tileSize, size_t tileIndex);
+ogt_mesh* meshBucketTile(const VmaxTiledBucket& tiled, size_t tileIndex, bool greedy);
+ogt_mesh* stitchTileMeshes(std::vector<ogt_mesh*>& tileMeshes);
+std::vector<uint8_t> serializeTileMesh(const ogt_mesh* mesh);
+ogt_mesh* deserializeTileMesh(const std::vector<uint8_t>& bytes);
+
+// Quick material settings for one (material, color) bucket
+// Kept separate from the node so buckets of different models can share a material
+struct VmaxBellaMaterial {
+    std::string type;
+    double roughness = 0.0;      // bella 0-100
+    double transmission = 0.0;
+    double emitterEnergy = 0.0;
+    double color[4] = {0.0, 0.0, 0.0, 1.0}; // linear rgba
+    bool bevel = false;
+
+    bool operator<(const VmaxBellaMaterial& other) const {
+        return std::tie(type, roughness, transmission, emitterEnergy, color[0], color[1], color[2], color[3], bevel) <
+               std::tie(other.type, other.roughness, other.transmission, other.emitterEnergy, 
+                        other.color[0], other.color[1], other.color[2], other.color[3], other.bevel);
+    }
+};
+
+VmaxBellaMaterial describeBellaMaterial(int material, 
+                                        int color, 
+                                        const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                                        const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                                        bool bevel);
+dl::bella_sdk::Node createBellaMaterial(dl::bella_sdk::Scene& belScene, 
+                                        dl::String name, 
+                                        const VmaxBellaMaterial& materialDesc);
+
+// --meshtype:atlas, the opaque colors of a material share one greedy mesh textured by an atlas
+// Glass, translucent colors and liquid keep their per color buckets and materials
+bool atlasRepresentation(dl::Args& args, VmaxRepresentation representation);
+bool isAtlasBucket(int material, int color, const std::vector<oom::vmax::RGBA>& vmaxPalette);
+VmaxAtlasMesh meshAtlasMaterial(const oom::vmax::Model& vmaxModel, 
+                                const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                                int material);
+dl::bella_sdk::Node add_atlas_mesh_to_scene(dl::String name, 
+                                            const VmaxAtlasMesh& atlasMesh, 
+                                            dl::bella_sdk::Scene& belScene);
+
+// Mesh one (material, color) bucket, the caller frees the mesh with ogt_mesh_destroy
+ogt_mesh* meshVoxelBucket(  const std::vector<oom::vmax::Voxel>& voxelsOfType, 
+                            const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                            int material, 
+                            VmaxRepresentation representation);
+
+// Small single instance models are baked into world space and concatenated per material
+struct BellaMeshBatch {
+    dl::ds::Vector<dl::Pos3f> points;
+    dl::ds::Vector<dl::Vec4u> faces;
+};
+struct BellaMeshBatcher {
+    uint64_t maxTriangles = 0;   // flush a batch once it holds this many triangles
+    int meshCount = 0;           // combined meshes written so far, used for unique names
+    std::map<VmaxBellaMaterial, BellaMeshBatch> batches;
+};
+oom::vmax::Matrix4x4 objectWorldMatrix( const oom::vmax::JsonModelInfo& jsonModelInfo, 
+                                        const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups);
+void batchModel(BellaMeshBatcher& batcher,
+                dl::bella_sdk::Scene& belScene, 
+                dl::bella_sdk::Node& belWorld, 
+                const oom::vmax::Model& vmaxModel, 
+                const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                VmaxRepresentation representation,
+                const oom::vmax::Matrix4x4& worldMat4,
+                bool bevel,
+                VmaxBucketMeshes* premeshed = nullptr);
+void flushMeshBatch(BellaMeshBatcher& batcher,
+                    dl::bella_sdk::Scene& belScene, 
+                    dl::bella_sdk::Node& belWorld, 
+                    const VmaxBellaMaterial& materialDesc,
+                    BellaMeshBatch& batch);
+
+// Budget helpers
+VmaxModelStats vmaxModelStats(const oom::vmax::Model& vmaxModel);
+bool isVoxelHidden( const oom::vmax::Model& vmaxModel, 
+                    const oom::vmax::Voxel& voxel, 
+                    const std::vector<oom::vmax::RGBA>& vmaxPalette,
+                    const VmaxOccupancySummary* occupancy);
+std::vector<oom::vmax::Voxel> downsampleVoxels(const std::vector<oom::vmax::Voxel>& voxels, int factor);
+
+// --export fan-out, one decode and meshing pass feeds the bsz, glb and thumbnail targets
+// The glb mesh and thumbnail splats of a model are built by tasks reading its premeshed
+// buckets and decoded voxels, before the bella emission takes the meshes
+VmaxGltfMesh gltfMeshForModel(  dl::Args& args,
+                                const oom::vmax::Model& vmaxModel, 
+                                const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                                const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                                VmaxRepresentation representation,
+                                const VmaxBucketMeshes* premeshed,
+                                const std::map<int, VmaxAtlasMesh>* atlasMeshes);
+void addExportNodes(VmaxGltfScene& exportScene,
+                    const std::map<std::string, std::vector<oom::vmax::JsonModelInfo>>& modelVmaxbMap,
+                    const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups,
+                    const VmaxSubtreeInstancing& subtreeInstancing,
+                    const std::map<std::string, int>& meshIndices);
+
+// Command line options, registered by DL_main and forwarded to the --batch workers
+struct VmaxOption { const char* shortName; const char* longName; const char* defaultValue; const char* help; };
+const VmaxOption kVmaxOptions[] = {
+    {"i", "input", "", "vmax directory or vmax.zip file"},
+    {"mo", "mode", "", "mode for output, mesh, voxel, both or auto (cheapest of boxes and meshes per model)"},
+    {"mt", "meshtype", "", "meshtype classic, greedy, atlas (greedy across colors, colors baked into a texture)"},
+    {"be", "bevel", "", "add bevel to material"},
+    {"tp",  "thirdparty",   "",   "prints third party licenses"},
+    {"li",  "licenseinfo",   "",   "prints license info"},
+    {"bi",  "budgetinstances", "", "budget: maximum instancer instances in the scene"},
+    {"bt",  "budgettriangles", "", "budget: maximum mesh triangles in the scene"},
+    {"bm",  "budgetmemory",    "", "budget: maximum scene memory in MB"},
+    {"bw",  "budgettime",      "", "budget: maximum wall time in seconds"},
+    {"th",  "threads",         "", "number of worker threads, defaults to one per core"},
+    {"bs",  "batchsmall",      "", "bake single instance meshes under this many triangles into one mesh per material"},
+    {"st",  "stats",           "", "write phase timings, peak memory and geometry counts to a json file"},
+    {"mm",  "modelmemory",     "", "keep at most this many MB of decoded models in memory, spill the rest to disk"},
+    {"ts",  "tilesize",        "", "mesh large color buckets as 32 or 64 voxel tiles in parallel, 0 disables, default 32"},
+    {"ba",  "batch",           "", "convert every .vmax listed in this file, one per line, resuming from its journal"},
+    {"jo",  "journal",         "", "batch journal file, defaults to the batch file with .journal appended"},
+    {"bk",  "brickmap",        "", "also write every model as a sparse brickmap .vxbm into this directory"},
+    {"cp",  "compact",         "", "copy the input to this .vmax with every lzfse file rewritten as independently decodable blocks"},
+    {"cb",  "cullbox",         "", "drop objects outside this world box: minx,miny,minz,maxx,maxy,maxz"},
+    {"cf",  "cullfrustum",     "", "drop objects outside this camera: eyex,eyey,eyez,targetx,targety,targetz,fov,aspect,near,far"},
+    {"dd",  "dedupe",          "", "drop objects placed exactly on top of an identical object"},
+    {"de",  "density",         "", "print instance bounds and density of the scene"},
+    {"nu",  "numa",            "", "pin workers per NUMA node and keep each model's decode and meshing on one node"},
+    {"in",  "instancers",      "", "collapse objects of one model under the same group into one instancer, at least this many, default 2"},
+    {"ic",  "incremental",     "", "cache chunk fingerprints, voxels and mesh tiles in this directory, default next to the .bsz, redo only changed chunks"},
+    {"su",  "subtrees",        "", "emit duplicated groups once and reference the copy from one xform per duplicate"},
+    {"ma",  "materials",       "", "only convert voxels of these material slots (layers): 0,3,7"},
+    {"co",  "colors",          "", "only convert voxels of these palette colors: 1,12,200"},
+    {"cr",  "crop",            "", "only convert voxels inside this model voxel box: minx,miny,minz,maxx,maxy,maxz"},
+    {"ex",  "export",          "", "targets written from one decode and meshing pass: bsz,glb,thumb, default bsz"},
+    {"ob",  "objects",         "", "only convert these objects, ids or names of objects or of groups holding them: tree,house"},
+    {"ca",  "calibrate",       "", "measure Bella emission and write costs on synthetic models and write them to this cost table json"},
+    {"cc",  "costs",           "", "cost table json written by --calibrate, used by --mode:auto and the budget"},
+};
 
 //==============================================================================
 // MAIN FUNCTION
 //==============================================================================
 
 int DL_main(dl::Args& args) {
-
     int s_oomBellaLogContext = 0; 
     dl::subscribeLog(&s_oomBellaLogContext, oom::bella::log);
     dl::flushStartupMessages();
 
-    args.add("i", "input", "", "vmax directory or vmax.zip file");
-    args.add("mo", "mode", "", "mode for output, mesh, voxel, or both");
-    args.add("mt", "meshtype", "", "meshtype classic, greedy, other");
-    args.add("be", "bevel", "", "add bevel to material");
-    args.add("tp",  "thirdparty",   "",   "prints third party licenses");
-    args.add("li",  "licenseinfo",   "",   "prints license info");
+    for (const VmaxOption& option : kVmaxOptions) {
+        args.add(option.shortName, option.longName, option.defaultValue, option.help);
+    }
 
     if (args.helpRequested()) {
         std::cout << args.help("vmax2bella © 2025 Harvey Fong","vmax2bella", "1.0") << std::endl;
@@ -254,240 +538,1131 @@ int DL_main(dl::Args& args) {
         return 0;
     }
 
+    if (args.have("--calibrate")) {
+        return calibrateBellaCosts(args, args.value("--calibrate").buf());
+    }
+
+    if (args.have("--batch")) {
+        return runVmaxBatch(args);
+    }
+
+    if (args.have("--input") && args.have("--compact")) {
+        return compactVmaxPackage(args.value("--input").buf(), args.value("--compact").buf());
+    }
+
     if (args.have("--input"))
     {
-        dl::String bszName;
-        dl::String objName;
-        dl::String vmaxDirName;
-        vmaxDirName = args.value("--input");
-        bszName = vmaxDirName.replace("vmax", "bsz");
-        objName = vmaxDirName.replace("vmax", "obj");
-
-        // Create a new scene
-        dl::bella_sdk::Scene belScene;
-        belScene.loadDefs();
+        return convertVmaxPackage(args, args.value("--input"));
+    }
+    return 0;
+}
 
-        auto [  belWorld,
-                belMeshVoxel,
-                belLiqVoxel,
-                belVoxel,
-                belEmitterBlockXform ] = oom::bella::defaultSceneVoxel(belScene);
+// Convert one .vmax package into a .bsz next to it
+// Runs in its own worker process per project in batch mode
+int convertVmaxPackage(dl::Args& args, dl::String vmaxDirName) {
+    auto startTime = std::chrono::steady_clock::now();
+    s_perfStats = VmaxPerfStats();
+    dl::String bszName = bszNameForVmax(vmaxDirName);
+    dl::String objName = vmaxDirName.replace("vmax", "obj");
+    s_textureDir = std::filesystem::absolute(std::filesystem::path(bszName.buf()).replace_extension());
+    s_textureDir += "_textures";
+
+    // --export:bsz,glb,thumb, every target is written from the same decoded and meshed models
+    std::set<std::string> exportTargets = {"bsz"};
+    if (args.have("--export")) {
+        exportTargets.clear();
+        std::stringstream items(args.value("--export").buf());
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (item != "bsz" && item != "glb" && item != "thumb") throw std::runtime_error("--export targets are bsz, glb and thumb, not " + item);
+            exportTargets.insert(item);
+        }
+        if (exportTargets.empty()) throw std::runtime_error("--export needs at least one of bsz, glb and thumb");
+    }
+    bool exportBsz = exportTargets.count("bsz") > 0;
+    bool exportGlb = exportTargets.count("glb") > 0;
+    bool exportThumb = exportTargets.count("thumb") > 0;
+
+    // Create a new scene
+    dl::bella_sdk::Scene belScene;
+    belScene.loadDefs();
+
+    auto [  belWorld,
+            belMeshVoxel,
+            belLiqVoxel,
+            belVoxel,
+            belEmitterBlockXform ] = oom::bella::defaultSceneVoxel(belScene);
+
+
+    //auto belWorld = belScene.world(true);
+
+    // scene.json is the toplevel file that hierarchically defines the scene
+    // it contains nestable groups (containers) and objects (instances) that point to resources that define the object
+    // objects properties
+    //  - transformation matrix
+    // objects resources
+    /// - reference a contentsN.vmaxb (lzfse compressed plist file) that contains a 256x256x256 voxel "model"
+    //  - reference to a paletteN.png that defines the 256 24bit colors used in the 256x256x256 model
+    //  - reference to a paletteN.settings.vmaxpsb (plist file) that defines the 8 materials used in the "model"
+    // In scenegraph parlance a group is a xform, a object is a transform with a child geometry 
+    // multiple objects can point to the same model creating what is known as an instance
+    oom::vmax::JsonSceneParser vmaxSceneParser;
+    vmaxSceneParser.parseScene((vmaxDirName+"/scene.json").buf());
+
+    #ifdef _DEBUG
+        vmaxSceneParser.printSummary();
+    #endif
+    std::map<std::string, oom::vmax::JsonGroupInfo> jsonGroups = vmaxSceneParser.getGroups();
+    std::map<dl::String, dl::bella_sdk::Node> belGroupNodes; // Map of UUID to bella node
+    std::map<dl::String, dl::bella_sdk::Node> belCanonicalNodes; // Map of UUID to bella node
+
+    // Efficiently process unique models by examining only the first instance of each model type.
+    // Example: If we have 100 instances of 3 different models:
+    //   "model1.vmaxb": [instance1, instance2, ..., instance50],
+    //   "model2.vmaxb": [instance1, ..., instance30],
+    //   "model3.vmaxb": [instance1, ..., instance20]
+    // This loop runs only 3 times (once per unique model), not 100 times (once per instance)
+    
+    auto modelVmaxbMap = vmaxSceneParser.getModelContentVMaxbMap(); 
+    if (args.have("--objects")) { // first, objects not asked for are never read
+        std::set<std::string> keepObjects;
+        std::stringstream items(args.value("--objects").buf());
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (!item.empty()) keepObjects.insert(item);
+        }
+        size_t droppedObjects = filterVmaxObjects(modelVmaxbMap, jsonGroups, keepObjects);
+        std::cout << "objects: kept " << modelVmaxbMap.size() << " contents, dropped " << droppedObjects << " objects" << std::endl;
+    }
+    if (args.have("--cullbox") || args.have("--cullfrustum") || args.have("--dedupe") || args.have("--density")) {
+        trimVmaxScene(args, modelVmaxbMap, jsonGroups); // before decode, dropped contents are never read
+    }
+
+    // Duplicated groups are matched after trimming, a copy with culled objects is no longer a copy
+    VmaxSubtreeInstancing subtreeInstancing;
+    if (args.have("--subtrees")) {
+        subtreeInstancing = findInstancedSubtrees(jsonGroups, modelVmaxbMap);
+        removeInstancedObjects(modelVmaxbMap, subtreeInstancing);
+        s_perfStats.prototypes = subtreeInstancing.prototypes.size();
+        s_perfStats.groupCopies = subtreeInstancing.copyOf.size();
+        std::cout << "instanced " << subtreeInstancing.copyOf.size() << " group copies of " 
+                  << subtreeInstancing.prototypes.size() << " prototypes, dropping " 
+                  << subtreeInstancing.droppedGroups.size() << " groups and " 
+                  << subtreeInstancing.droppedObjects.size() << " objects" << std::endl;
+    }
+
+    // First pass to create all the Bella nodes for the groups
+    for (const auto& [groupName, groupInfo] : jsonGroups) { 
+        if (subtreeInstancing.droppedGroups.count(groupName)) continue; // inside a copy, the prototype stands in
+        dl::String belGroupUUID = dl::String(groupName.c_str());
+        belGroupUUID = belGroupUUID.replace("-", "_"); // Make sure the group name is valid for a Bella node name
+        belGroupUUID = "_" + belGroupUUID; // Make sure the group name is valid for a Bella node name
+        belGroupNodes[belGroupUUID] = belScene.createNode("xform", belGroupUUID, belGroupUUID); // Create a Bella node for the group
+
+
+        oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(groupInfo.rotation[0], 
+                                          groupInfo.rotation[1], 
+                                          groupInfo.rotation[2], 
+                                          groupInfo.rotation[3],
+                                          groupInfo.position[0], 
+                                          groupInfo.position[1], 
+                                          groupInfo.position[2], 
+                                          groupInfo.scale[0], 
+                                          groupInfo.scale[1], 
+                                          groupInfo.scale[2]);
+
+        belGroupNodes[belGroupUUID]["steps"][0]["xform"] = dl::Mat4({
+            objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
+            objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
+            objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
+            objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
+            });
+    }
+
+    // json file is allowed the parent to be defined after the child, requiring us to create all the bella nodes before we can parent them
+    for (const auto& [groupName, groupInfo] : jsonGroups) { 
+        if (subtreeInstancing.droppedGroups.count(groupName)) continue;
+        dl::String belGroupUUID = dl::String(groupName.c_str());
+        belGroupUUID = belGroupUUID.replace("-", "_");
+        belGroupUUID = "_" + belGroupUUID;
+        if (groupInfo.parentId == "") {
+            belGroupNodes[belGroupUUID].parentTo(belWorld); // Group without a parent is a child of the world
+        } else {
+            dl::String belPPPGroupUUID = dl::String(groupInfo.parentId.c_str());
+            belPPPGroupUUID = belPPPGroupUUID.replace("-", "_");
+            belPPPGroupUUID = "_" + belPPPGroupUUID;
+            dl::bella_sdk::Node myParentGroup = belGroupNodes[belPPPGroupUUID]; // Get bella obj
+            belGroupNodes[belGroupUUID].parentTo(myParentGroup); // Group underneath a group
+        }
+    }
+
+    // A prototype's children hang off an identity xform below it, every copy parents that
+    // same xform under its own group xform. Children look their parent up in belGroupNodes
+    // so the prototype's entry is pointed at the shared xform
+    std::map<std::string, dl::bella_sdk::Node> belPrototypeNodes;
+    for (const std::string& prototypeName : subtreeInstancing.prototypes) {
+        dl::String belGroupUUID = "_" + dl::String(prototypeName.c_str()).replace("-", "_");
+        auto belPrototype = belScene.createNode("xform", belGroupUUID + dl::String("Prototype"), belGroupUUID + dl::String("Prototype"));
+        belPrototype["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
+        belPrototype.parentTo(belGroupNodes[belGroupUUID]);
+        belGroupNodes[belGroupUUID] = belPrototype;
+        belPrototypeNodes[prototypeName] = belPrototype;
+    }
+    for (const auto& [copyName, prototypeName] : subtreeInstancing.copyOf) {
+        dl::String belGroupUUID = "_" + dl::String(copyName.c_str()).replace("-", "_");
+        belPrototypeNodes[prototypeName].parentTo(belGroupNodes[belGroupUUID]);
+    }
+
+    s_perfStats.lap("scene");
+    std::vector<VmaxModelStats> modelStats; // one per model, also used for budget planning
+
+    // Scenes larger than RAM keep a compact replay log per model and spill it to disk under pressure
+    bool useModelStore = args.have("--modelmemory");
+    uint64_t modelMemoryLimit = useModelStore ? std::stoull(args.value("--modelmemory").buf()) * 1024 * 1024 : 0;
+    VmaxModelStore modelStore((bszName + ".vmaxstore").buf(), modelMemoryLimit);
+    std::vector<std::vector<oom::vmax::RGBA>> vmaxPalettes; // one palette per model
+    std::vector<std::array<oom::vmax::Material, 8>> vmaxMaterials; // one material per model
+
+    oom::bella::defaultScene2025(belScene); // create the basic scene elements in Bella
+    
+    // Loop over each model defined in scene.json and process the first instance 
+    // This will be out canonical models, not instances
+    // todo rename model to objects as per vmax
+    // Every content is a read -> decode -> bucket -> mesh chain in a task graph, the largest
+    // files start first so one huge content doesn't become the tail of the conversion
+    // Results are collected in map order so scene assembly stays deterministic
+    unsigned int threadCount = args.have("--threads") ? std::stoul(args.value("--threads").buf()) : 0;
+    std::string vmaxDir = vmaxDirName.buf();
+    int tileSize = args.have("--tilesize") ? std::stoi(args.value("--tilesize").buf()) : 32;
+    if (tileSize != 0 && tileSize != 32 && tileSize != 64) {
+        std::cout << "tilesize must be 0, 32 or 64, using 32" << std::endl;
+        tileSize = 32;
+    }
+    VmaxVoxelFilter voxelFilter = parseVoxelFilter(args);
+    std::filesystem::path cacheDir;
+    if (args.have("--incremental")) {
+        dl::String cacheValue = args.value("--incremental");
+        cacheDir = cacheValue.isEmpty() ? std::filesystem::path((bszName + ".chunkcache").buf()) : std::filesystem::path(cacheValue.buf());
+        std::filesystem::create_directories(cacheDir);
+    }
+    // Reads run on graph workers, so their lzfse decode threads split --threads between the
+    // contents instead of every read starting one per core
+    unsigned int workerCount = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+    unsigned int lzfseThreads = std::max<unsigned int>(1, workerCount / std::max<size_t>(1, modelVmaxbMap.size()));
+    std::vector<std::unique_ptr<VmaxContentJob>> contentJobs;
+    std::vector<double> readCosts;
+    for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) {
+        contentJobs.push_back(std::make_unique<VmaxContentJob>(vmaxContentName, vmaxModelList.front()));
+        contentJobs.back()->lzfseThreads = lzfseThreads;
+        readCosts.push_back(estimateReadCost(vmaxDir + "/" + vmaxModelList.front().dataFile));
+        if (voxelFilter.active()) contentJobs.back()->filter = &voxelFilter;
+        if (!cacheDir.empty()) {
+            contentJobs.back()->cacheFile = (cacheDir / (vmaxContentName + ".vxcc")).string();
+            contentJobs.back()->tileSize = tileSize;
+        }
+    }
+
+    // With --numa each content is placed on one node for its whole life, decode allocates
+    // its model from a worker pinned there and meshing reads it from the same node
+    VmaxNumaTopology numaTopology;
+    const VmaxNumaTopology* numa = nullptr;
+    if (args.have("--numa")) {
+        numaTopology = VmaxNumaTopology::detect();
+        numa = &numaTopology;
+        std::vector<int> contentNodes = assignNumaNodes(readCosts, numaTopology.nodeCount());
+        for (size_t i = 0; i < contentJobs.size(); i++) {
+            contentJobs[i]->numaNode = contentNodes[i];
+        }
+        std::cout << "numa: " << numaTopology.nodeCount() << " node(s)" << std::endl;
+    }
+
+    // Pick a representation per model, degrading the most expensive models when over budget
+    // Only a budget needs every model's stats, otherwise each model is meshed as soon as it's bucketed
+    VmaxBudget budget;
+    if (args.have("--budgetinstances")) budget.maxInstances = std::stoull(args.value("--budgetinstances").buf());
+    if (args.have("--budgettriangles")) budget.maxTriangles = std::stoull(args.value("--budgettriangles").buf());
+    if (args.have("--budgetmemory")) budget.maxMemoryBytes = std::stoull(args.value("--budgetmemory").buf()) * 1024 * 1024;
+    if (args.have("--budgettime")) budget.maxSeconds = std::stod(args.value("--budgettime").buf());
+
+    VmaxCostTable costs;
+    if (args.have("--costs")) costs = loadCostTable(args.value("--costs").buf());
+
+    VmaxRepresentation preferredRepresentation = VmaxRepresentation::Box;
+    if (args.have("--mode") && (args.value("--mode") == "mesh" || args.value("--mode") == "both")) {
+        preferredRepresentation = VmaxRepresentation::Mesh;
+        if (args.have("--meshtype") && (args.value("--meshtype") == "greedy" || args.value("--meshtype") == "atlas")) {
+            preferredRepresentation = VmaxRepresentation::GreedyMesh;
+        }
+    }
+    bool autoMode = args.have("--mode") && args.value("--mode") == "auto";
+    std::vector<VmaxRepresentation> modelRepresentations(contentJobs.size(), preferredRepresentation);
+
+    VmaxGltfScene exportScene;                                     // --export glb, one mesh per model
+    std::vector<std::vector<VmaxThumbnailSplat>> thumbnailSplats; // --export thumb, per model
+    exportScene.meshes.resize(exportGlb ? contentJobs.size() : 0);
+    thumbnailSplats.resize(exportThumb ? contentJobs.size() : 0);
+
+    // The bucket task adds the mesh tasks of its content once the buckets are known, so meshing
+    // of decoded models doesn't wait for the slowest decode. A single color bucket can dominate
+    // a scene so the biggest buckets start first while the main thread emits finished models
+    // in order. Stored models are paged in one at a time below and mesh inline instead
+    // Declared ahead of the graph so an early return joins the workers before it goes away
+    std::function<void(size_t)> addMeshTasks;
+    std::mutex modelStoreMutex;
+    // Out of wall time, mesh whatever is left as cheaply as possible rather than time out
+    // Decided before a model is meshed so nothing gets meshed twice
+    auto applyWallTime = [&](size_t modelIndex) {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (budget.maxSeconds > 0.0 && elapsed > budget.maxSeconds && 
+            modelRepresentations[modelIndex] != VmaxRepresentation::Lod4Mesh) {
+            std::cout << "budget: wall time " << elapsed << "s exceeded, " << contentJobs[modelIndex]->name << " "
+                      << representationName(modelRepresentations[modelIndex]) << " -> "
+                      << representationName(VmaxRepresentation::Lod4Mesh) << std::endl;
+            modelRepresentations[modelIndex] = VmaxRepresentation::Lod4Mesh;
+        }
+    };
+    VmaxTaskGraph taskGraph;
+    addMeshTasks = [&](size_t modelIndex) {
+        VmaxContentJob& job = *contentJobs[modelIndex];
+        const oom::vmax::Model& eachModel = job.decoded.model;
+        const std::vector<oom::vmax::RGBA>& vmaxPalette = job.decoded.palette;
+        applyWallTime(modelIndex);
+        VmaxRepresentation representation = modelRepresentations[modelIndex];
+        bool atlas = atlasRepresentation(args, representation);
+        for (const auto& [material, colorID] : eachModel.getUsedMaterialsAndColors()) {
+            if (material != 7 && !representationIsMesh(representation)) continue; // liquid is always a mesh
+            if (atlas) { // one task meshes every atlas color of the material together
+                double atlasCost = 0.0;
+                for (int color : colorID) {
+                    if (isAtlasBucket(material, color, vmaxPalette)) atlasCost += eachModel.getVoxels(material, color).size();
+                }
+                if (atlasCost > 0.0) {
+                    VmaxAtlasMesh& atlasSlot = job.atlasMeshes[material];
+                    job.meshTasks.push_back(taskGraph.add(job.name + " atlas", atlasCost, 
+                                                          [&atlasSlot, &eachModel, &vmaxPalette, material]() {
+                        atlasSlot = meshAtlasMaterial(eachModel, vmaxPalette, material);
+                    }, job.numaNode));
+                }
+            }
+            for (int color : colorID) {
+                const std::vector<oom::vmax::Voxel>& voxelsOfType = eachModel.getVoxels(material, color);
+                if (voxelsOfType.empty()) continue;
+                if (atlas && isAtlasBucket(material, color, vmaxPalette)) continue;
+                ogt_mesh*& meshSlot = job.meshes[{material, color}]; // map nodes are stable, one writer each
+                meshSlot = nullptr;
+                if (tileSize == 0 || voxelsOfType.size() < kTiledMeshMinVoxels || representationLodFactor(representation) > 1) {
+                    job.meshTasks.push_back(taskGraph.add(job.name + " mesh", static_cast<double>(voxelsOfType.size()), 
+                                                          [&meshSlot, &voxelsOfType, &vmaxPalette, material, representation]() {
+                        meshSlot = meshVoxelBucket(voxelsOfType, vmaxPalette, material, representation);
+                    }, job.numaNode));
+                    continue;
+                }
+
+                // occupancy -> one task per tile -> stitch, the tiled bucket lives until the last of them finishes
+                bool greedy = representation != VmaxRepresentation::Mesh && material != 7;
+                auto tiled = std::make_shared<VmaxTiledBucket>(tileSize);
+                VmaxTaskGraph::TaskId occupancyTask = taskGraph.add(job.name + " occupancy", static_cast<double>(voxelsOfType.size()), 
+                                                                    [tiled, &voxelsOfType]() {
+                    fillTiledBucket(*tiled, voxelsOfType);
+                }, job.numaNode);
+                std::vector<VmaxTaskGraph::TaskId> tileTasks;
+                double tileCost = static_cast<double>(tileSize) * tileSize * tileSize;
+                // With --incremental, tiles no changed chunk touched are spliced back in from the cache
+                bool cachedTilesUsable = !job.cacheFile.empty() && job.cache.tileSize == static_cast<uint32_t>(tileSize) && 
+                                         job.cache.meshSettings == job.meshSettings(representation);
+                for (size_t tileIndex = 0; tileIndex < tiled->tileMeshes.size(); tileIndex++) {
+                    if (!bucketInTile(job.decoded.occupancy, material, color, tileSize, tileIndex)) continue; // no task for empty tiles
+                    const std::vector<uint8_t>* cachedTile = nullptr;
+                    VmaxTileKey tileKey{material, color, static_cast<uint32_t>(tileIndex)};
+                    if (cachedTilesUsable && !job.dirtyTiles.count(tileKey)) {
+                        auto found = job.cache.tiles.find(tileKey);
+                        if (found != job.cache.tiles.end()) cachedTile = &found->second;
+                    }
+                    (cachedTile ? job.reusedTiles : job.meshedTiles)++;
+                    tileTasks.push_back(taskGraph.add(job.name + " tile", cachedTile ? tileCost * 0.01 : tileCost, [tiled, tileIndex, greedy, cachedTile]() {
+                        if (cachedTile) {
+                            tiled->tileMeshes[tileIndex] = deserializeTileMesh(*cachedTile);
+                        } else {
+                            tiled->tileMeshes[tileIndex] = meshBucketTile(*tiled, tileIndex, greedy);
+                        }
+                    }, job.numaNode));
+                    taskGraph.depend(occupancyTask, tileTasks.back());
+                }
+                VmaxTaskGraph::TaskId stitchTask = taskGraph.add(job.name + " stitch", voxelsOfType.size() * 0.1, [tiled, &meshSlot, &job, material, color]() {
+                    if (!job.cacheFile.empty()) { // keep this bucket's tiles for the next conversion
+                        std::vector<std::pair<VmaxTileKey, std::vector<uint8_t>>> tiles;
+                        for (size_t tileIndex = 0; tileIndex < tiled->tileMeshes.size(); tileIndex++) {
+                            if (!tiled->tileMeshes[tileIndex]) continue;
+                            tiles.emplace_back(VmaxTileKey{material, color, static_cast<uint32_t>(tileIndex)}, serializeTileMesh(tiled->tileMeshes[tileIndex]));
+                        }
+                        std::lock_guard<std::mutex> lock(job.cacheMutex);
+                        for (auto& tile : tiles) job.nextCache.tiles[tile.first] = std::move(tile.second);
+                    }
+                    meshSlot = stitchTileMeshes(tiled->tileMeshes);
+                }, job.numaNode);
+                for (VmaxTaskGraph::TaskId tileTask : tileTasks) {
+                    taskGraph.depend(tileTask, stitchTask);
+                }
+                job.meshTasks.push_back(stitchTask);
+            }
+        }
+
+        // The other targets read the finished buckets alongside meshing of later models
+        if (exportGlb) {
+            const std::array<oom::vmax::Material, 8>& vmaxMaterial = job.decoded.materials;
+            VmaxGltfMesh& gltfSlot = exportScene.meshes[modelIndex];
+            job.exportTasks.push_back(taskGraph.add(job.name + " glb", job.decoded.stats.voxelCount * 0.1, 
+                                                    [&args, &gltfSlot, &eachModel, &vmaxPalette, &vmaxMaterial, &job, representation]() {
+                gltfSlot = gltfMeshForModel(args, eachModel, vmaxPalette, vmaxMaterial, representation, &job.meshes, &job.atlasMeshes);
+            }, job.numaNode));
+            for (VmaxTaskGraph::TaskId meshTask : job.meshTasks) {
+                taskGraph.depend(meshTask, job.exportTasks.back());
+            }
+        }
+        if (exportThumb) {
+            std::vector<VmaxThumbnailSplat>& splatSlot = thumbnailSplats[modelIndex];
+            job.exportTasks.push_back(taskGraph.add(job.name + " thumb", job.decoded.stats.voxelCount * 0.1, 
+                                                    [&splatSlot, &eachModel, &vmaxPalette]() {
+                splatSlot = buildThumbnailSplats(eachModel, vmaxPalette);
+            }, job.numaNode));
+        }
+    };
+    for (size_t contentIndex = 0; contentIndex < contentJobs.size(); contentIndex++) {
+        VmaxContentJob* job = contentJobs[contentIndex].get();
+        const std::string& vmaxContentName = job->name;
+        double readCost = readCosts[contentIndex];
+
+        VmaxTaskGraph::TaskId readTask = taskGraph.add(vmaxContentName + " read", readCost, [&taskGraph, vmaxDir, job]() {
+            readVmaxContent(vmaxDir, *job);
+            taskGraph.setCost(job->bucketTask, job->voxelEstimate * kBucketCostPerVoxel);
+            taskGraph.setCost(job->decodeTask, static_cast<double>(job->voxelEstimate));
+        }, job->numaNode);
+        job->decodeTask = taskGraph.add(vmaxContentName + " decode", readCost * kDecodeVoxelsPerByte, [job, useModelStore]() {
+            decodeVmaxContent(*job, useModelStore);
+        }, job->numaNode);
+        job->bucketTask = taskGraph.add(vmaxContentName + " bucket", readCost * kDecodeVoxelsPerByte * kBucketCostPerVoxel, 
+                                        [&, job, contentIndex]() {
+            job->decoded.stats = vmaxModelStats(job->decoded.model);
+            if (useModelStore) {
+                // Hand the replay log to the store right away so spilling bounds memory
+                std::lock_guard<std::mutex> lock(modelStoreMutex);
+                job->storeIndex = modelStore.add(job->name, std::move(job->decoded.storedVoxels));
+                job->decoded.model = oom::vmax::Model(job->name);
+            }
+            if (budget.enabled()) return; // the plan task meshes it once every model is known
+            if (autoMode) modelRepresentations[contentIndex] = cheapestRepresentation(job->decoded.stats, costs);
+            if (!useModelStore) addMeshTasks(contentIndex);
+        }, job->numaNode);
+        taskGraph.depend(readTask, job->decodeTask);
+        taskGraph.depend(job->decodeTask, job->bucketTask);
+    }
+    VmaxTaskGraph::TaskId planTask = 0;
+    if (budget.enabled()) {
+        planTask = taskGraph.add("plan", 1.0, [&]() {
+            std::vector<VmaxModelStats> plannedStats;
+            for (auto& job : contentJobs) {
+                plannedStats.push_back(job->decoded.stats);
+            }
+            if (autoMode) {
+                for (size_t modelIndex = 0; modelIndex < plannedStats.size(); modelIndex++) {
+                    modelRepresentations[modelIndex] = cheapestRepresentation(plannedStats[modelIndex], costs);
+                }
+            }
+            // Reading and decoding already spent part of the wall time, plan the meshing for what is left
+            VmaxBudget remaining = budget;
+            if (budget.maxSeconds > 0.0) {
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                remaining.maxSeconds = std::max(budget.maxSeconds - elapsed, 0.001);
+            }
+            modelRepresentations = planBudget(remaining, plannedStats, modelRepresentations, costs);
+            if (useModelStore) return;
+            for (size_t modelIndex = 0; modelIndex < contentJobs.size(); modelIndex++) {
+                addMeshTasks(modelIndex);
+            }
+        });
+        for (auto& job : contentJobs) {
+            taskGraph.depend(job->bucketTask, planTask);
+        }
+    }
+    taskGraph.start(threadCount, numa);
+
+    for (auto& job : contentJobs) {
+        taskGraph.wait(job->bucketTask); // rethrows read and decode errors
+        std::cout << "vmaxContentName: " << job->name << std::endl;
+
+        modelStats.push_back(job->decoded.stats);
+        vmaxPalettes.push_back(job->decoded.palette); // gather all models palettes, mesh tasks still read the job's
+        vmaxMaterials.push_back(job->decoded.materials);
+    }
+    s_perfStats.lap("decode");
+
+    if (budget.enabled()) taskGraph.wait(planTask);
+    if (autoMode) {
+        for (size_t modelIndex = 0; modelIndex < modelStats.size(); modelIndex++) {
+            std::cout << "auto: " << modelStats[modelIndex].name << " " << representationName(modelRepresentations[modelIndex]) << std::endl;
+        }
+    }
+    for (const auto& eachStats : modelStats) {
+        s_perfStats.voxels += eachStats.voxelCount;
+    }
+    s_perfStats.lap("plan");
+
+    // Tiny props instanced once cost a node and a bvh each, bake them into shared meshes instead
+    BellaMeshBatcher meshBatcher;
+    if (args.have("--batchsmall")) meshBatcher.maxTriangles = std::stoull(args.value("--batchsmall").buf());
+    std::set<std::string> batchedContents; // these get no canonical node and no instance xform
+
+    if (useModelStore) {
+        std::cout << "model store: " << modelStore.getResidentBytes() / (1024 * 1024) << "MB resident, "
+                  << modelStore.getSpilledBytes() / (1024 * 1024) << "MB spilled" << std::endl;
+    }
+
+    // Need to access voxles by material and color groupings
+    // Models are canonical models, not instances
+    // Vmax objects are instances of models
+
+    // First create canonical models and they are NOT attached to belWorld
+    for (size_t modelIndex = 0; modelIndex < modelStats.size(); modelIndex++) {
+        // Page a stored model back in by replaying its addVoxel calls, only one is alive at a time
+        oom::vmax::Model pagedModel(modelStats[modelIndex].name);
+        if (useModelStore) {
+            size_t storeIndex = contentJobs[modelIndex]->storeIndex;
+            for (const VmaxStoredVoxel& stored : modelStore.get(storeIndex)) {
+                pagedModel.addVoxel(stored.x, stored.y, stored.z, stored.material, stored.palette, stored.chunk, stored.chunkMin);
+            }
+            modelStore.release(storeIndex);
+            applyWallTime(modelIndex); // meshed inline below, nothing was premeshed
+        }
+        const oom::vmax::Model& eachModel = useModelStore ? pagedModel : contentJobs[modelIndex]->decoded.model;
+        VmaxContentJob& job = *contentJobs[modelIndex];
+        if (args.have("--brickmap")) {
+            std::filesystem::path brickmapPath = std::filesystem::path(args.value("--brickmap").buf()) / eachModel.vmaxbFileName;
+            std::filesystem::create_directories(brickmapPath.parent_path());
+            brickmapPath.replace_extension(".vxbm");
+            if (!writeVmaxBrickmap(buildVmaxBrickmap(eachModel, vmaxPalettes[modelIndex], job.decoded.occupancy), brickmapPath.string())) {
+                std::cerr << "Failed to write brickmap: " << brickmapPath.string() << std::endl;
+                return 1;
+            }
+        }
+        for (VmaxTaskGraph::TaskId meshTask : job.meshTasks) {
+            taskGraph.wait(meshTask); // rethrows meshing errors
+        }
+        for (VmaxTaskGraph::TaskId exportTask : job.exportTasks) {
+            taskGraph.wait(exportTask); // done reading job.meshes, bella may take them now
+        }
+        if (useModelStore) { // paged in just now, nothing was premeshed
+            if (exportGlb) {
+                exportScene.meshes[modelIndex] = gltfMeshForModel(args, eachModel, vmaxPalettes[modelIndex], vmaxMaterials[modelIndex],
+                                                                  modelRepresentations[modelIndex], nullptr, nullptr);
+            }
+            if (exportThumb) thumbnailSplats[modelIndex] = buildThumbnailSplats(eachModel, vmaxPalettes[modelIndex]);
+        }
+        if (!job.cacheFile.empty()) {
+            job.nextCache.tileSize = static_cast<uint32_t>(tileSize);
+            job.nextCache.meshSettings = job.meshSettings(modelRepresentations[modelIndex]);
+            saveVmaxContentCache(job.cacheFile, job.nextCache);
+            std::cout << "incremental: " << job.name << " " << job.changedChunks << "/" << job.nextCache.chunks.size() 
+                      << " chunks changed, " << job.reusedTiles << "/" << (job.reusedTiles + job.meshedTiles) << " tiles reused" << std::endl;
+            job.cache = VmaxContentCache();
+            job.nextCache = VmaxContentCache();
+        }
+        if (!exportBsz) { // nothing left to emit for this model
+            destroyBucketMeshes(job.meshes);
+            job.atlasMeshes.clear();
+            continue;
+        }
+
+        const auto& vmaxObjects = modelVmaxbMap.at(eachModel.vmaxbFileName);
+        // An object inside a prototype is shown by every copy, baking it once into world space would lose them
+        if (meshBatcher.maxTriangles > 0 && vmaxObjects.size() == 1 && 
+            !insidePrototype(vmaxObjects.front(), jsonGroups, subtreeInstancing) &&
+            representationIsMesh(modelRepresentations[modelIndex]) &&
+            estimateModelCost(modelStats[modelIndex], modelRepresentations[modelIndex], costs).triangles <= meshBatcher.maxTriangles) {
+            batchModel( meshBatcher,
+                        belScene,
+                        belWorld,
+                        eachModel,
+                        vmaxPalettes[modelIndex],
+                        vmaxMaterials[modelIndex],
+                        modelRepresentations[modelIndex],
+                        objectWorldMatrix(vmaxObjects.front(), jsonGroups),
+                        args.have("bevel"),
+                        &job.meshes);
+            batchedContents.insert(eachModel.vmaxbFileName);
+            continue;
+        }
+        //if (modelIndex == 0) { // only process the first model
+        std::cout << modelIndex << " Model: " << eachModel.vmaxbFileName << std::endl;
+        //std::cout << "Voxel Count Model: " << eachModel.getTotalVoxelCount() << std::endl;
+
+        dl::bella_sdk::Node belModel = addModelToScene( args,
+                                                        belScene, 
+                                                        belWorld, 
+                                                        eachModel, 
+                                                        vmaxPalettes[modelIndex], 
+                                                        vmaxMaterials[modelIndex],
+                                                        modelRepresentations[modelIndex],
+                                                        &job.meshes,
+                                                        &job.atlasMeshes,
+                                                        &job.decoded.occupancy);
+        destroyBucketMeshes(job.meshes);
+        job.atlasMeshes.clear();
+        // TODO add to a map00000 of canonical models
+        dl::String lllmodelName = dl::String(eachModel.vmaxbFileName.c_str());
+        dl::String lllcanonicalName = lllmodelName.replace(".vmaxb", "");
+        belCanonicalNodes[lllcanonicalName.buf()] = belModel;
+    }
+
+    taskGraph.finish();
+
+    if (exportGlb || exportThumb) {
+        std::map<std::string, int> meshIndices; // contents in model order
+        for (size_t modelIndex = 0; modelIndex < contentJobs.size(); modelIndex++) {
+            meshIndices[contentJobs[modelIndex]->name] = static_cast<int>(modelIndex);
+            if (exportGlb) exportScene.meshes[modelIndex].name = contentJobs[modelIndex]->name;
+        }
+        addExportNodes(exportScene, modelVmaxbMap, jsonGroups, subtreeInstancing, meshIndices);
+        std::filesystem::path exportPath(bszName.buf());
+        if (exportGlb) {
+            writeGltfBinary(exportScene, exportPath.replace_extension(".glb").string());
+            std::cout << "export: wrote " << exportPath.string() << std::endl;
+        }
+        if (exportThumb) {
+            writeThumbnail(exportScene, thumbnailSplats, exportPath.replace_extension(".png").string());
+            std::cout << "export: wrote " << exportPath.string() << std::endl;
+        }
+        s_perfStats.lap("export");
+    }
+    if (!exportBsz) {
+        if (args.have("--stats")) {
+            s_perfStats.writeJson(args.value("--stats").buf());
+        }
+        return 0;
+    }
+
+    for (auto& [materialDesc, batch] : meshBatcher.batches) {
+        flushMeshBatch(meshBatcher, belScene, belWorld, materialDesc, batch);
+    }
+    if (!batchedContents.empty()) {
+        std::cout << "batched " << batchedContents.size() << " small models into " 
+                  << meshBatcher.meshCount << " meshes" << std::endl;
+    }
 
+    s_perfStats.lap("canonical");
 
-        //auto belWorld = belScene.world(true);
-
-        // scene.json is the toplevel file that hierarchically defines the scene
-        // it contains nestable groups (containers) and objects (instances) that point to resources that define the object
-        // objects properties
-        //  - transformation matrix
-        // objects resources
-        /// - reference a contentsN.vmaxb (lzfse compressed plist file) that contains a 256x256x256 voxel "model"
-        //  - reference to a paletteN.png that defines the 256 24bit colors used in the 256x256x256 model
-        //  - reference to a paletteN.settings.vmaxpsb (plist file) that defines the 8 materials used in the "model"
-        // In scenegraph parlance a group is a xform, a object is a transform with a child geometry 
-        // multiple objects can point to the same model creating what is known as an instance
-        oom::vmax::JsonSceneParser vmaxSceneParser;
-        vmaxSceneParser.parseScene((vmaxDirName+"/scene.json").buf());
-
-        #ifdef _DEBUG
-            vmaxSceneParser.printSummary();
-        #endif
-        std::map<std::string, oom::vmax::JsonGroupInfo> jsonGroups = vmaxSceneParser.getGroups();
-        std::map<dl::String, dl::bella_sdk::Node> belGroupNodes; // Map of UUID to bella node
-        std::map<dl::String, dl::bella_sdk::Node> belCanonicalNodes; // Map of UUID to bella node
-
-        // First pass to create all the Bella nodes for the groups
-        for (const auto& [groupName, groupInfo] : jsonGroups) { 
-            dl::String belGroupUUID = dl::String(groupName.c_str());
-            belGroupUUID = belGroupUUID.replace("-", "_"); // Make sure the group name is valid for a Bella node name
-            belGroupUUID = "_" + belGroupUUID; // Make sure the group name is valid for a Bella node name
-            belGroupNodes[belGroupUUID] = belScene.createNode("xform", belGroupUUID, belGroupUUID); // Create a Bella node for the group
-
-
-            oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(groupInfo.rotation[0], 
-                                              groupInfo.rotation[1], 
-                                              groupInfo.rotation[2], 
-                                              groupInfo.rotation[3],
-                                              groupInfo.position[0], 
-                                              groupInfo.position[1], 
-                                              groupInfo.position[2], 
-                                              groupInfo.scale[0], 
-                                              groupInfo.scale[1], 
-                                              groupInfo.scale[2]);
-
-            belGroupNodes[belGroupUUID]["steps"][0]["xform"] = dl::Mat4({
+    // Second Loop through each vmax object and create an instance of the canonical model
+    // This is the instances of the models, we did a pass to create the canonical models earlier
+    // With --instancers the objects of a model sharing a parent group become one instancer node
+    // holding their object matrices, instead of one xform node each
+    size_t collapseMinimum = 0; // 0 keeps one xform per object
+    if (args.have("--instancers")) {
+        dl::String collapseValue = args.value("--instancers");
+        collapseMinimum = collapseValue.isEmpty() ? 2 : std::max<size_t>(2, std::stoul(collapseValue.buf()));
+    }
+    size_t collapsedObjects = 0;
+    size_t collapsedInstancers = 0;
+    for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
+        //std::cout << "model: " << vmaxContentName << std::endl;
+        if (batchedContents.count(vmaxContentName)) continue; // already baked into world space
+        oom::vmax::Model currentVmaxModel(vmaxContentName);
+        std::set<std::string> collapsedParents;
+        if (collapseMinimum > 0 && vmaxModelList.size() >= collapseMinimum) {
+            std::map<std::string, std::vector<const oom::vmax::JsonModelInfo*>> objectsByParent;
+            for (const auto& jsonModelInfo : vmaxModelList) {
+                objectsByParent[jsonModelInfo.parentId].push_back(&jsonModelInfo);
+            }
+            for (const auto& [jsonParentId, parentObjects] : objectsByParent) {
+                if (parentObjects.size() < collapseMinimum) continue;
+                collapsedParents.insert(jsonParentId);
+                addObjectInstancer(belScene, belGroupNodes, jsonParentId, parentObjects);
+                collapsedObjects += parentObjects.size();
+                collapsedInstancers++;
+            }
+        }
+        for(const auto& jsonModelInfo : vmaxModelList) {
+            if (collapsedParents.count(jsonModelInfo.parentId)) continue; // placed by an instancer
+            std::vector<double> position = jsonModelInfo.position;
+            std::vector<double> rotation = jsonModelInfo.rotation;
+            std::vector<double> scale = jsonModelInfo.scale;
+            std::vector<double> extentCenter = jsonModelInfo.extentCenter;
+            auto jsonParentId = jsonModelInfo.parentId;
+            auto belParentId = dl::String(jsonParentId.c_str());
+            dl::String belParentGroupUUID = belParentId.replace("-", "_"); // Make sure the group name is valid for a Bella node name
+            belParentGroupUUID = "_" + belParentGroupUUID; // Make sure the group name is valid for a Bella node name
+
+            auto belObjectId = dl::String(jsonModelInfo.id.c_str());
+            belObjectId = belObjectId.replace("-", "_"); // Make sure the object name is valid for a Bella node name
+            belObjectId = "_" + belObjectId; // Make sure the object name is valid for a Bella node name
+
+            dl::String getCanonicalName = dl::String(jsonModelInfo.dataFile.c_str());
+            dl::String canonicalName = getCanonicalName.replace(".vmaxb", "");
+            //get bel node from canonical name
+            auto belCanonicalNode = belCanonicalNodes[canonicalName.buf()];
+            auto foofoo = belScene.findNode(canonicalName);
+
+            oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(rotation[0], 
+                                                             rotation[1], 
+                                                             rotation[2], 
+                                                             rotation[3],
+                                                             position[0], 
+                                                             position[1], 
+                                                             position[2], 
+                                                             scale[0], 
+                                                             scale[1], 
+                                                             scale[2]);
+
+            auto belNodeObjectInstance = belScene.createNode("xform", belObjectId, belObjectId);
+            s_perfStats.xforms++;
+            belNodeObjectInstance["steps"][0]["xform"] = dl::Mat4({
                 objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
                 objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
                 objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
                 objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
                 });
-        }
 
-        // json file is allowed the parent to be defined after the child, requiring us to create all the bella nodes before we can parent them
-        for (const auto& [groupName, groupInfo] : jsonGroups) { 
-            dl::String belGroupUUID = dl::String(groupName.c_str());
-            belGroupUUID = belGroupUUID.replace("-", "_");
-            belGroupUUID = "_" + belGroupUUID;
-            if (groupInfo.parentId == "") {
-                belGroupNodes[belGroupUUID].parentTo(belWorld); // Group without a parent is a child of the world
+            if (jsonParentId == "") {
+                belNodeObjectInstance.parentTo(belScene.world());
             } else {
-                dl::String belPPPGroupUUID = dl::String(groupInfo.parentId.c_str());
-                belPPPGroupUUID = belPPPGroupUUID.replace("-", "_");
-                belPPPGroupUUID = "_" + belPPPGroupUUID;
-                dl::bella_sdk::Node myParentGroup = belGroupNodes[belPPPGroupUUID]; // Get bella obj
-                belGroupNodes[belGroupUUID].parentTo(myParentGroup); // Group underneath a group
-            }
-        }
-
-        // Efficiently process unique models by examining only the first instance of each model type.
-        // Example: If we have 100 instances of 3 different models:
-        //   "model1.vmaxb": [instance1, instance2, ..., instance50],
-        //   "model2.vmaxb": [instance1, ..., instance30],
-        //   "model3.vmaxb": [instance1, ..., instance20]
-        // This loop runs only 3 times (once per unique model), not 100 times (once per instance)
-        
-        auto modelVmaxbMap = vmaxSceneParser.getModelContentVMaxbMap(); 
-        std::vector<oom::vmax::Model> allModels;
-        std::vector<std::vector<oom::vmax::RGBA>> vmaxPalettes; // one palette per model
-        std::vector<std::array<oom::vmax::Material, 8>> vmaxMaterials; // one material per model
-
-        oom::bella::defaultScene2025(belScene); // create the basic scene elements in Bella
-        
-        // Loop over each model defined in scene.json and process the first instance 
-        // This will be out canonical models, not instances
-        // todo rename model to objects as per vmax
-        for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
-            std::cout << "vmaxContentName: " << vmaxContentName << std::endl;
-            oom::vmax::Model currentVmaxModel(vmaxContentName);
-            const auto& jsonModelInfo = vmaxModelList.front(); // get the first model, others are instances at the scene level
-            std::vector<double> position = jsonModelInfo.position;
-            std::vector<double> rotation = jsonModelInfo.rotation;
-            std::vector<double> scale = jsonModelInfo.scale;
-            std::vector<double> extentCenter = jsonModelInfo.extentCenter;
+                dl::bella_sdk::Node myParentGroup = belGroupNodes[belParentGroupUUID]; // Get bella obj
+                belNodeObjectInstance.parentTo(myParentGroup); // Group underneath a group
+            }
+            foofoo.parentTo(belNodeObjectInstance);
+        }
+    }
 
-            // Get file names
-            dl::String materialName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
-            materialName = materialName.replace(".png", ".settings.vmaxpsb");
-
-            // Get this models colors from the paletteN.png 
-            dl::String pngName = vmaxDirName + "/" + jsonModelInfo.paletteFile.c_str();
-            vmaxPalettes.push_back(oom::vmax::read256x1PaletteFromPNG(pngName.buf())); // gather all models palettes
-            //allPalettes.push_back(read256x1PaletteFromPNG(pngName.buf())); // gather all models palettes
-            if (vmaxPalettes.empty()) { throw std::runtime_error("Failed to read palette from: png " ); }
-
-            // Read contentsN.vmaxb plist file, lzfse compressed
-            dl::String modelFileName = vmaxDirName + "/" + jsonModelInfo.dataFile.c_str();
-            plist_t plist_model_root = oom::vmax::readPlist(modelFileName.buf(), true); // decompress=true
-
-            plist_t plist_snapshots_array = plist_dict_get_item(plist_model_root, "snapshots");
-            uint32_t snapshots_array_size = plist_array_get_size(plist_snapshots_array);
-
-            // Create a VmaxModel object
-            //VmaxModel currentVmaxModel(vmaxContentName);
-            for (uint32_t i = 0; i < snapshots_array_size; i++) {
-                plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
-                plist_t plist_chunk = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "id", "c"});
-                plist_t plist_datastream = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "ds"});
-                uint64_t chunkID;
-                plist_get_uint_val(plist_chunk, &chunkID);
-                oom::vmax::ChunkInfo chunkInfo = oom::vmax::vmaxChunkInfo(plist_snapshot);
-                std::vector<oom::vmax::Voxel> xvoxels = oom::vmax::vmaxVoxelInfo(plist_datastream, chunkInfo.id, chunkInfo.mortoncode);
-
-                for (const auto& voxel : xvoxels) {
-                    currentVmaxModel.addVoxel(voxel.x, voxel.y, voxel.z, voxel.material, voxel.palette ,chunkInfo.id, chunkInfo.mortoncode);
-                }
+    if (collapseMinimum > 0) {
+        std::cout << "collapsed " << collapsedObjects << " objects into " << collapsedInstancers << " instancers" << std::endl;
+    }
+    s_perfStats.lap("instances");
+
+    // Write Bella File .bsz=compressed .bsa=ascii .bsx=binary
+    belScene.write(bszName.buf());
+    s_perfStats.lap("write");
+    if (args.have("--stats")) {
+        s_perfStats.writeJson(args.value("--stats").buf());
+    }
+    return 0;
+}
+
+dl::String bszNameForVmax(dl::String vmaxDirName) {
+    return vmaxDirName.replace("vmax", "bsz");
+}
+
+// Comma separated numbers of a command line value
+std::vector<double> parseNumberList(const std::string& text) {
+    std::vector<double> numbers;
+    std::stringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        numbers.push_back(std::stod(item));
+    }
+    return numbers;
+}
+
+// --materials, --colors and --crop, an empty filter when none is given
+VmaxVoxelFilter parseVoxelFilter(dl::Args& args) {
+    VmaxVoxelFilter filter;
+    if (args.have("--materials")) {
+        filter.materials.reset();
+        for (double material : parseNumberList(args.value("--materials").buf())) {
+            if (material < 0 || material > 7) throw std::runtime_error("--materials are material slots 0 to 7");
+            filter.materials.set(static_cast<size_t>(material));
+        }
+    }
+    if (args.have("--colors")) {
+        filter.colors.reset();
+        for (double color : parseNumberList(args.value("--colors").buf())) {
+            if (color < 1 || color > 255) throw std::runtime_error("--colors are palette indexes 1 to 255");
+            filter.colors.set(static_cast<size_t>(color));
+        }
+    }
+    if (args.have("--crop")) {
+        std::vector<double> box = parseNumberList(args.value("--crop").buf());
+        if (box.size() != 6) throw std::runtime_error("--crop needs minx,miny,minz,maxx,maxy,maxz");
+        filter.cropping = true;
+        for (int axis = 0; axis < 3; axis++) {
+            filter.cropMin[axis] = static_cast<int>(std::floor(std::min(box[axis], box[axis + 3])));
+            filter.cropMax[axis] = static_cast<int>(std::floor(std::max(box[axis], box[axis + 3])));
+        }
+    }
+    return filter;
+}
+
+// Place every object in world space and drop the ones the user doesn't want rendered
+// Bounds are the object's e_mi/e_ma extent (model voxel space) under its object transform
+// composed with every group above it, the same chain the bella xforms apply
+// Contents left without objects are removed from the map and never decoded
+void trimVmaxScene( dl::Args& args, 
+                    std::map<std::string, std::vector<oom::vmax::JsonModelInfo>>& modelVmaxbMap,
+                    const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups) {
+    std::vector<VmaxSceneInstance> sceneInstances;
+    for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) {
+        for (const auto& jsonModelInfo : vmaxModelList) {
+            oom::vmax::Matrix4x4 worldMat4 = objectWorldMatrix(jsonModelInfo, jsonGroups); // same chain as batching
+            VmaxBounds localBounds({0.0, 0.0, 0.0}, {256.0, 256.0, 256.0}); // whole model space when the extent is missing
+            if (jsonModelInfo.extentMin.size() == 3 && jsonModelInfo.extentMax.size() == 3) {
+                localBounds = VmaxBounds({jsonModelInfo.extentMin[0], jsonModelInfo.extentMin[1], jsonModelInfo.extentMin[2]},
+                                         {jsonModelInfo.extentMax[0], jsonModelInfo.extentMax[1], jsonModelInfo.extentMax[2]});
             }
-            allModels.push_back(currentVmaxModel);
-            // Parse the materials store in paletteN.settings.vmaxpsb    
-            plist_t plist_material = oom::vmax::readPlist(materialName.buf(),false); // decompress=false
-            std::array<oom::vmax::Material, 8> currentMaterials = oom::vmax::getMaterials(plist_material);
-            vmaxMaterials.push_back(currentMaterials);
-        }
-        //}
-        int modelIndex=0;
-        // Need to access voxles by material and color groupings
-        // Models are canonical models, not instances
-        // Vmax objects are instances of models
-
-        // First create canonical models and they are NOT attached to belWorld
-        for (const auto& eachModel : allModels) {
-            //if (modelIndex == 0) { // only process the first model
-            std::cout << modelIndex << " Model: " << eachModel.vmaxbFileName << std::endl;
-            //std::cout << "Voxel Count Model: " << eachModel.getTotalVoxelCount() << std::endl;
-            
-            dl::bella_sdk::Node belModel = addModelToScene( args,
-                                                            belScene, 
-                                                            belWorld, 
-                                                            eachModel, 
-                                                            vmaxPalettes[modelIndex], 
-                                                            vmaxMaterials[modelIndex]);
-            // TODO add to a map00000 of canonical models
-            dl::String lllmodelName = dl::String(eachModel.vmaxbFileName.c_str());
-            dl::String lllcanonicalName = lllmodelName.replace(".vmaxb", "");
-            belCanonicalNodes[lllcanonicalName.buf()] = belModel;
-            modelIndex++;
-        }
-
-        // Second Loop through each vmax object and create an instance of the canonical model
-        // This is the instances of the models, we did a pass to create the canonical models earlier
-        for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) { 
-            //std::cout << "model: " << vmaxContentName << std::endl;
-            oom::vmax::Model currentVmaxModel(vmaxContentName);
-            for(const auto& jsonModelInfo : vmaxModelList) {
-                std::vector<double> position = jsonModelInfo.position;
-                std::vector<double> rotation = jsonModelInfo.rotation;
-                std::vector<double> scale = jsonModelInfo.scale;
-                std::vector<double> extentCenter = jsonModelInfo.extentCenter;
-                auto jsonParentId = jsonModelInfo.parentId;
-                auto belParentId = dl::String(jsonParentId.c_str());
-                dl::String belParentGroupUUID = belParentId.replace("-", "_"); // Make sure the group name is valid for a Bella node name
-                belParentGroupUUID = "_" + belParentGroupUUID; // Make sure the group name is valid for a Bella node name
-
-                auto belObjectId = dl::String(jsonModelInfo.id.c_str());
-                belObjectId = belObjectId.replace("-", "_"); // Make sure the object name is valid for a Bella node name
-                belObjectId = "_" + belObjectId; // Make sure the object name is valid for a Bella node name
-
-                dl::String getCanonicalName = dl::String(jsonModelInfo.dataFile.c_str());
-                dl::String canonicalName = getCanonicalName.replace(".vmaxb", "");
-                //get bel node from canonical name
-                auto belCanonicalNode = belCanonicalNodes[canonicalName.buf()];
-                auto foofoo = belScene.findNode(canonicalName);
-
-                oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(rotation[0], 
-                                                                 rotation[1], 
-                                                                 rotation[2], 
-                                                                 rotation[3],
-                                                                 position[0], 
-                                                                 position[1], 
-                                                                 position[2], 
-                                                                 scale[0], 
-                                                                 scale[1], 
-                                                                 scale[2]);
-
-                auto belNodeObjectInstance = belScene.createNode("xform", belObjectId, belObjectId);
-                belNodeObjectInstance["steps"][0]["xform"] = dl::Mat4({
-                    objectMat4.m[0][0], objectMat4.m[0][1], objectMat4.m[0][2], objectMat4.m[0][3],
-                    objectMat4.m[1][0], objectMat4.m[1][1], objectMat4.m[1][2], objectMat4.m[1][3],
-                    objectMat4.m[2][0], objectMat4.m[2][1], objectMat4.m[2][2], objectMat4.m[2][3],
-                    objectMat4.m[3][0], objectMat4.m[3][1], objectMat4.m[3][2], objectMat4.m[3][3]
-                    });
-
-                if (jsonParentId == "") {
-                    belNodeObjectInstance.parentTo(belScene.world());
-                } else {
-                    dl::bella_sdk::Node myParentGroup = belGroupNodes[belParentGroupUUID]; // Get bella obj
-                    belNodeObjectInstance.parentTo(myParentGroup); // Group underneath a group
+            sceneInstances.emplace_back(jsonModelInfo.id, vmaxContentName, worldMat4, localBounds);
+        }
+    }
+    VmaxSceneBvh sceneBvh(sceneInstances);
+    if (args.have("--density")) {
+        printVmaxSceneDensity(sceneBvh.density());
+    }
+
+    std::vector<bool> keep(sceneInstances.size(), true);
+    auto keepOnly = [&keep](const std::vector<size_t>& inside) {
+        std::vector<bool> wasInside(keep.size(), false);
+        for (size_t index : inside) wasInside[index] = true;
+        for (size_t i = 0; i < keep.size(); i++) keep[i] = keep[i] && wasInside[i];
+    };
+    if (args.have("--cullbox")) {
+        std::vector<double> box = parseNumberList(args.value("--cullbox").buf());
+        if (box.size() != 6) throw std::runtime_error("--cullbox needs minx,miny,minz,maxx,maxy,maxz");
+        keepOnly(sceneBvh.queryBox(VmaxBounds({box[0], box[1], box[2]}, {box[3], box[4], box[5]})));
+    }
+    if (args.have("--cullfrustum")) {
+        std::vector<double> camera = parseNumberList(args.value("--cullfrustum").buf());
+        if (camera.size() != 10) throw std::runtime_error("--cullfrustum needs eyex,eyey,eyez,targetx,targety,targetz,fov,aspect,near,far");
+        keepOnly(sceneBvh.queryFrustum(VmaxFrustum::fromLookAt({camera[0], camera[1], camera[2]}, {camera[3], camera[4], camera[5]},
+                                                               camera[6], camera[7], camera[8], camera[9])));
+    }
+    size_t duplicateCount = 0;
+    if (args.have("--dedupe")) {
+        for (size_t index : sceneBvh.findDuplicates()) {
+            duplicateCount += keep[index];
+            keep[index] = false;
+        }
+    }
+
+    // Instances were gathered in map order, walk it again to drop the same objects
+    size_t instanceIndex = 0;
+    size_t droppedCount = 0;
+    for (auto content = modelVmaxbMap.begin(); content != modelVmaxbMap.end();) {
+        std::vector<oom::vmax::JsonModelInfo> keptObjects;
+        for (const auto& jsonModelInfo : content->second) {
+            if (keep[instanceIndex++]) keptObjects.push_back(jsonModelInfo); else droppedCount++;
+        }
+        content->second = std::move(keptObjects);
+        content = content->second.empty() ? modelVmaxbMap.erase(content) : std::next(content);
+    }
+    if (droppedCount > 0) {
+        std::cout << "trimmed " << droppedCount << " of " << sceneInstances.size() << " objects (" 
+                  << duplicateCount << " duplicates), " << modelVmaxbMap.size() << " contents left" << std::endl;
+    }
+}
+
+// Copy a package and rewrite its lzfse files (contents and history) as independent segments
+// so later conversions decode them in parallel, the plist inside is byte for byte the same
+int compactVmaxPackage(const std::string& vmaxDirName, const std::string& outDirName) {
+    std::error_code error;
+    std::filesystem::copy(vmaxDirName, outDirName, 
+                          std::filesystem::copy_options::recursive | std::filesystem::copy_options::overwrite_existing, error);
+    if (error) {
+        std::cerr << "Failed to copy " << vmaxDirName << " to " << outDirName << ": " << error.message() << std::endl;
+        return 1;
+    }
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(outDirName)) {
+        if (!entry.is_regular_file()) continue;
+        std::ifstream input(entry.path(), std::ios::binary);
+        std::vector<uint8_t> compressed((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        input.close();
+        std::vector<uint8_t> compacted;
+        if (!compactVmaxLzfse(compressed, compacted)) continue; // not lzfse, copied as is
+        std::ofstream output(entry.path(), std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char*>(compacted.data()), compacted.size());
+        if (!output) {
+            std::cerr << "Failed to write " << entry.path().string() << std::endl;
+            return 1;
+        }
+        std::cout << "compacted " << entry.path().filename().string() << ": " 
+                  << compressed.size() << " -> " << compacted.size() << " bytes" << std::endl;
+    }
+    return 0;
+}
+
+// What one synthetic model cost on the Bella side, the fastest of a few runs
+struct VmaxCalibrationSample {
+    double instances = 0.0;
+    double triangles = 0.0;
+    double buckets = 0.0;
+    double emitSeconds = 0.0;   // addModelToScene, node creation and array assignment
+    double writeSeconds = 0.0;  // belScene.write
+    double outputBytes = 0.0;   // .bsz size
+};
+
+VmaxCalibrationSample measureBellaCosts(dl::Args& args, const oom::vmax::Model& vmaxModel, VmaxRepresentation representation, 
+                                        const std::filesystem::path& scratchBsz) {
+    const std::vector<oom::vmax::RGBA> vmaxPalette(255, oom::vmax::RGBA{200, 200, 200, 255});
+    const std::array<oom::vmax::Material, 8> vmaxMaterial{};
+    VmaxCalibrationSample best;
+    for (int run = 0; run < 3; run++) {
+        dl::bella_sdk::Scene belScene;
+        belScene.loadDefs();
+        auto [  belWorld,
+                belMeshVoxel,
+                belLiqVoxel,
+                belVoxel,
+                belEmitterBlockXform ] = oom::bella::defaultSceneVoxel(belScene);
+        oom::bella::defaultScene2025(belScene);
+
+        // Meshing happens on workers before emission, keep it out of the timings
+        VmaxBucketMeshes premeshed;
+        if (representationIsMesh(representation)) {
+            for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+                for (int color : colorID) {
+                    premeshed[{material, color}] = meshVoxelBucket(vmaxModel.getVoxels(material, color), vmaxPalette, material, representation);
                 }
-                foofoo.parentTo(belNodeObjectInstance);
             }
         }
-
-        // Write Bella File .bsz=compressed .bsa=ascii .bsx=binary
-        belScene.write(bszName.buf());
+        s_perfStats = VmaxPerfStats();
+        auto emitStart = std::chrono::steady_clock::now();
+        dl::bella_sdk::Node belModel = addModelToScene(args, belScene, belWorld, vmaxModel, vmaxPalette, vmaxMaterial, representation, &premeshed);
+        belModel.parentTo(belScene.world());
+        auto writeStart = std::chrono::steady_clock::now();
+        belScene.write(scratchBsz.string().c_str());
+        auto writeEnd = std::chrono::steady_clock::now();
+        destroyBucketMeshes(premeshed);
+
+        std::error_code error;
+        uint64_t outputBytes = std::filesystem::file_size(scratchBsz, error);
+        VmaxCalibrationSample sample;
+        sample.instances = static_cast<double>(s_perfStats.instances);
+        sample.triangles = static_cast<double>(s_perfStats.triangles);
+        sample.buckets = static_cast<double>(s_perfStats.instancers + s_perfStats.meshes);
+        sample.emitSeconds = std::chrono::duration<double>(writeStart - emitStart).count();
+        sample.writeSeconds = std::chrono::duration<double>(writeEnd - writeStart).count();
+        sample.outputBytes = error ? 0.0 : static_cast<double>(outputBytes);
+        if (run == 0 || sample.emitSeconds + sample.writeSeconds < best.emitSeconds + best.writeSeconds) best = sample;
     }
+    s_perfStats = VmaxPerfStats();
+    return best;
+}
+
+// --calibrate, measure what Bella costs per instance, triangle and bucket (material and node set)
+// on synthetic models and write the cost table --costs loads. Every rate is the slope between a
+// small and a large model so the fixed cost of a scene cancels out.
+int calibrateBellaCosts(dl::Args& args, const std::string& costTableName) {
+    std::filesystem::path scratchBsz = std::filesystem::temp_directory_path() / "vmax2bella_calibrate.bsz";
+    auto solidCube = [](int size) { // one bucket, size^3 voxels
+        oom::vmax::Model vmaxModel("calibrate.vmaxb");
+        for (int z = 0; z < size; z++) {
+            for (int y = 0; y < size; y++) {
+                for (int x = 0; x < size; x++) vmaxModel.addVoxel(x, y, z, 0, 1, 0, 0);
+            }
+        }
+        return vmaxModel;
+    };
+    auto voxelPerColor = [](int colors) { // colors buckets of one voxel each
+        oom::vmax::Model vmaxModel("calibrate.vmaxb");
+        for (int color = 1; color <= colors; color++) vmaxModel.addVoxel((color % 16) * 2, (color / 16) * 2, 0, 0, color, 0, 0);
+        return vmaxModel;
+    };
+    auto slope = [](double small, double large, double smallCount, double largeCount) {
+        return largeCount > smallCount ? std::max(0.0, (large - small) / (largeCount - smallCount)) : 0.0;
+    };
+
+    VmaxCostTable costs; // memory and decode rates keep their defaults
+    VmaxCalibrationSample small = measureBellaCosts(args, solidCube(8), VmaxRepresentation::Box, scratchBsz);
+    VmaxCalibrationSample large = measureBellaCosts(args, solidCube(48), VmaxRepresentation::Box, scratchBsz);
+    costs.secondsPerInstance = slope(small.emitSeconds, large.emitSeconds, small.instances, large.instances);
+    costs.writeSecondsPerInstance = slope(small.writeSeconds, large.writeSeconds, small.instances, large.instances);
+    costs.outputBytesPerInstance = slope(small.outputBytes, large.outputBytes, small.instances, large.instances);
+
+    small = measureBellaCosts(args, solidCube(8), VmaxRepresentation::Mesh, scratchBsz);
+    large = measureBellaCosts(args, solidCube(96), VmaxRepresentation::Mesh, scratchBsz);
+    costs.secondsPerTriangle = slope(small.emitSeconds, large.emitSeconds, small.triangles, large.triangles);
+    costs.writeSecondsPerTriangle = slope(small.writeSeconds, large.writeSeconds, small.triangles, large.triangles);
+    costs.outputBytesPerTriangle = slope(small.outputBytes, large.outputBytes, small.triangles, large.triangles);
+
+    // Every bucket also holds one instance, take that back out
+    small = measureBellaCosts(args, voxelPerColor(8), VmaxRepresentation::Box, scratchBsz);
+    large = measureBellaCosts(args, voxelPerColor(255), VmaxRepresentation::Box, scratchBsz);
+    costs.secondsPerBucket = std::max(0.0, slope(small.emitSeconds, large.emitSeconds, small.buckets, large.buckets) - costs.secondsPerInstance);
+    costs.writeSecondsPerBucket = std::max(0.0, slope(small.writeSeconds, large.writeSeconds, small.buckets, large.buckets) - costs.writeSecondsPerInstance);
+    costs.outputBytesPerBucket = std::max(0.0, slope(small.outputBytes, large.outputBytes, small.buckets, large.buckets) - costs.outputBytesPerInstance);
+
+    std::error_code error;
+    std::filesystem::remove(scratchBsz, error);
+
+    std::cout << "calibrate:       emit ns    write ns   bsz bytes" << std::endl;
+    auto row = [](const char* name, double emit, double write, double bytes) {
+        std::cout << "  " << std::left << std::setw(13) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << emit * 1e9 << std::setw(11) << write * 1e9 << std::setw(12) << bytes << std::endl;
+    };
+    row("per instance", costs.secondsPerInstance, costs.writeSecondsPerInstance, costs.outputBytesPerInstance);
+    row("per triangle", costs.secondsPerTriangle, costs.writeSecondsPerTriangle, costs.outputBytesPerTriangle);
+    row("per bucket", costs.secondsPerBucket, costs.writeSecondsPerBucket, costs.outputBytesPerBucket);
+    std::cout.unsetf(std::ios::floatfield);
+    writeCostTable(costs, costTableName);
+    std::cout << "wrote " << costTableName << std::endl;
     return 0;
 }
 
+#if defined(__APPLE__) || defined(__linux__)
+std::string currentExecutablePath() {
+#ifdef __APPLE__
+    uint32_t size = 0;
+    _NSGetExecutablePath(nullptr, &size);
+    std::vector<char> path(size + 1, '\0');
+    if (_NSGetExecutablePath(path.data(), &size) != 0) throw std::runtime_error("Failed to find the vmax2bella executable");
+    return path.data();
+#else
+    return std::filesystem::read_symlink("/proc/self/exe").string();
+#endif
+}
+
+// Command line of a batch worker, this executable converting one input with the batch's options
+std::vector<std::string> batchWorkerCommand(dl::Args& args, const std::string& input) {
+    const std::set<std::string> driverOptions = {"input", "batch", "journal", "calibrate", "compact", "thirdparty", "licenseinfo"};
+    std::vector<std::string> command = {currentExecutablePath(), "--input:" + input};
+    for (const VmaxOption& option : kVmaxOptions) {
+        if (driverOptions.count(option.longName)) continue;
+        std::string name = std::string("--") + option.longName;
+        if (!args.have(name.c_str())) continue;
+        dl::String value = args.value(name.c_str());
+        command.push_back(value.isEmpty() ? name : name + ":" + value.buf());
+    }
+    return command;
+}
+#endif
+
+// Convert a list of projects, each in its own worker process so a crash only costs that project
+// Workers exec a fresh vmax2bella, forking this process would copy its bella state and threads
+// The journal lets a killed or preempted run pick up where it stopped, see oomer_batch_journal.h
+// Returns 1 when any listed project is quarantined so scripts notice
+int runVmaxBatch(dl::Args& args) {
+    std::string batchName = args.value("--batch").buf();
+    std::string journalName = args.have("--journal") ? args.value("--journal").buf() : batchName + ".journal";
+    std::ifstream batchFile(batchName);
+    if (!batchFile.is_open()) {
+        std::cerr << "Failed to open batch file: " << batchName << std::endl;
+        return 1;
+    }
+    std::vector<std::string> inputs;
+    std::string line;
+    while (std::getline(batchFile, line)) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.pop_back();
+        if (!line.empty() && line[0] != '#') inputs.push_back(line);
+    }
+
+    VmaxBatchJournal journal(journalName);
+    int converted = 0, skipped = 0, quarantined = 0;
+    for (const std::string& input : inputs) {
+        std::string hash = hashVmaxPackage(input);
+        if (hash.empty()) {
+            std::cerr << "batch: can't read " << input << std::endl;
+            quarantined++;
+            continue;
+        }
+        if (journal.isQuarantined(input, hash)) {
+            std::cout << "batch: quarantined " << input << " (" << journal.quarantineReason(input, hash) << ")" << std::endl;
+            quarantined++;
+            continue;
+        }
+        if (journal.isDone(input, hash)) {
+            skipped++;
+            continue;
+        }
+        if (journal.unfinishedStarts(input, hash) >= kBatchMaxAttempts) {
+            journal.recordQuarantine(input, hash, "took down " + std::to_string(kBatchMaxAttempts) + " batch runs");
+            std::cout << "batch: quarantined " << input << " after " << kBatchMaxAttempts << " unfinished attempts" << std::endl;
+            quarantined++;
+            continue;
+        }
+
+        std::cout << "batch: converting " << input << std::endl;
+        journal.recordStart(input, hash);
+        std::string failure;
+#if defined(__APPLE__) || defined(__linux__)
+        std::vector<std::string> command = batchWorkerCommand(args, input);
+        std::vector<char*> commandArgs;
+        for (std::string& word : command) commandArgs.push_back(word.data());
+        commandArgs.push_back(nullptr);
+        std::cout.flush();
+        pid_t worker = fork();
+        if (worker == 0) { // nothing but exec between fork and exec
+            execv(commandArgs[0], commandArgs.data());
+            _exit(127);
+        }
+        int status = 0;
+        if (worker < 0) {
+            failure = "fork failed";
+        } else if (waitpid(worker, &status, 0) < 0) {
+            failure = "lost the worker";
+        } else if (WIFSIGNALED(status)) {
+            failure = "worker crashed with signal " + std::to_string(WTERMSIG(status));
+        } else if (WEXITSTATUS(status) != 0) {
+            failure = "worker exited with " + std::to_string(WEXITSTATUS(status));
+        }
+#else
+        // No fork here, convert in process, a crash takes the run down and the journal quarantines it on restart
+        try {
+            if (convertVmaxPackage(args, dl::String(input.c_str())) != 0) failure = "conversion failed";
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+#endif
+        if (failure.empty()) {
+            journal.recordDone(input, hash, bszNameForVmax(dl::String(input.c_str())).buf());
+            converted++;
+        } else {
+            journal.recordQuarantine(input, hash, failure);
+            std::cout << "batch: quarantined " << input << " (" << failure << ")" << std::endl;
+            quarantined++;
+        }
+    }
+    std::cout << "batch: " << converted << " converted, " << skipped << " already done, " 
+              << quarantined << " quarantined, journal " << journal.path() << std::endl;
+    return quarantined > 0 ? 1 : 0;
+}
+
+// Place objects of one content that share a parent group with a single instancer
+// Each instance is the object matrix the per object xform would have carried, relative to the
+// parent group, so the parent chain still applies once through the instancer's parent
+void addObjectInstancer(dl::bella_sdk::Scene& belScene,
+                        std::map<dl::String, dl::bella_sdk::Node>& belGroupNodes,
+                        const std::string& jsonParentId,
+                        const std::vector<const oom::vmax::JsonModelInfo*>& objects) {
+    dl::String canonicalName = dl::String(objects.front()->dataFile.c_str()).replace(".vmaxb", ""); // same naming as the canonical pass
+    dl::String belParentGroupUUID = "_" + dl::String(jsonParentId.c_str()).replace("-", "_"); // Make sure the group name is valid for a Bella node name
+    dl::String instancerName = canonicalName + (jsonParentId == "" ? dl::String("_world") : belParentGroupUUID) + dl::String("Instancer");
+
+    auto xformsArray = dl::ds::Vector<dl::Mat4f>();
+    xformsArray.reserve(objects.size());
+    for (const oom::vmax::JsonModelInfo* jsonModelInfo : objects) {
+        const std::vector<double>& rotation = jsonModelInfo->rotation;
+        const std::vector<double>& position = jsonModelInfo->position;
+        const std::vector<double>& scale = jsonModelInfo->scale;
+        oom::vmax::Matrix4x4 objectMat4 = oom::vmax::combineTransforms(rotation[0], rotation[1], rotation[2], rotation[3],
+                                                                       position[0], position[1], position[2],
+                                                                       scale[0], scale[1], scale[2]);
+        dl::Mat4f objectMat4f;
+        float* objectFloats = reinterpret_cast<float*>(&objectMat4f);
+        for (int row = 0; row < 4; row++) {
+            for (int col = 0; col < 4; col++) {
+                objectFloats[row * 4 + col] = static_cast<float>(objectMat4.m[row][col]);
+            }
+        }
+        xformsArray.push_back(objectMat4f);
+    }
+
+    auto belInstancer = belScene.createNode("instancer", instancerName, instancerName);
+    belInstancer["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
+    belInstancer["steps"][0]["instances"] = xformsArray;
+    s_perfStats.instancers++;
+    s_perfStats.instances += xformsArray.size();
+    if (jsonParentId == "") {
+        belInstancer.parentTo(belScene.world());
+    } else {
+        dl::bella_sdk::Node myParentGroup = belGroupNodes[belParentGroupUUID]; // Get bella obj
+        belInstancer.parentTo(myParentGroup); // Group underneath a group
+    }
+    belScene.findNode(canonicalName).parentTo(belInstancer);
+}
+
 // Only add the canonical model to the scene
 // We'll use xforms to instance the model
 // Each model is stores in contentsN.vmaxb as a lzfe compressed plist
@@ -502,7 +1677,11 @@ dl::bella_sdk::Node addModelToScene(dl::Args& args,
                                     dl::bella_sdk::Node& belWorld, 
                                     const oom::vmax::Model& vmaxModel, 
                                     const std::vector<oom::vmax::RGBA>& vmaxPalette, 
-                                    const std::array<oom::vmax::Material, 8>& vmaxMaterial) {
+                                    const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                                    VmaxRepresentation representation,
+                                    VmaxBucketMeshes* premeshed,
+                                    std::map<int, VmaxAtlasMesh>* atlasMeshes,
+                                    const VmaxOccupancySummary* occupancy) {
     // Create Bella scene nodes for each voxel
     int i = 0;
     dl::String modelName = dl::String(vmaxModel.vmaxbFileName.c_str());
@@ -516,67 +1695,61 @@ dl::bella_sdk::Node addModelToScene(dl::Args& args,
         auto belMeshVoxel = belScene.findNode("oomMeshVoxel");
         auto belVoxelForm = belScene.findNode("oomEmitterBlockXform");
         //auto belLiqVoxelForm = belScene.findNode("oomLiqVoxelXform");
-        auto belBevel = belScene.findNode("oomBevel");
 
         auto modelXform = belScene.createNode("xform", canonicalName, canonicalName);
         modelXform["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
-        for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
-            for (int color : colorID) {
-
-                auto thisname = canonicalName + dl::String("Material") + dl::String(material) + dl::String("Color") + dl::String(color);
 
-                auto belMaterial  = belScene.createNode("quickMaterial",
-                                canonicalName + dl::String("vmaxMat") + dl::String(material) + dl::String("Color") + dl::String(color));
-                bool isMesh = false;
-                bool isBox = true;
-
-                if(material==7) {
-                    belMaterial["type"] = "liquid";
-                    //belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
-                    belMaterial["liquidDepth"] = 300.0f;
-                    belMaterial["liquidIor"] = 1.33f;
-                    isMesh = true;
-                    isBox = false;
-                } else if(material==6 || vmaxPalette[color-1].a < 255) {
-                    belMaterial["type"] = "glass";
-                    belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
-                    belMaterial["glassDepth"] = 500.0f;
-                } else if(vmaxMaterial[material].metalness > 0.1f) {
-                    belMaterial["type"] = "metal";
-                    belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
-                } else if(vmaxMaterial[material].transmission > 0.0f) {
-                    belMaterial["type"] = "dielectric";
-                    belMaterial["transmission"] = vmaxMaterial[material].transmission;
-                } else if(vmaxMaterial[material].emission > 0.0f) {
-                    belMaterial["type"] = "emitter";
-                    belMaterial["emitterUnit"] = "radiance";
-                    belMaterial["emitterEnergy"] = vmaxMaterial[material].emission*100.0f;
-                } else if(vmaxMaterial[material].roughness > 0.8999f) {
-                    belMaterial["type"] = "diffuse";
+        // One textured mesh per material for the atlas colors, they are skipped below
+        bool atlas = atlasRepresentation(args, representation);
+        if (atlas) {
+            for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+                int atlasColor = -1;
+                for (int color : colorID) {
+                    if (isAtlasBucket(material, color, vmaxPalette)) atlasColor = color;
+                }
+                if (atlasColor < 0) continue;
+                VmaxAtlasMesh inlineMesh; // stored models and late representation changes aren't premeshed
+                const VmaxAtlasMesh* atlasMesh = &inlineMesh;
+                if (atlasMeshes && atlasMeshes->count(material)) {
+                    atlasMesh = &atlasMeshes->at(material);
                 } else {
-                    belMaterial["type"] = "plastic";
-                    belMaterial["roughness"] = vmaxMaterial[material].roughness * 100.0f;
+                    inlineMesh = meshAtlasMaterial(vmaxModel, vmaxPalette, material);
                 }
+                auto thisname = canonicalName + dl::String("Material") + dl::String(material) + dl::String("Atlas");
+                std::filesystem::create_directories(s_textureDir);
+                writeAtlasPng(*atlasMesh, (s_textureDir / (std::string(thisname.buf()) + ".png")).string());
+
+                // describeBellaMaterial only looks at the color for glass, atlas colors are all opaque
+                VmaxBellaMaterial materialDesc = describeBellaMaterial(material, atlasColor, vmaxPalette, vmaxMaterial, args.have("bevel"));
+                auto belMaterial = createBellaMaterial( belScene, 
+                                                        canonicalName + dl::String("vmaxMat") + dl::String(material) + dl::String("Atlas"),
+                                                        materialDesc);
+                auto belTexture = belScene.createNode("fileTexture", thisname + dl::String("Texture"));
+                belTexture["dir"] = s_textureDir.string().c_str();
+                belTexture["file"] = thisname;
+                belTexture["ext"] = ".png";
+                belMaterial["color"] |= belTexture.output("outColor");
+
+                auto belMeshXform = belScene.createNode("xform", thisname + dl::String("Xform"));
+                belMeshXform.parentTo(modelXform);
+                auto belMesh = add_atlas_mesh_to_scene(thisname, *atlasMesh, belScene);
+                belMesh.parentTo(belMeshXform);
+                belMeshXform["material"] = belMaterial;
+            }
+        }
 
-                if (args.have("bevel") && material != 7) {
-                    belMaterial["bevel"] = belBevel;
-                }
-                if (args.have("mode") && args.value("mode") == "mesh" || args.value("mode") == "both") {
-                    isMesh = true;
-                    isBox = false;
-                }
+        for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+            for (int color : colorID) {
+                if (atlas && isAtlasBucket(material, color, vmaxPalette)) continue; // in the material's atlas mesh
+
+                auto thisname = canonicalName + dl::String("Material") + dl::String(material) + dl::String("Color") + dl::String(color);
 
-                // Convert 0-255 to 0-1 , remember to -1 color index becuase voxelmax needs 0 to indicate no voxel
-                double bellaR = static_cast<double>(vmaxPalette[color-1].r)/255.0;
-                double bellaG = static_cast<double>(vmaxPalette[color-1].g)/255.0;
-                double bellaB = static_cast<double>(vmaxPalette[color-1].b)/255.0;
-                double bellaA = static_cast<double>(vmaxPalette[color-1].a)/255.0;
-                belMaterial["color"] = dl::Rgba{ // convert sRGB to linear
-                    oom::misc::srgbToLinear(bellaR), 
-                    oom::misc::srgbToLinear(bellaG), 
-                    oom::misc::srgbToLinear(bellaB), 
-                    bellaA // alpha is already linear
-                }; // colors ready to use in Bella
+                VmaxBellaMaterial materialDesc = describeBellaMaterial(material, color, vmaxPalette, vmaxMaterial, args.have("bevel"));
+                auto belMaterial = createBellaMaterial( belScene, 
+                                                        canonicalName + dl::String("vmaxMat") + dl::String(material) + dl::String("Color") + dl::String(color),
+                                                        materialDesc);
+                bool isMesh = material == 7 || representationIsMesh(representation); // liquid is always a mesh
+                bool isBox = !isMesh;
 
                 // Get all voxels for this material/color combination
                 const std::vector<oom::vmax::Voxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
@@ -587,21 +1760,16 @@ dl::bella_sdk::Node addModelToScene(dl::Args& args,
                         thisname+dl::String("Xform"));
                     belMeshXform.parentTo(modelXform);
 
-                    // Convert voxels of a particular color to ogt_vox_model
-                    ogt_vox_model* ogt_model = oom::ogt::convert_voxelsoftype_to_ogt_vox(voxelsOfType);
-                    ogt_mesh_rgba* palette = new ogt_mesh_rgba[256]; // Create a palette array
-                    for (int i = 0; i < 256; i++) { // Copy palette from Vmax to OGT
-                        palette[i] = ogt_mesh_rgba{vmaxPalette[i].r, vmaxPalette[i].g, vmaxPalette[i].b, vmaxPalette[i].a};
+                    // Downsampled models are meshed at lower resolution and scaled back up
+                    int lodFactor = representationLodFactor(representation);
+                    if (lodFactor > 1) {
+                        belMeshXform["steps"][0]["xform"] = dl::Mat4 {  double(lodFactor),0,0,0,
+                                                                        0,double(lodFactor),0,0,
+                                                                        0,0,double(lodFactor),0,
+                                                                        0,0,0,1};
                     }
-                    ogt_voxel_meshify_context ctx = {}; // Create a context struct, not a pointer, todo , what is this for
-
-                    // Convert ogt voxels to mesh
-                    ogt_mesh* mesh = ogt_mesh_from_paletted_voxels_simple(  &ctx,
-                                                                            ogt_model->voxel_data, 
-                                                                            ogt_model->size_x, 
-                                                                            ogt_model->size_y, 
-                                                                            ogt_model->size_z, 
-                                                                            palette ); 
+                    ogt_mesh* mesh = takeBucketMesh(premeshed, material, color);
+                    if (!mesh) mesh = meshVoxelBucket(voxelsOfType, vmaxPalette, material, representation);
                         
                     if (voxelsOfType.size() > 0) {
                         auto belMesh = add_ogt_mesh_to_scene(   thisname,
@@ -614,6 +1782,8 @@ dl::bella_sdk::Node addModelToScene(dl::Args& args,
                     } else { 
                         std::cout << "skipping" << color << "\n";
                     }
+                    ogt_voxel_meshify_context ctx = {};
+                    ogt_mesh_destroy(&ctx, mesh);
                 }
                 if (isBox) {
                     auto belInstancer  = belScene.createNode("instancer",
@@ -624,15 +1794,19 @@ dl::bella_sdk::Node addModelToScene(dl::Args& args,
 
                     //WARNING we use to do morton decoding above but now VoxModel does it when addVoxel is called
                     // So we can just use the x,y,z values
-                    for (const auto& eachvoxel : voxelsOfType) {
-                        xformsArray.push_back( dl::Mat4f{  1, 0, 0, 0, 
-                                                        0, 1, 0, 0, 
-                                                        0, 0, 1, 0, 
-                                                        (static_cast<float>(eachvoxel.x))+0.5f,  // offset center of voxel to match mesh
-                                                        (static_cast<float>(eachvoxel.y))+0.5f,
-                                                        (static_cast<float>(eachvoxel.z))+0.5f, 1 });
-                    };
+                    // Pack the kept voxels into an xyz stream, size the array once and fill it in parallel
+                    bool cullHidden = representation == VmaxRepresentation::CulledBox;
+                    unsigned int packThreads = args.have("--threads") ? std::stoul(args.value("--threads").buf()) : 0;
+                    std::vector<uint32_t> packedVoxels = packVoxelCoordinates(voxelsOfType, [&](const oom::vmax::Voxel& eachvoxel) {
+                        return !cullHidden || !isVoxelHidden(vmaxModel, eachvoxel, vmaxPalette, occupancy);
+                    }, packThreads);
+                    static_assert(sizeof(dl::Mat4f) == 16 * sizeof(float), "packInstanceTransforms writes 16 floats per dl::Mat4f");
+                    xformsArray.resize(packedVoxels.size());
+                    packInstanceTransforms(packedVoxels.data(), packedVoxels.size(), reinterpret_cast<float*>(xformsArray.data()), 
+                                           0.5f, packThreads); // offset center of voxel to match mesh
                     belInstancer["steps"][0]["instances"] = xformsArray;
+                    s_perfStats.instancers++;
+                    s_perfStats.instances += xformsArray.size();
                     belInstancer["material"] = belMaterial;
                     if(material==7) {
                         belLiqVoxel.parentTo(belInstancer);
@@ -684,5 +1858,870 @@ dl::bella_sdk::Node add_ogt_mesh_to_scene(  dl::String name,
                                         static_cast<unsigned int>(meshmesh->indices[i+2]) });
     }
     ogtMesh["polygons"] = facesArray;
+    s_perfStats.meshes++;
+    s_perfStats.triangles += facesArray.size();
     return ogtMesh;
-}
\ No newline at end of file
+}
+bool atlasRepresentation(dl::Args& args, VmaxRepresentation representation) {
+    return representation == VmaxRepresentation::GreedyMesh && args.have("--meshtype") && args.value("--meshtype") == "atlas";
+}
+
+// Same glass rule as describeBellaMaterial, glass and liquid keep a material per color
+bool isAtlasBucket(int material, int color, const std::vector<oom::vmax::RGBA>& vmaxPalette) {
+    return material != 7 && material != 6 && vmaxPalette[color-1].a == 255;
+}
+
+VmaxAtlasMesh meshAtlasMaterial(const oom::vmax::Model& vmaxModel, 
+                                const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                                int material) {
+    std::vector<const std::vector<oom::vmax::Voxel>*> buckets;
+    for (const auto& [usedMaterial, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+        if (usedMaterial != material) continue;
+        for (int color : colorID) {
+            if (isAtlasBucket(material, color, vmaxPalette)) buckets.push_back(&vmaxModel.getVoxels(material, color));
+        }
+    }
+    return meshVoxelsCrossColor(buckets, vmaxPalette);
+}
+
+// Like add_ogt_mesh_to_scene plus per vertex uvs into the atlas
+dl::bella_sdk::Node add_atlas_mesh_to_scene(dl::String name, 
+                                            const VmaxAtlasMesh& atlasMesh, 
+                                            dl::bella_sdk::Scene& belScene) {
+    auto atlasNode = belScene.createNode("mesh", name+"atlasmesh", name+"atlasmesh");
+    atlasNode["normals"] = "flat";
+    dl::ds::Vector<dl::Pos3f> verticesArray;
+    dl::ds::Vector<dl::Vec2f> uvsArray;
+    verticesArray.reserve(atlasMesh.vertexCount());
+    uvsArray.reserve(atlasMesh.vertexCount());
+    for (size_t i = 0; i < atlasMesh.vertexCount(); i++) {
+        verticesArray.push_back(dl::Pos3f{ atlasMesh.positions[i*3], atlasMesh.positions[i*3+1], atlasMesh.positions[i*3+2] });
+        uvsArray.push_back(dl::Vec2f{ atlasMesh.uvs[i*2], atlasMesh.uvs[i*2+1] });
+    }
+    atlasNode["steps"][0]["points"] = verticesArray;
+    atlasNode["uvs"] = uvsArray;
+
+    dl::ds::Vector<dl::Vec4u> facesArray;
+    facesArray.reserve(atlasMesh.quadCount());
+    for (size_t i = 0; i < atlasMesh.quads.size(); i+=4) {
+        facesArray.push_back(dl::Vec4u{ atlasMesh.quads[i], atlasMesh.quads[i+1], atlasMesh.quads[i+2], atlasMesh.quads[i+3] });
+    }
+    atlasNode["polygons"] = facesArray;
+    s_perfStats.meshes++;
+    s_perfStats.triangles += facesArray.size() * 2; // quads
+    return atlasNode;
+}
+
+// Gather what the budget planner needs to estimate a model's cost
+VmaxModelStats vmaxModelStats(const oom::vmax::Model& vmaxModel) {
+    VmaxModelStats stats;
+    stats.name = vmaxModel.vmaxbFileName;
+    stats.voxelCount = vmaxModel.getTotalVoxelCount();
+    for (const auto& [material, colors] : vmaxModel.getUsedMaterialsAndColors()) {
+        stats.bucketCount += colors.size();
+    }
+    stats.sizeX = static_cast<uint32_t>(vmaxModel.maxx) + 1;
+    stats.sizeY = static_cast<uint32_t>(vmaxModel.maxy) + 1;
+    stats.sizeZ = static_cast<uint32_t>(vmaxModel.maxz) + 1;
+    return stats;
+}
+
+// A voxel is hidden when all 6 neighbours are opaque voxels
+// Glass, liquid and translucent colors don't occlude, we can see through them
+// A neighbour in an empty brick of the occupancy summary is known to be empty without a lookup
+bool isVoxelHidden( const oom::vmax::Model& vmaxModel, 
+                    const oom::vmax::Voxel& voxel, 
+                    const std::vector<oom::vmax::RGBA>& vmaxPalette,
+                    const VmaxOccupancySummary* occupancy) {
+    static const int offsets[6][3] = {{1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1}};
+    for (const auto& offset : offsets) {
+        int nx = voxel.x + offset[0];
+        int ny = voxel.y + offset[1];
+        int nz = voxel.z + offset[2];
+        if (nx < 0 || ny < 0 || nz < 0 || nx > 255 || ny > 255 || nz > 255) return false;
+        if (occupancy && !occupancy->brickOccupied(nx, ny, nz)) return false;
+        const auto& neighbours = vmaxModel.getVoxelsAt(nx, ny, nz);
+        if (neighbours.empty()) return false;
+        const auto& neighbour = neighbours.front();
+        if (neighbour.material == 6 || neighbour.material == 7) return false;
+        if (vmaxPalette[neighbour.palette - 1].a < 255) return false;
+    }
+    return true;
+}
+
+// Collapse each factor^3 block of voxels into one voxel, used for budget LOD
+std::vector<oom::vmax::Voxel> downsampleVoxels(const std::vector<oom::vmax::Voxel>& voxels, int factor) {
+    std::vector<oom::vmax::Voxel> result;
+    uint32_t size = 256 / factor;
+    std::vector<uint8_t> seen(size * size * size, 0);
+    for (const auto& voxel : voxels) {
+        uint32_t x = voxel.x / factor;
+        uint32_t y = voxel.y / factor;
+        uint32_t z = voxel.z / factor;
+        uint32_t index = x + y * size + z * size * size;
+        if (seen[index]) continue;
+        seen[index] = 1;
+        result.emplace_back(x, y, z, voxel.material, voxel.palette, voxel.chunkID, voxel.minMorton);
+    }
+    return result;
+}
+
+// Read and decode one content, its palette png and its material settings
+VmaxContentJob::~VmaxContentJob() {
+    if (plistModel) plist_free(plistModel); // decode never ran, an earlier task failed
+    destroyBucketMeshes(meshes);
+}
+
+// Compressed size of a content, the only cost we know before reading it
+double estimateReadCost(const std::string& fileName) {
+    std::error_code error;
+    uintmax_t fileSize = std::filesystem::file_size(fileName, error);
+    return error ? 1.0 : static_cast<double>(fileSize) * kReadCostPerByte;
+}
+
+// Read stage of the task graph, runs on a worker, safe to run concurrently with other contents:
+// - libplist registers its parsers from a load time constructor, after that parsing and
+//   lookups only touch the tree being parsed (dict hash tables are built per node)
+// - stb_image keeps its failure reason thread local and we never change its global flip flags
+// - lzfse decodes with scratch buffers owned by the call, large streams fan out to threads
+//   of their own which inherit this worker's NUMA pinning
+// - nothing here touches bella_sdk, nodes are only created on the main thread
+void readVmaxContent(const std::string& vmaxDirName, VmaxContentJob& job) {
+    // Get file names
+    std::string pngName = vmaxDirName + "/" + job.jsonModelInfo.paletteFile;
+    std::string materialName = pngName;
+    size_t pngExtension = materialName.rfind(".png");
+    if (pngExtension != std::string::npos) {
+        materialName.replace(pngExtension, 4, ".settings.vmaxpsb");
+    }
+
+    // Get this models colors from the paletteN.png 
+    job.decoded.palette = oom::vmax::read256x1PaletteFromPNG(pngName);
+    if (job.decoded.palette.empty()) { throw std::runtime_error("Failed to read palette from: png " + pngName); }
+
+    // Parse the materials store in paletteN.settings.vmaxpsb    
+    plist_t plist_material = oom::vmax::readPlist(materialName, false); // decompress=false
+    job.decoded.materials = oom::vmax::getMaterials(plist_material);
+    plist_free(plist_material);
+
+    // Read contentsN.vmaxb plist file, lzfse compressed
+    // Decoded block parallel where the stream allows it, see oomer_lzfse_blocks.h
+    std::string modelFileName = vmaxDirName + "/" + job.jsonModelInfo.dataFile;
+    std::ifstream modelFile(modelFileName, std::ios::binary);
+    if (!modelFile.is_open()) { throw std::runtime_error("Could not open plist file: " + modelFileName); }
+    std::vector<uint8_t> compressed((std::istreambuf_iterator<char>(modelFile)), std::istreambuf_iterator<char>());
+    std::vector<uint8_t> plistBytes;
+    if (!decodeLzfseStream(compressed.data(), compressed.size(), plistBytes, job.lzfseThreads)) {
+        throw std::runtime_error("Failed to decompress: " + modelFileName);
+    }
+    compressed = std::vector<uint8_t>();
+    plist_format_t format;
+    if (plist_from_memory(reinterpret_cast<const char*>(plistBytes.data()), static_cast<uint32_t>(plistBytes.size()), 
+                          &job.plistModel, &format) != PLIST_ERR_SUCCESS) {
+        throw std::runtime_error("Failed to parse plist data: " + modelFileName);
+    }
+
+    // Each snapshot records its voxel count in s.st.c, their sum is the decode cost
+    job.voxelEstimate = 0;
+    plist_t plist_snapshots_array = plist_dict_get_item(job.plistModel, "snapshots");
+    uint32_t snapshots_array_size = plist_array_get_size(plist_snapshots_array);
+    for (uint32_t i = 0; i < snapshots_array_size; i++) {
+        plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
+        plist_t plist_count = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "st", "c"});
+        uint64_t count = 0;
+        if (plist_count) plist_get_uint_val(plist_count, &count);
+        job.voxelEstimate += count;
+    }
+
+    if (!job.cacheFile.empty()) {
+        loadVmaxContentCache(job.cacheFile, job.cache); // a missing or unusable cache decodes everything
+    }
+}
+
+// Decode stage of the task graph, turns the snapshots read earlier into a model
+// Same thread safety as readVmaxContent
+void decodeVmaxContent(VmaxContentJob& job, bool recordStoredVoxels) {
+    DecodedVmaxContent& decoded = job.decoded;
+    plist_t plist_snapshots_array = plist_dict_get_item(job.plistModel, "snapshots");
+    uint32_t snapshots_array_size = plist_array_get_size(plist_snapshots_array);
+    if (recordStoredVoxels) decoded.storedVoxels.reserve(job.voxelEstimate);
+    // Filters and the occupancy summary see model space like the crop box, decoded positions
+    // are still missing the chunk offset Model::addVoxel adds
+    int64_t originChunk = -1;
+    uint32_t chunkOrigin[3] = {0, 0, 0};
+    auto toModelSpace = [&](int64_t chunk) -> const uint32_t* {
+        if (chunk != originChunk) {
+            oom::vmax::decodeMorton3DOptimized(static_cast<uint32_t>(chunk), chunkOrigin[0], chunkOrigin[1], chunkOrigin[2]);
+            for (uint32_t& axis : chunkOrigin) axis *= 24; // same offset as Model::addVoxel
+            originChunk = chunk;
+        }
+        return chunkOrigin;
+    };
+    auto addKeptVoxel = [&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t palette, int64_t chunk, uint64_t chunkMin) {
+        decoded.model.addVoxel(x, y, z, material, palette, chunk, chunkMin);
+        const uint32_t* origin = toModelSpace(chunk);
+        decoded.occupancy.add(x + origin[0], y + origin[1], z + origin[2], material, palette);
+        if (recordStoredVoxels) {
+            decoded.storedVoxels.push_back(VmaxStoredVoxel{ x, y, z, material, palette, {0, 0, 0},
+                                                            static_cast<uint32_t>(chunk), 
+                                                            static_cast<uint32_t>(chunkMin)});
+        }
+    };
+    auto addDecodedVoxel = [&](uint8_t x, uint8_t y, uint8_t z, uint8_t material, uint8_t palette, int64_t chunk, uint64_t chunkMin) {
+        if (job.filter) {
+            const uint32_t* origin = toModelSpace(chunk);
+            if (!job.filter->keepVoxel(x + origin[0], y + origin[1], z + origin[2], material, palette)) return;
+        }
+        addKeptVoxel(x, y, z, material, palette, chunk, chunkMin);
+    };
+
+    // With --incremental every chunk is fingerprinted first, a chunk hashing like last time
+    // takes its voxels from the cache, the voxels of changed chunks mark their tiles dirty
+    bool incremental = !job.cacheFile.empty();
+    bool trackDirty = incremental && job.tileSize > 0 && !job.cache.tiles.empty();
+    int tilesPerAxis = kTiledMeshExtent / std::max(job.tileSize, 1);
+    // Decoded positions are chunk relative until addVoxel adds the chunk offset, tiles are in model space
+    auto markDirty = [&](int64_t chunk, const auto& voxel) {
+        if (!trackDirty) return;
+        const uint32_t* origin = toModelSpace(chunk);
+        markDirtyVoxel(job.dirtyTiles, voxel.material, voxel.palette, voxel.x + origin[0], voxel.y + origin[1], voxel.z + origin[2], 
+                       job.tileSize, tilesPerAxis);
+    };
+    std::map<int64_t, uint64_t> chunkHashes;
+    if (incremental) {
+        for (uint32_t i = 0; i < snapshots_array_size; i++) {
+            plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
+            plist_t plist_datastream = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "ds"});
+            oom::vmax::ChunkInfo chunkInfo = oom::vmax::vmaxChunkInfo(plist_snapshot);
+            uint64_t length = 0;
+            const char* data = plist_datastream ? plist_get_data_ptr(plist_datastream, &length) : nullptr;
+            auto known = chunkHashes.find(chunkInfo.id);
+            chunkHashes[chunkInfo.id] = hashVmaxChunk(known == chunkHashes.end() ? kChunkHashSeed : known->second, 
+                                                      static_cast<uint64_t>(chunkInfo.id), chunkInfo.mortoncode,
+                                                      reinterpret_cast<const uint8_t*>(data), static_cast<size_t>(length));
+        }
+        for (const auto& [chunkId, cachedChunk] : job.cache.chunks) {
+            if (chunkHashes.count(static_cast<int64_t>(chunkId))) continue;
+            job.changedChunks++; // deleted since the last conversion
+            for (const VmaxCachedVoxel& voxel : cachedChunk.voxels) {
+                markDirty(static_cast<int64_t>(chunkId), voxel);
+            }
+        }
+    }
+
+    std::set<uint64_t> croppedChunks; // missing the snapshots --crop skipped, not cached
+    for (uint32_t i = 0; i < snapshots_array_size; i++) {
+        plist_t plist_snapshot = plist_array_get_item(plist_snapshots_array, i);
+        plist_t plist_datastream = oom::vmax::getNestedPlistNode(plist_snapshot, {"s", "ds"});
+        oom::vmax::ChunkInfo chunkInfo = oom::vmax::vmaxChunkInfo(plist_snapshot);
+        VmaxCachedChunk* nextChunk = nullptr;
+        if (incremental) {
+            uint64_t chunkId = static_cast<uint64_t>(chunkInfo.id);
+            bool firstSnapshot = !job.nextCache.chunks.count(chunkId);
+            auto cached = job.cache.chunks.find(chunkId);
+            bool unchanged = cached != job.cache.chunks.end() && cached->second.hash == chunkHashes[chunkInfo.id];
+            if (unchanged) {
+                if (firstSnapshot) { // the cached voxels cover every snapshot of the chunk
+                    for (const VmaxCachedVoxel& voxel : cached->second.voxels) {
+                        addDecodedVoxel(voxel.x, voxel.y, voxel.z, voxel.material, voxel.palette, chunkInfo.id, voxel.chunkMin);
+                    }
+                    job.nextCache.chunks[chunkId] = std::move(cached->second);
+                }
+                continue;
+            }
+            nextChunk = &job.nextCache.chunks[chunkId];
+            if (firstSnapshot) {
+                nextChunk->hash = chunkHashes[chunkInfo.id];
+                job.changedChunks++;
+                if (cached != job.cache.chunks.end()) {
+                    for (const VmaxCachedVoxel& voxel : cached->second.voxels) { // where the chunk used to be
+                        markDirty(chunkInfo.id, voxel);
+                    }
+                }
+            }
+        }
+        uint64_t length = 0;
+        const uint8_t* data = plist_datastream ? reinterpret_cast<const uint8_t*>(plist_get_data_ptr(plist_datastream, &length)) : nullptr;
+        if (!nextChunk) { // the range applies the filter before decoding a voxel, skipping snapshots outside the crop box
+            for (const VmaxStreamVoxel& voxel : VmaxSnapshotVoxels(data, length, static_cast<uint64_t>(chunkInfo.id), chunkInfo.mortoncode, job.filter)) {
+                addKeptVoxel(voxel.infoX, voxel.infoY, voxel.infoZ, voxel.material, voxel.color, chunkInfo.id, chunkInfo.mortoncode);
+            }
+            continue;
+        }
+        if (job.filter && job.filter->cropping) { // a snapshot outside the crop box is never decoded
+            int snapshotMin[3], snapshotMax[3];
+            vmaxSnapshotBox(static_cast<uint64_t>(chunkInfo.id), chunkInfo.mortoncode, length / 2, snapshotMin, snapshotMax);
+            if (!job.filter->keepBox(snapshotMin, snapshotMax)) {
+                croppedChunks.insert(static_cast<uint64_t>(chunkInfo.id));
+                continue;
+            }
+        }
+        // The cache keeps every voxel of the chunk, the filter is applied as they are added
+        for (const VmaxStreamVoxel& voxel : VmaxSnapshotVoxels(data, length, static_cast<uint64_t>(chunkInfo.id), chunkInfo.mortoncode)) {
+            VmaxCachedVoxel cachedVoxel{ voxel.infoX, voxel.infoY, voxel.infoZ, voxel.material, voxel.color, 
+                                         static_cast<uint16_t>(chunkInfo.mortoncode)};
+            addDecodedVoxel(cachedVoxel.x, cachedVoxel.y, cachedVoxel.z, cachedVoxel.material, cachedVoxel.palette, chunkInfo.id, chunkInfo.mortoncode);
+            nextChunk->voxels.push_back(cachedVoxel);
+            markDirty(chunkInfo.id, cachedVoxel);
+        }
+    }
+    for (uint64_t chunkId : croppedChunks) {
+        job.nextCache.chunks.erase(chunkId);
+    }
+    plist_free(job.plistModel);
+    job.plistModel = nullptr;
+}
+
+// Hand a premeshed bucket to the caller, nullptr when it still has to be meshed
+ogt_mesh* takeBucketMesh(VmaxBucketMeshes* premeshed, int material, int color) {
+    if (!premeshed) return nullptr;
+    auto found = premeshed->find({material, color});
+    if (found == premeshed->end()) return nullptr;
+    ogt_mesh* mesh = found->second;
+    found->second = nullptr;
+    return mesh;
+}
+
+void destroyBucketMeshes(VmaxBucketMeshes& meshes) {
+    ogt_voxel_meshify_context ctx = {};
+    for (auto& [bucket, mesh] : meshes) {
+        if (mesh) ogt_mesh_destroy(&ctx, mesh);
+    }
+    meshes.clear();
+}
+
+// Map VoxelMax material and palette settings onto a Bella quickMaterial
+VmaxBellaMaterial describeBellaMaterial(int material, 
+                                        int color, 
+                                        const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                                        const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                                        bool bevel) {
+    VmaxBellaMaterial desc;
+    if(material==7) {
+        desc.type = "liquid";
+    } else if(material==6 || vmaxPalette[color-1].a < 255) {
+        desc.type = "glass";
+        desc.roughness = vmaxMaterial[material].roughness * 100.0f;
+    } else if(vmaxMaterial[material].metalness > 0.1f) {
+        desc.type = "metal";
+        desc.roughness = vmaxMaterial[material].roughness * 100.0f;
+    } else if(vmaxMaterial[material].transmission > 0.0f) {
+        desc.type = "dielectric";
+        desc.transmission = vmaxMaterial[material].transmission;
+    } else if(vmaxMaterial[material].emission > 0.0f) {
+        desc.type = "emitter";
+        desc.emitterEnergy = vmaxMaterial[material].emission*100.0f;
+    } else if(vmaxMaterial[material].roughness > 0.8999f) {
+        desc.type = "diffuse";
+    } else {
+        desc.type = "plastic";
+        desc.roughness = vmaxMaterial[material].roughness * 100.0f;
+    }
+    desc.bevel = bevel && material != 7;
+
+    // Convert 0-255 to 0-1 , remember to -1 color index becuase voxelmax needs 0 to indicate no voxel
+    desc.color[0] = oom::misc::srgbToLinear(static_cast<double>(vmaxPalette[color-1].r)/255.0); // convert sRGB to linear
+    desc.color[1] = oom::misc::srgbToLinear(static_cast<double>(vmaxPalette[color-1].g)/255.0);
+    desc.color[2] = oom::misc::srgbToLinear(static_cast<double>(vmaxPalette[color-1].b)/255.0);
+    desc.color[3] = static_cast<double>(vmaxPalette[color-1].a)/255.0; // alpha is already linear
+    return desc;
+}
+
+dl::bella_sdk::Node createBellaMaterial(dl::bella_sdk::Scene& belScene, 
+                                        dl::String name, 
+                                        const VmaxBellaMaterial& materialDesc) {
+    auto belMaterial = belScene.createNode("quickMaterial", name);
+    s_perfStats.materials++;
+    belMaterial["type"] = materialDesc.type.c_str();
+    if (materialDesc.type == "liquid") {
+        belMaterial["liquidDepth"] = 300.0f;
+        belMaterial["liquidIor"] = 1.33f;
+    } else if (materialDesc.type == "glass") {
+        belMaterial["roughness"] = materialDesc.roughness;
+        belMaterial["glassDepth"] = 500.0f;
+    } else if (materialDesc.type == "dielectric") {
+        belMaterial["transmission"] = materialDesc.transmission;
+    } else if (materialDesc.type == "emitter") {
+        belMaterial["emitterUnit"] = "radiance";
+        belMaterial["emitterEnergy"] = materialDesc.emitterEnergy;
+    } else if (materialDesc.type == "metal" || materialDesc.type == "plastic") {
+        belMaterial["roughness"] = materialDesc.roughness;
+    }
+    if (materialDesc.bevel) {
+        belMaterial["bevel"] = belScene.findNode("oomBevel");
+    }
+    belMaterial["color"] = dl::Rgba{ materialDesc.color[0], 
+                                     materialDesc.color[1], 
+                                     materialDesc.color[2], 
+                                     materialDesc.color[3] }; // colors ready to use in Bella
+    return belMaterial;
+}
+
+// Mesh a bucket in grid space, lod representations are downsampled first
+// and must be scaled back up by representationLodFactor
+ogt_mesh* meshVoxelBucket(  const std::vector<oom::vmax::Voxel>& voxelsOfType, 
+                            const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                            int material, 
+                            VmaxRepresentation representation) {
+    int lodFactor = representationLodFactor(representation);
+    std::vector<oom::vmax::Voxel> lodVoxels;
+    if (lodFactor > 1) {
+        lodVoxels = downsampleVoxels(voxelsOfType, lodFactor);
+    }
+
+    // Convert voxels of a particular color to ogt_vox_model
+    ogt_vox_model* ogt_model = oom::ogt::convert_voxelsoftype_to_ogt_vox(lodFactor > 1 ? lodVoxels : voxelsOfType);
+    ogt_mesh_rgba palette[256]; // Create a palette array
+    for (int i = 0; i < 256; i++) { // Copy palette from Vmax to OGT
+        palette[i] = ogt_mesh_rgba{vmaxPalette[i].r, vmaxPalette[i].g, vmaxPalette[i].b, vmaxPalette[i].a};
+    }
+    ogt_voxel_meshify_context ctx = {}; // default malloc/free
+
+    // Convert ogt voxels to mesh, greedy merges coplanar faces into cuboid faces
+    ogt_mesh* mesh = nullptr;
+    if (representation == VmaxRepresentation::Mesh || material == 7) {
+        mesh = ogt_mesh_from_paletted_voxels_simple(&ctx,
+                                                    ogt_model->voxel_data, 
+                                                    ogt_model->size_x, 
+                                                    ogt_model->size_y, 
+                                                    ogt_model->size_z, 
+                                                    palette ); 
+    } else {
+        mesh = ogt_mesh_from_paletted_voxels_greedy(&ctx,
+                                                    ogt_model->voxel_data, 
+                                                    ogt_model->size_x, 
+                                                    ogt_model->size_y, 
+                                                    ogt_model->size_z, 
+                                                    palette ); 
+    }
+    oom::ogt::free_ogt_vox_model(ogt_model);
+    return mesh;
+}
+
+VmaxTiledBucket::~VmaxTiledBucket() {
+    ogt_voxel_meshify_context ctx = {};
+    for (ogt_mesh* mesh : tileMeshes) {
+        if (mesh) ogt_mesh_destroy(&ctx, mesh); // only left over when a tile task failed
+    }
+}
+
+// One pass over the bucket, sets the occupancy bits the tiles and their halos read
+void fillTiledBucket(VmaxTiledBucket& tiled, const std::vector<oom::vmax::Voxel>& voxelsOfType) {
+    tiled.occupancy.assign(static_cast<size_t>(kTiledMeshExtent) * kTiledMeshExtent * kTiledMeshExtent / 64, 0);
+    for (const auto& voxel : voxelsOfType) {
+        size_t bit = static_cast<size_t>(voxel.x) + static_cast<size_t>(voxel.y) * kTiledMeshExtent + 
+                     static_cast<size_t>(voxel.z) * kTiledMeshExtent * kTiledMeshExtent;
+        tiled.occupancy[bit >> 6] |= uint64_t(1) << (bit & 63);
+    }
+}
+
+// Whether any chunk under the tile holds voxels of the bucket, tiles are 32 or 64 so they cover whole chunks
+bool bucketInTile(const VmaxOccupancySummary& occupancy, int material, int color, int tileSize, size_t tileIndex) {
+    int tilesPerAxis = kTiledMeshExtent / tileSize;
+    int chunksPerTile = tileSize / VmaxOccupancySummary::kChunkSize;
+    int firstX = static_cast<int>(tileIndex % tilesPerAxis) * chunksPerTile;
+    int firstY = static_cast<int>((tileIndex / tilesPerAxis) % tilesPerAxis) * chunksPerTile;
+    int firstZ = static_cast<int>(tileIndex / (tilesPerAxis * tilesPerAxis)) * chunksPerTile;
+    for (int chunkZ = firstZ; chunkZ < firstZ + chunksPerTile; chunkZ++) {
+        for (int chunkY = firstY; chunkY < firstY + chunksPerTile; chunkY++) {
+            for (int chunkX = firstX; chunkX < firstX + chunksPerTile; chunkX++) {
+                if (occupancy.bucketInChunk(material, color, VmaxOccupancySummary::chunkIndex(chunkX, chunkY, chunkZ))) return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Mesh one tile in model space, the tile must hold voxels of the bucket
+// The tile is padded by one voxel of neighbour occupancy painted with palette index 2, ogt
+// culls faces against any solid voxel but only merges faces of the same index, so tile
+// faces touching a neighbour tile disappear and every face of the halo is dropped after
+ogt_mesh* meshBucketTile(const VmaxTiledBucket& tiled, size_t tileIndex, bool greedy) {
+    int tileSize = tiled.tileSize;
+    int originX = static_cast<int>(tileIndex % tiled.tilesPerAxis) * tileSize;
+    int originY = static_cast<int>((tileIndex / tiled.tilesPerAxis) % tiled.tilesPerAxis) * tileSize;
+    int originZ = static_cast<int>(tileIndex / (tiled.tilesPerAxis * tiled.tilesPerAxis)) * tileSize;
+
+    uint32_t gridSize = static_cast<uint32_t>(tileSize + 2);
+    std::vector<uint8_t>& grid = workerScratch(); // reused by every tile this worker meshes
+    grid.assign(static_cast<size_t>(gridSize) * gridSize * gridSize, 0);
+    for (uint32_t gz = 0; gz < gridSize; gz++) {
+        for (uint32_t gy = 0; gy < gridSize; gy++) {
+            for (uint32_t gx = 0; gx < gridSize; gx++) {
+                if (!tiled.occupied(originX + gx - 1, originY + gy - 1, originZ + gz - 1)) continue;
+                bool halo = gx == 0 || gy == 0 || gz == 0 || gx == gridSize - 1 || gy == gridSize - 1 || gz == gridSize - 1;
+                grid[gx + gy * gridSize + gz * gridSize * gridSize] = halo ? 2 : 1;
+            }
+        }
+    }
+
+    ogt_mesh_rgba palette[256] = {}; // vertex colors are unused, bella gets a material per bucket
+    palette[1] = ogt_mesh_rgba{255, 255, 255, 255};
+    palette[2] = ogt_mesh_rgba{0, 0, 0, 255};
+    ogt_voxel_meshify_context ctx = {};
+    ogt_mesh* haloMesh = greedy ? ogt_mesh_from_paletted_voxels_greedy(&ctx, grid.data(), gridSize, gridSize, gridSize, palette)
+                                : ogt_mesh_from_paletted_voxels_simple(&ctx, grid.data(), gridSize, gridSize, gridSize, palette);
+
+    // Keep triangles of the tile itself, vertices are never shared between faces of different colors
+    std::vector<uint32_t> remap(haloMesh->vertex_count, UINT32_MAX);
+    std::vector<ogt_mesh_vertex> vertices;
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i + 2 < haloMesh->index_count; i += 3) {
+        if (haloMesh->vertices[haloMesh->indices[i]].palette_index != 1) continue;
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t index = haloMesh->indices[i + corner];
+            if (remap[index] == UINT32_MAX) {
+                ogt_mesh_vertex vertex = haloMesh->vertices[index];
+                vertex.pos.x += static_cast<float>(originX - 1); // back to model space
+                vertex.pos.y += static_cast<float>(originY - 1);
+                vertex.pos.z += static_cast<float>(originZ - 1);
+                remap[index] = static_cast<uint32_t>(vertices.size());
+                vertices.push_back(vertex);
+            }
+            indices.push_back(remap[index]);
+        }
+    }
+    ogt_mesh_destroy(&ctx, haloMesh);
+
+    // Same single block layout ogt uses so ogt_mesh_destroy frees it
+    ogt_mesh* mesh = static_cast<ogt_mesh*>(malloc(sizeof(ogt_mesh) + vertices.size() * sizeof(ogt_mesh_vertex) + indices.size() * sizeof(uint32_t)));
+    if (!mesh) throw std::runtime_error("Failed to allocate tile mesh");
+    mesh->vertex_count = static_cast<uint32_t>(vertices.size());
+    mesh->index_count = static_cast<uint32_t>(indices.size());
+    mesh->vertices = reinterpret_cast<ogt_mesh_vertex*>(mesh + 1);
+    mesh->indices = reinterpret_cast<uint32_t*>(mesh->vertices + mesh->vertex_count);
+    std::copy(vertices.begin(), vertices.end(), mesh->vertices);
+    std::copy(indices.begin(), indices.end(), mesh->indices);
+    return mesh;
+}
+
+// Concatenate tile meshes in tile order, rebasing each tile's indices past the vertices before it
+// Takes ownership of the tile meshes
+ogt_mesh* stitchTileMeshes(std::vector<ogt_mesh*>& tileMeshes) {
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (const ogt_mesh* tileMesh : tileMeshes) {
+        if (!tileMesh) continue;
+        vertexCount += tileMesh->vertex_count;
+        indexCount += tileMesh->index_count;
+    }
+    ogt_mesh* mesh = static_cast<ogt_mesh*>(malloc(sizeof(ogt_mesh) + vertexCount * sizeof(ogt_mesh_vertex) + indexCount * sizeof(uint32_t)));
+    if (!mesh) throw std::runtime_error("Failed to allocate stitched mesh");
+    mesh->vertex_count = static_cast<uint32_t>(vertexCount);
+    mesh->index_count = static_cast<uint32_t>(indexCount);
+    mesh->vertices = reinterpret_cast<ogt_mesh_vertex*>(mesh + 1);
+    mesh->indices = reinterpret_cast<uint32_t*>(mesh->vertices + vertexCount);
+
+    ogt_voxel_meshify_context ctx = {};
+    uint32_t baseVertex = 0;
+    uint32_t* indexOut = mesh->indices;
+    for (ogt_mesh*& tileMesh : tileMeshes) {
+        if (!tileMesh) continue;
+        std::copy(tileMesh->vertices, tileMesh->vertices + tileMesh->vertex_count, mesh->vertices + baseVertex);
+        for (uint32_t i = 0; i < tileMesh->index_count; i++) {
+            *indexOut++ = baseVertex + tileMesh->indices[i];
+        }
+        baseVertex += tileMesh->vertex_count;
+        ogt_mesh_destroy(&ctx, tileMesh);
+        tileMesh = nullptr;
+    }
+    return mesh;
+}
+
+// Tile mesh as cache bytes: vertex count, index count, the vertices, the indices
+std::vector<uint8_t> serializeTileMesh(const ogt_mesh* mesh) {
+    size_t vertexBytes = mesh->vertex_count * sizeof(ogt_mesh_vertex);
+    size_t indexBytes = mesh->index_count * sizeof(uint32_t);
+    std::vector<uint8_t> bytes(2 * sizeof(uint32_t) + vertexBytes + indexBytes);
+    std::memcpy(bytes.data(), &mesh->vertex_count, sizeof(uint32_t));
+    std::memcpy(bytes.data() + sizeof(uint32_t), &mesh->index_count, sizeof(uint32_t));
+    std::memcpy(bytes.data() + 2 * sizeof(uint32_t), mesh->vertices, vertexBytes);
+    std::memcpy(bytes.data() + 2 * sizeof(uint32_t) + vertexBytes, mesh->indices, indexBytes);
+    return bytes;
+}
+
+// Back into the single block layout ogt_mesh_destroy frees
+ogt_mesh* deserializeTileMesh(const std::vector<uint8_t>& bytes) {
+    uint32_t vertexCount = 0, indexCount = 0;
+    if (bytes.size() < 2 * sizeof(uint32_t)) throw std::runtime_error("Corrupt cached tile mesh");
+    std::memcpy(&vertexCount, bytes.data(), sizeof(uint32_t));
+    std::memcpy(&indexCount, bytes.data() + sizeof(uint32_t), sizeof(uint32_t));
+    size_t vertexBytes = static_cast<size_t>(vertexCount) * sizeof(ogt_mesh_vertex);
+    size_t indexBytes = static_cast<size_t>(indexCount) * sizeof(uint32_t);
+    if (bytes.size() != 2 * sizeof(uint32_t) + vertexBytes + indexBytes) throw std::runtime_error("Corrupt cached tile mesh");
+    ogt_mesh* mesh = static_cast<ogt_mesh*>(malloc(sizeof(ogt_mesh) + vertexBytes + indexBytes));
+    if (!mesh) throw std::runtime_error("Failed to allocate cached tile mesh");
+    mesh->vertex_count = vertexCount;
+    mesh->index_count = indexCount;
+    mesh->vertices = reinterpret_cast<ogt_mesh_vertex*>(mesh + 1);
+    mesh->indices = reinterpret_cast<uint32_t*>(mesh->vertices + vertexCount);
+    std::memcpy(mesh->vertices, bytes.data() + 2 * sizeof(uint32_t), vertexBytes);
+    std::memcpy(mesh->indices, bytes.data() + 2 * sizeof(uint32_t) + vertexBytes, indexBytes);
+    return mesh;
+}
+
+// Compose an object's transform with every group above it
+// Matrices are row vector (translation in the bottom row) so the parent goes on the right
+oom::vmax::Matrix4x4 objectWorldMatrix( const oom::vmax::JsonModelInfo& jsonModelInfo, 
+                                        const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups) {
+    oom::vmax::Matrix4x4 worldMat4 = oom::vmax::combineTransforms(jsonModelInfo.rotation[0], 
+                                                                  jsonModelInfo.rotation[1], 
+                                                                  jsonModelInfo.rotation[2], 
+                                                                  jsonModelInfo.rotation[3],
+                                                                  jsonModelInfo.position[0], 
+                                                                  jsonModelInfo.position[1], 
+                                                                  jsonModelInfo.position[2], 
+                                                                  jsonModelInfo.scale[0], 
+                                                                  jsonModelInfo.scale[1], 
+                                                                  jsonModelInfo.scale[2]);
+    std::string parentId = jsonModelInfo.parentId;
+    while (!parentId.empty()) {
+        auto parent = jsonGroups.find(parentId);
+        if (parent == jsonGroups.end()) break;
+        const auto& groupInfo = parent->second;
+        worldMat4 = worldMat4 * oom::vmax::combineTransforms(groupInfo.rotation[0], 
+                                                             groupInfo.rotation[1], 
+                                                             groupInfo.rotation[2], 
+                                                             groupInfo.rotation[3],
+                                                             groupInfo.position[0], 
+                                                             groupInfo.position[1], 
+                                                             groupInfo.position[2], 
+                                                             groupInfo.scale[0], 
+                                                             groupInfo.scale[1], 
+                                                             groupInfo.scale[2]);
+        parentId = groupInfo.parentId;
+    }
+    return worldMat4;
+}
+
+// Mesh every bucket of a model and append it, in world space, to the batch of its material
+void batchModel(BellaMeshBatcher& batcher,
+                dl::bella_sdk::Scene& belScene, 
+                dl::bella_sdk::Node& belWorld, 
+                const oom::vmax::Model& vmaxModel, 
+                const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                VmaxRepresentation representation,
+                const oom::vmax::Matrix4x4& worldMat4,
+                bool bevel,
+                VmaxBucketMeshes* premeshed) {
+    double lodFactor = representationLodFactor(representation);
+    const auto& m = worldMat4.m;
+    for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+        for (int color : colorID) {
+            const std::vector<oom::vmax::Voxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
+            if (voxelsOfType.empty()) continue;
+            ogt_mesh* mesh = takeBucketMesh(premeshed, material, color);
+            if (!mesh) mesh = meshVoxelBucket(voxelsOfType, vmaxPalette, material, representation);
+
+            VmaxBellaMaterial materialDesc = describeBellaMaterial(material, color, vmaxPalette, vmaxMaterial, bevel);
+            BellaMeshBatch& batch = batcher.batches[materialDesc];
+            if (batch.faces.size() > 0 && batch.faces.size() + mesh->index_count / 3 > batcher.maxTriangles) {
+                flushMeshBatch(batcher, belScene, belWorld, materialDesc, batch);
+            }
+
+            unsigned int baseIndex = static_cast<unsigned int>(batch.points.size());
+            for (uint32_t i = 0; i < mesh->vertex_count; i++) {
+                double x = mesh->vertices[i].pos.x * lodFactor;
+                double y = mesh->vertices[i].pos.y * lodFactor;
+                double z = mesh->vertices[i].pos.z * lodFactor;
+                batch.points.push_back(dl::Pos3f{ static_cast<float>(x*m[0][0] + y*m[1][0] + z*m[2][0] + m[3][0]),
+                                                  static_cast<float>(x*m[0][1] + y*m[1][1] + z*m[2][1] + m[3][1]),
+                                                  static_cast<float>(x*m[0][2] + y*m[1][2] + z*m[2][2] + m[3][2]) });
+            }
+            for (size_t i = 0; i < mesh->index_count; i+=3) {
+                batch.faces.push_back(dl::Vec4u{ baseIndex + mesh->indices[i], 
+                                                 baseIndex + mesh->indices[i+1], 
+                                                 baseIndex + mesh->indices[i+2], 
+                                                 baseIndex + mesh->indices[i+2] });
+            }
+            ogt_voxel_meshify_context ctx = {};
+            ogt_mesh_destroy(&ctx, mesh);
+        }
+    }
+}
+
+// Write one combined mesh under the world and start the batch over
+void flushMeshBatch(BellaMeshBatcher& batcher,
+                    dl::bella_sdk::Scene& belScene, 
+                    dl::bella_sdk::Node& belWorld, 
+                    const VmaxBellaMaterial& materialDesc,
+                    BellaMeshBatch& batch) {
+    if (batch.faces.size() == 0) return;
+    dl::String batchName = dl::String("oomBatch") + dl::String(batcher.meshCount++);
+    auto belBatchXform = belScene.createNode("xform", batchName + dl::String("Xform"));
+    belBatchXform["steps"][0]["xform"] = dl::Mat4 {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
+    belBatchXform.parentTo(belWorld);
+    belBatchXform["material"] = createBellaMaterial(belScene, batchName + dl::String("Mat"), materialDesc);
+
+    auto belBatchMesh = belScene.createNode("mesh", batchName + dl::String("Mesh"));
+    belBatchMesh["normals"] = "flat";
+    belBatchMesh["steps"][0]["points"] = batch.points;
+    belBatchMesh["polygons"] = batch.faces;
+    s_perfStats.meshes++;
+    s_perfStats.triangles += batch.faces.size();
+    belBatchMesh.parentTo(belBatchXform);
+    batch = BellaMeshBatch();
+}
+
+// Preview mesh of one model for --export glb
+// Premeshed buckets are read, not taken, bella emission still needs them afterwards
+// Box models have no meshes, they preview as greedy meshes meshed here
+VmaxGltfMesh gltfMeshForModel(  dl::Args& args,
+                                const oom::vmax::Model& vmaxModel, 
+                                const std::vector<oom::vmax::RGBA>& vmaxPalette, 
+                                const std::array<oom::vmax::Material, 8>& vmaxMaterial,
+                                VmaxRepresentation representation,
+                                const VmaxBucketMeshes* premeshed,
+                                const std::map<int, VmaxAtlasMesh>* atlasMeshes) {
+    VmaxGltfMesh gltfMesh;
+    gltfMesh.name = vmaxModel.vmaxbFileName;
+    VmaxRepresentation meshRepresentation = representationIsMesh(representation) ? representation : VmaxRepresentation::GreedyMesh;
+    float lodFactor = static_cast<float>(representationLodFactor(meshRepresentation));
+    auto addMaterial = [&](int material, int color, bool textured) {
+        VmaxBellaMaterial materialDesc = describeBellaMaterial(material, color, vmaxPalette, vmaxMaterial, false);
+        VmaxGltfMaterial gltfMaterial;
+        for (int c = 0; c < 4; c++) {
+            gltfMaterial.color[c] = textured && c < 3 ? 1.0f : static_cast<float>(materialDesc.color[c]);
+        }
+        if (materialDesc.type == "glass" || materialDesc.type == "liquid") gltfMaterial.color[3] = std::min(gltfMaterial.color[3], 0.5f);
+        gltfMaterial.metallic = materialDesc.type == "metal" ? 1.0f : 0.0f;
+        gltfMaterial.roughness = materialDesc.type == "diffuse" ? 1.0f : static_cast<float>(materialDesc.roughness / 100.0);
+        if (materialDesc.type == "emitter") {
+            for (int c = 0; c < 3; c++) gltfMaterial.emissive[c] = gltfMaterial.color[c];
+        }
+        if (textured) gltfMaterial.image = static_cast<int>(gltfMesh.images.size()) - 1;
+        gltfMesh.materials.push_back(gltfMaterial);
+        return static_cast<int>(gltfMesh.materials.size()) - 1;
+    };
+
+    // Atlas meshes become one textured primitive per material, the atlas png is embedded
+    bool atlas = atlasMeshes && atlasRepresentation(args, representation);
+    if (atlas) {
+        for (const auto& [material, atlasMesh] : *atlasMeshes) {
+            if (atlasMesh.quadCount() == 0) continue;
+            int atlasColor = -1;
+            for (const auto& [usedMaterial, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+                if (usedMaterial != material) continue;
+                for (int color : colorID) {
+                    if (isAtlasBucket(material, color, vmaxPalette)) atlasColor = color;
+                }
+            }
+            if (atlasColor < 0) continue;
+            gltfMesh.images.push_back(encodeAtlasPng(atlasMesh.texels, atlasMesh.width, atlasMesh.height));
+            VmaxGltfPrimitive primitive;
+            primitive.positions = atlasMesh.positions;
+            primitive.uvs = atlasMesh.uvs;
+            for (size_t i = 1; i < primitive.uvs.size(); i += 2) {
+                primitive.uvs[i] = 1.0f - primitive.uvs[i]; // bella v runs bottom up, glTF top down
+            }
+            primitive.indices.reserve(atlasMesh.quadCount() * 6);
+            for (size_t i = 0; i < atlasMesh.quads.size(); i += 4) {
+                const uint32_t* quad = &atlasMesh.quads[i];
+                primitive.indices.insert(primitive.indices.end(), {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]});
+            }
+            primitive.material = addMaterial(material, atlasColor, true);
+            gltfMesh.primitives.push_back(std::move(primitive));
+        }
+    }
+
+    for (const auto& [material, colorID] : vmaxModel.getUsedMaterialsAndColors()) {
+        for (int color : colorID) {
+            if (atlas && atlasMeshes->count(material) && isAtlasBucket(material, color, vmaxPalette)) continue;
+            const std::vector<oom::vmax::Voxel>& voxelsOfType = vmaxModel.getVoxels(material, color);
+            if (voxelsOfType.empty()) continue;
+            const ogt_mesh* mesh = nullptr;
+            ogt_mesh* ownedMesh = nullptr;
+            if (premeshed) {
+                auto found = premeshed->find({material, color});
+                if (found != premeshed->end()) mesh = found->second;
+            }
+            if (!mesh) {
+                ownedMesh = meshVoxelBucket(voxelsOfType, vmaxPalette, material, meshRepresentation);
+                mesh = ownedMesh;
+            }
+            if (mesh && mesh->index_count > 0) {
+                VmaxGltfPrimitive primitive;
+                primitive.positions.reserve(mesh->vertex_count * 3);
+                primitive.normals.reserve(mesh->vertex_count * 3);
+                for (uint32_t i = 0; i < mesh->vertex_count; i++) {
+                    const ogt_mesh_vertex& vertex = mesh->vertices[i];
+                    primitive.positions.insert(primitive.positions.end(), {vertex.pos.x * lodFactor, vertex.pos.y * lodFactor, vertex.pos.z * lodFactor});
+                    primitive.normals.insert(primitive.normals.end(), {vertex.normal.x, vertex.normal.y, vertex.normal.z});
+                }
+                primitive.indices.assign(mesh->indices, mesh->indices + mesh->index_count);
+                primitive.material = addMaterial(material, color, false);
+                gltfMesh.primitives.push_back(std::move(primitive));
+            }
+            if (ownedMesh) {
+                ogt_voxel_meshify_context ctx = {};
+                ogt_mesh_destroy(&ctx, ownedMesh);
+            }
+        }
+    }
+    return gltfMesh;
+}
+
+// Node tree of the glb and thumbnail targets, the hierarchy the bella groups and object xforms get
+// A group copy found by --subtrees gets a deep copy of its prototype's children, copies inside
+// the prototype are filled first so nested duplicates come along
+void addExportNodes(VmaxGltfScene& exportScene,
+                    const std::map<std::string, std::vector<oom::vmax::JsonModelInfo>>& modelVmaxbMap,
+                    const std::map<std::string, oom::vmax::JsonGroupInfo>& jsonGroups,
+                    const VmaxSubtreeInstancing& subtreeInstancing,
+                    const std::map<std::string, int>& meshIndices) {
+    auto exportMatrix = [](const std::vector<double>& rotation, const std::vector<double>& position, const std::vector<double>& scale) {
+        oom::vmax::Matrix4x4 mat4 = oom::vmax::combineTransforms(rotation[0], rotation[1], rotation[2], rotation[3],
+                                                                 position[0], position[1], position[2],
+                                                                 scale[0], scale[1], scale[2]);
+        VmaxGltfMatrix matrix;
+        for (int i = 0; i < 16; i++) matrix[i] = mat4.m[i / 4][i % 4];
+        return matrix;
+    };
+    std::map<std::string, int> groupNodes;
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        if (subtreeInstancing.droppedGroups.count(groupId)) continue;
+        groupNodes[groupId] = exportScene.addNode(groupInfo.name.empty() ? groupId : groupInfo.name,
+                                                  exportMatrix(groupInfo.rotation, groupInfo.position, groupInfo.scale));
+    }
+    auto parentNode = [&groupNodes](const std::string& parentId) {
+        auto parent = groupNodes.find(parentId);
+        return parent == groupNodes.end() ? -1 : parent->second;
+    };
+    for (const auto& [groupId, groupInfo] : jsonGroups) {
+        if (groupNodes.count(groupId)) exportScene.parent(groupNodes[groupId], parentNode(groupInfo.parentId));
+    }
+    for (const auto& [vmaxContentName, vmaxModelList] : modelVmaxbMap) {
+        int mesh = meshIndices.at(vmaxContentName);
+        for (const auto& jsonModelInfo : vmaxModelList) {
+            int node = exportScene.addNode(jsonModelInfo.name.empty() ? jsonModelInfo.id : jsonModelInfo.name,
+                                           exportMatrix(jsonModelInfo.rotation, jsonModelInfo.position, jsonModelInfo.scale), mesh);
+            exportScene.parent(node, parentNode(jsonModelInfo.parentId));
+        }
+    }
+
+    auto isInside = [&jsonGroups](std::string groupId, const std::string& ancestorId) {
+        for (size_t depth = 0; depth <= jsonGroups.size(); depth++) {
+            auto group = jsonGroups.find(groupId);
+            if (group == jsonGroups.end()) return false;
+            if (group->second.parentId == ancestorId) return true;
+            groupId = group->second.parentId;
+        }
+        return false;
+    };
+    std::set<std::string> filled;
+    auto fillCopy = [&](const std::string& copyId, auto& self) -> void {
+        if (!filled.insert(copyId).second) return;
+        const std::string& prototypeId = subtreeInstancing.copyOf.at(copyId);
+        for (const auto& [otherId, otherPrototypeId] : subtreeInstancing.copyOf) {
+            if (groupNodes.count(otherId) && isInside(otherId, prototypeId)) self(otherId, self);
+        }
+        std::vector<int> children = exportScene.nodes[groupNodes.at(prototypeId)].children; // cloning grows nodes
+        for (int child : children) {
+            exportScene.cloneSubtree(child, groupNodes.at(copyId));
+        }
+    };
+    for (const auto& [copyId, prototypeId] : subtreeInstancing.copyOf) {
+        if (groupNodes.count(copyId) && groupNodes.count(prototypeId)) fillCopy(copyId, fillCopy);
+    }
+}